@@ -0,0 +1,46 @@
+#include "dod/Scene.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+namespace {
+
+// A cloud of small random triangles and spheres, and rays through it.
+struct RandomScene {
+  dod::Scene scene;
+  std::vector<Ray> rays;
+
+  explicit RandomScene(int bvhWidth) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<> coord(-10, 10);
+    std::uniform_real_distribution<> small(-0.5, 0.5);
+    auto randomVec = [&] { return Vec3(coord(rng), coord(rng), coord(rng)); };
+    auto nearbyVec = [&](const Vec3 &v) {
+      return v + Vec3(small(rng), small(rng), small(rng));
+    };
+    auto material = MaterialSpec::makeDiffuse(Vec3(0.5, 0.5, 0.5));
+    for (int i = 0; i < 20000; ++i) {
+      auto v0 = randomVec();
+      scene.addTriangle(v0, nearbyVec(v0), nearbyVec(v0), material);
+    }
+    for (int i = 0; i < 200; ++i)
+      scene.addSphere(randomVec(), 0.25, material);
+    scene.buildBvh(dod::BvhBuilder::SurfaceAreaHeuristic, 1, bvhWidth);
+    for (int i = 0; i < 1024; ++i)
+      rays.emplace_back(Ray::fromTwoPoints(randomVec(), randomVec()));
+  }
+};
+
+}
+
+static void BM_DodBvhIntersect(benchmark::State &state) {
+  RandomScene random(static_cast<int>(state.range(0)));
+  size_t rayIndex = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(random.scene.intersect(random.rays[rayIndex]));
+    rayIndex = (rayIndex + 1) % random.rays.size();
+  }
+}
+
+BENCHMARK(BM_DodBvhIntersect)->ArgName("width")->Arg(2)->Arg(4)->Arg(8);
@@ -0,0 +1,129 @@
+#include "dod/Scene.h"
+#include "fp/Bvh.h"
+#include "fp/SceneBuilder.h"
+#include "oo/SceneBuilder.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+namespace {
+
+// Shadow rays: segments between random points in a cloud of small random
+// triangles and spheres. Each way finds either the nearest hit along the
+// whole ray, as a shadow ray used to, or just whether there's any hit before
+// the segment's end.
+struct Segment {
+  Ray ray;
+  double length;
+};
+
+template <typename SceneBuilder>
+std::vector<Segment> buildRandomScene(SceneBuilder &builder) {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<> coord(-10, 10);
+  std::uniform_real_distribution<> small(-0.5, 0.5);
+  auto randomVec = [&] { return Vec3(coord(rng), coord(rng), coord(rng)); };
+  auto nearbyVec = [&](const Vec3 &v) {
+    return v + Vec3(small(rng), small(rng), small(rng));
+  };
+  auto material = MaterialSpec::makeDiffuse(Vec3(0.5, 0.5, 0.5));
+  for (int i = 0; i < 20000; ++i) {
+    auto v0 = randomVec();
+    builder.addTriangle(v0, nearbyVec(v0), nearbyVec(v0), material);
+  }
+  for (int i = 0; i < 200; ++i)
+    builder.addSphere(randomVec(), 0.25, material);
+  std::vector<Segment> segments;
+  for (int i = 0; i < 1024; ++i) {
+    const auto from = randomVec();
+    const auto to = randomVec();
+    segments.emplace_back(
+        Segment{Ray::fromTwoPoints(from, to), (to - from).length()});
+  }
+  return segments;
+}
+
+template <typename Query>
+void runSegments(benchmark::State &state,
+                 const std::vector<Segment> &segments, Query &&query) {
+  size_t index = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(query(segments[index]));
+    index = (index + 1) % segments.size();
+  }
+}
+
+}
+
+static void BM_OoShadowIntersect(benchmark::State &state) {
+  oo::SceneBuilder builder;
+  const auto segments = buildRandomScene(builder);
+  builder.buildBvh();
+  runSegments(state, segments, [&](const Segment &segment) {
+    oo::Primitive::IntersectionRecord record;
+    return builder.scene().intersect(segment.ray, record)
+           && record.hit.distance < segment.length;
+  });
+}
+
+BENCHMARK(BM_OoShadowIntersect);
+
+static void BM_OoShadowOccluded(benchmark::State &state) {
+  oo::SceneBuilder builder;
+  const auto segments = buildRandomScene(builder);
+  builder.buildBvh();
+  runSegments(state, segments, [&](const Segment &segment) {
+    return builder.scene().occluded(segment.ray, segment.length);
+  });
+}
+
+BENCHMARK(BM_OoShadowOccluded);
+
+static void BM_FpShadowIntersect(benchmark::State &state) {
+  fp::SceneBuilder builder;
+  const auto segments = buildRandomScene(builder);
+  const auto bvh = fp::buildBvh(builder.scene().primitives);
+  runSegments(state, segments, [&](const Segment &segment) {
+    const auto record = fp::intersect(bvh, segment.ray);
+    return record && record->hit.distance < segment.length;
+  });
+}
+
+BENCHMARK(BM_FpShadowIntersect);
+
+static void BM_FpShadowOccluded(benchmark::State &state) {
+  fp::SceneBuilder builder;
+  const auto segments = buildRandomScene(builder);
+  const auto bvh = fp::buildBvh(builder.scene().primitives);
+  runSegments(state, segments, [&](const Segment &segment) {
+    return fp::occluded(bvh, segment.ray, segment.length);
+  });
+}
+
+BENCHMARK(BM_FpShadowOccluded);
+
+static void BM_DodShadowIntersect(benchmark::State &state) {
+  dod::Scene scene;
+  const auto segments = buildRandomScene(scene);
+  scene.buildBvh(dod::BvhBuilder::SurfaceAreaHeuristic, 1,
+                 static_cast<int>(state.range(0)));
+  runSegments(state, segments, [&](const Segment &segment) {
+    const auto record = scene.intersect(segment.ray);
+    return record && record->hit.distance < segment.length;
+  });
+}
+
+BENCHMARK(BM_DodShadowIntersect)->ArgName("width")->Arg(2)->Arg(4)->Arg(8);
+
+static void BM_DodShadowOccluded(benchmark::State &state) {
+  dod::Scene scene;
+  const auto segments = buildRandomScene(scene);
+  scene.buildBvh(dod::BvhBuilder::SurfaceAreaHeuristic, 1,
+                 static_cast<int>(state.range(0)));
+  runSegments(state, segments, [&](const Segment &segment) {
+    return scene.occluded(segment.ray, segment.length);
+  });
+}
+
+BENCHMARK(BM_DodShadowOccluded)->ArgName("width")->Arg(2)->Arg(4)->Arg(8);
@@ -0,0 +1,53 @@
+#include "dod/SphereStore.h"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+namespace {
+
+// A block of spheres as a BVH leaf might hold, and rays through them.
+struct RandomSpheres {
+  dod::SphereStore store;
+  std::vector<Ray> rays;
+
+  RandomSpheres() {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<> coord(-10, 10);
+    auto randomVec = [&] { return Vec3(coord(rng), coord(rng), coord(rng)); };
+    for (int i = 0; i < 64; ++i)
+      store.add(dod::Sphere(randomVec(), 1));
+    for (int i = 0; i < 1024; ++i)
+      rays.emplace_back(Ray::fromTwoPoints(randomVec(), randomVec()));
+  }
+};
+
+}
+
+static void BM_DodSpheresSimd(benchmark::State &state) {
+  RandomSpheres spheres;
+  size_t rayIndex = 0;
+  for (auto _ : state) {
+    std::optional<size_t> nearest;
+    benchmark::DoNotOptimize(spheres.store.nearest(
+        spheres.rays[rayIndex], 0, spheres.store.size(),
+        std::numeric_limits<double>::infinity(), nearest));
+    rayIndex = (rayIndex + 1) % spheres.rays.size();
+  }
+}
+
+BENCHMARK(BM_DodSpheresSimd);
+
+static void BM_DodSpheresScalar(benchmark::State &state) {
+  RandomSpheres spheres;
+  size_t rayIndex = 0;
+  for (auto _ : state) {
+    std::optional<size_t> nearest;
+    benchmark::DoNotOptimize(spheres.store.nearestScalar(
+        spheres.rays[rayIndex], 0, spheres.store.size(),
+        std::numeric_limits<double>::infinity(), nearest));
+    rayIndex = (rayIndex + 1) % spheres.rays.size();
+  }
+}
+
+BENCHMARK(BM_DodSpheresScalar);
@@ -0,0 +1,23 @@
+#!/bin/bash
+
+set -e
+
+make -C cmake-build-release pt_three_ways
+
+cpus=${1:-$(nproc)}
+TIMEFORMAT="%R %U %S"
+
+for way in oo dod; do
+  echo Testing $way with $cpus cpus:
+  times=$( { time ./cmake-build-release/bin/pt_three_ways \
+    --save-every 0 \
+    --width 128 --height 128 \
+    --max-cpus $cpus --spp $((cpus * 4)) --scene cornell \
+    --way $way /dev/null >/dev/null 2>&1; } 2>&1)
+  echo $times | awk -v cpus=$cpus '{
+    busy = $2 + $3
+    idle = $1 * cpus - busy
+    printf "wall %.2fs, busy %.2fs, idle %.2f cpu-s (%.0f%%)\n",
+      $1, busy, idle, 100 * idle / ($1 * cpus)
+  }'
+done
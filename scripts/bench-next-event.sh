@@ -0,0 +1,25 @@
+#!/bin/bash
+
+set -e
+
+make -C cmake-build-release pt_three_ways
+
+# Next event estimation costs a shadow ray per diffuse bounce, so it's
+# compared at roughly equal time: half the samples of the plain renders. The
+# images are left behind to compare against each other, or against a render
+# with many more samples.
+spp=${1:-64}
+
+for scene in example1 suzanne; do
+  for way in oo fp dod; do
+    for options in "--spp $spp" "--spp $((spp / 2)) --next-event"; do
+      echo Testing $scene with $way $options:
+      time ./cmake-build-release/bin/pt_three_ways \
+        --save-every 0 \
+        --width 128 --height 128 \
+        --max-cpus 1 --scene $scene --seed 1 \
+        --way $way $options \
+        next-event-$scene-$way-$(echo $options | tr -d ' -').png
+    done
+  done
+done
@@ -0,0 +1,53 @@
+#!/bin/bash
+
+set -e
+
+make -C cmake-build-release pt_three_ways
+
+# Russian roulette against cutting every path off at a fixed depth. For each
+# setting this reports the rays traced per sample (counted by the wavefront
+# renderer), and how long each way takes to get within the target RMS error
+# of a long, deep reference render, doubling the samples until it does. A
+# shallow fixed depth may never get there: what it cuts off is missing from
+# every sample, however many there are.
+target=${1:-0.02}
+maxSpp=1024
+
+bin=./cmake-build-release/bin/pt_three_ways
+common="--save-every 0 --width 64 --height 64 --max-cpus 1"
+
+for scene in cornell example1; do
+  reference=roulette-$scene-reference.raw
+  echo Rendering the reference for $scene:
+  $bin $common --scene $scene --seed 1 --way dod --spp 2048 \
+    --max-depth 16 --raw $reference | grep Took
+  for options in "--max-depth 5" "--max-depth 16" \
+    "--max-depth 16 --roulette-depth 3"; do
+    $bin $common --scene $scene --seed 2 --way dod --wavefront --spp 4 \
+      $options /dev/null |
+      awk -v label="$scene $options" \
+        '/^Traced/ { rays = $2 } /^Total samples/ { samples = $3 }
+         END { printf "%s: %.1f rays per sample\n", label, rays / samples }'
+    for way in oo fp dod; do
+      spp=1
+      while [ $spp -le $maxSpp ]; do
+        start=$(date +%s.%N)
+        error=$($bin $common --scene $scene --seed 2 --way $way --spp $spp \
+          $options --reference $reference /dev/null |
+          awk '/^RMS error/ { print $3 }')
+        end=$(date +%s.%N)
+        if awk -v error=$error -v target=$target \
+          'BEGIN { exit !(error <= target) }'; then
+          break
+        fi
+        spp=$((spp * 2))
+      done
+      if [ $spp -le $maxSpp ]; then
+        echo "  $way: error $error at $spp spp in" \
+          "$(awk -v start=$start -v end=$end 'BEGIN { print end - start }')s"
+      else
+        echo "  $way: error still $error at $maxSpp spp"
+      fi
+    done
+  done
+done
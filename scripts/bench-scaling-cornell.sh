@@ -0,0 +1,16 @@
+#!/bin/bash
+
+set -e
+
+make -C cmake-build-release pt_three_ways
+
+max_threads=${1:-$(nproc)}
+
+for threads in $(seq 1 $max_threads); do
+  echo Testing oo tiled with $threads threads:
+  time ./cmake-build-release/bin/pt_three_ways \
+    --save-every 0 \
+    --width 256 --height 256 \
+    --max-cpus $threads --spp 64 --scene cornell \
+    --way oo --tiled /dev/null
+done
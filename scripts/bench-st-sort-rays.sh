@@ -0,0 +1,17 @@
+#!/bin/bash
+
+set -e
+
+make -C cmake-build-release pt_three_ways
+
+for scene in ce suzanne; do
+  for options in "" "--sort-rays" "--packet-size 4" \
+    "--sort-rays --packet-size 4"; do
+    echo Testing $scene with wavefront $options:
+    time ./cmake-build-release/bin/pt_three_ways \
+      --save-every 0 \
+      --width 128 --height 128 \
+      --max-cpus 1 --spp 2 --scene $scene \
+      --way dod --wavefront $options /dev/null
+  done
+done
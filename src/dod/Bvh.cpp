@@ -0,0 +1,374 @@
+#include "Bvh.h"
+#include "math/Epsilon.h"
+
+#include <algorithm>
+#include <future>
+#include <numeric>
+#include <optional>
+
+using dod::Bvh;
+using dod::BvhNode;
+
+namespace {
+
+constexpr size_t NumBins = 16;
+constexpr size_t MaxLeafSize = 8;
+// Relative costs of visiting a node versus intersecting a primitive.
+constexpr double TraversalCost = 1.0;
+constexpr double IntersectionCost = 2.0;
+// Past this depth, splits are at the median so that the tree depth stays
+// within Bvh::MaxDepth whatever the SAH would have preferred.
+constexpr size_t MaxSahDepth = Bvh::MaxDepth / 2;
+
+class SahBuilder {
+  const std::vector<Aabb> &bounds_;
+  std::vector<Vec3> centres_;
+  Bvh &bvh_;
+
+  struct Bin {
+    Aabb bounds;
+    size_t count{};
+  };
+
+  struct Split {
+    int axis{};
+    size_t bin{};
+    double cost{};
+  };
+
+  [[nodiscard]] size_t binFor(const Aabb &centroidBounds, int axis,
+                              uint32_t primitive) const noexcept {
+    const auto min = centroidBounds.min()[axis];
+    const auto extent = centroidBounds.extent()[axis];
+    const auto bin = static_cast<size_t>(
+        NumBins * (centres_[primitive][axis] - min) / extent);
+    return std::min(bin, NumBins - 1);
+  }
+
+  [[nodiscard]] std::optional<Split>
+  findSplit(uint32_t *begin, uint32_t *end, const Aabb &centroidBounds) const {
+    std::optional<Split> best;
+    for (int axis = 0; axis < 3; ++axis) {
+      if (centroidBounds.extent()[axis] <= 0)
+        continue;
+      std::array<Bin, NumBins> bins;
+      for (auto it = begin; it != end; ++it) {
+        auto &bin = bins[binFor(centroidBounds, axis, *it)];
+        bin.bounds = bin.bounds.including(bounds_[*it]);
+        bin.count++;
+      }
+      // Sweep from the right to find the cost of everything right of each
+      // split plane, then from the left to combine it with the left side.
+      std::array<double, NumBins> rightCost{};
+      Bin right;
+      for (auto bin = NumBins - 1; bin > 0; --bin) {
+        right.bounds = right.bounds.including(bins[bin].bounds);
+        right.count += bins[bin].count;
+        rightCost[bin] = right.bounds.surfaceArea() * right.count;
+      }
+      Bin left;
+      for (size_t bin = 1; bin < NumBins; ++bin) {
+        left.bounds = left.bounds.including(bins[bin - 1].bounds);
+        left.count += bins[bin - 1].count;
+        if (left.count == 0 || left.count == static_cast<size_t>(end - begin))
+          continue;
+        auto cost = left.bounds.surfaceArea() * left.count + rightCost[bin];
+        if (!best || cost < best->cost)
+          best = Split{axis, bin, cost};
+      }
+    }
+    return best;
+  }
+
+  uint32_t makeLeaf(uint32_t nodeIndex, uint32_t *begin, uint32_t *end) {
+    auto &node = bvh_.nodes[nodeIndex];
+    node.index = static_cast<uint32_t>(begin - bvh_.primitiveOrder.data());
+    node.numPrimitives = static_cast<uint32_t>(end - begin);
+    return nodeIndex;
+  }
+
+public:
+  SahBuilder(const std::vector<Aabb> &bounds, Bvh &bvh)
+      : bounds_(bounds), bvh_(bvh) {
+    centres_.reserve(bounds.size());
+    for (auto &box : bounds)
+      centres_.emplace_back(box.centre());
+  }
+
+  uint32_t build(uint32_t *begin, uint32_t *end, size_t depth) {
+    const auto nodeIndex = static_cast<uint32_t>(bvh_.nodes.size());
+    bvh_.nodes.emplace_back();
+
+    Aabb nodeBounds;
+    Aabb centroidBounds;
+    for (auto it = begin; it != end; ++it) {
+      nodeBounds = nodeBounds.including(bounds_[*it]);
+      centroidBounds = centroidBounds.including(centres_[*it]);
+    }
+    // Pad the stored bounds so that rays lying exactly in the plane of a
+    // flat box (e.g. one holding a single axis-aligned triangle) still hit it.
+    bvh_.nodes[nodeIndex].bounds = nodeBounds.expanded(Epsilon);
+
+    const auto count = static_cast<size_t>(end - begin);
+    if (count == 1)
+      return makeLeaf(nodeIndex, begin, end);
+
+    uint32_t *middle;
+    int axis;
+    auto split = depth < MaxSahDepth
+                     ? findSplit(begin, end, centroidBounds)
+                     : std::optional<Split>();
+    if (split) {
+      const auto leafCost = IntersectionCost * count;
+      const auto splitCost = TraversalCost
+                             + IntersectionCost * split->cost
+                                   / nodeBounds.surfaceArea();
+      if (count <= MaxLeafSize && leafCost <= splitCost)
+        return makeLeaf(nodeIndex, begin, end);
+      axis = split->axis;
+      middle = std::partition(begin, end, [&](uint32_t primitive) {
+        return binFor(centroidBounds, axis, primitive) < split->bin;
+      });
+    } else {
+      // Either every centroid coincides, or we're too deep to trust the SAH:
+      // split in half by count along the longest axis.
+      if (count <= MaxLeafSize)
+        return makeLeaf(nodeIndex, begin, end);
+      axis = centroidBounds.longestAxis();
+      middle = begin + count / 2;
+      std::nth_element(begin, middle, end, [&](uint32_t lhs, uint32_t rhs) {
+        return centres_[lhs][axis] < centres_[rhs][axis];
+      });
+    }
+
+    build(begin, middle, depth + 1);
+    const auto secondChild = build(middle, end, depth + 1);
+    auto &node = bvh_.nodes[nodeIndex];
+    node.index = secondChild;
+    node.splitAxis = static_cast<uint32_t>(axis);
+    return nodeIndex;
+  }
+};
+
+// Calls func(begin, end) on numThreads roughly equal slices of [0, count) in
+// parallel.
+template <typename Func>
+void parallelFor(size_t count, int numThreads, Func &&func) {
+  const auto numSlices = std::max<size_t>(1, numThreads);
+  std::vector<std::future<void>> futures;
+  for (size_t slice = 0; slice < numSlices; ++slice) {
+    const auto begin = count * slice / numSlices;
+    const auto end = count * (slice + 1) / numSlices;
+    futures.emplace_back(std::async(std::launch::async,
+                                    [&func, begin, end] { func(begin, end); }));
+  }
+  for (auto &future : futures)
+    future.get();
+}
+
+// Sorts each of numThreads slices in parallel, then merges pairs of sorted
+// runs in parallel until one run remains.
+template <typename T>
+void parallelSort(std::vector<T> &items, int numThreads) {
+  const auto numSlices = std::max<size_t>(1, numThreads);
+  std::vector<size_t> runStarts;
+  for (size_t slice = 0; slice <= numSlices; ++slice)
+    runStarts.emplace_back(items.size() * slice / numSlices);
+  parallelFor(numSlices, numThreads, [&](size_t begin, size_t end) {
+    for (auto slice = begin; slice < end; ++slice)
+      std::sort(items.begin() + runStarts[slice],
+                items.begin() + runStarts[slice + 1]);
+  });
+  while (runStarts.size() > 2) {
+    std::vector<size_t> merged;
+    std::vector<std::future<void>> futures;
+    for (size_t run = 0; run + 1 < runStarts.size(); run += 2) {
+      merged.emplace_back(runStarts[run]);
+      if (run + 2 >= runStarts.size())
+        break;
+      auto begin = items.begin() + runStarts[run];
+      auto middle = items.begin() + runStarts[run + 1];
+      auto end = items.begin() + runStarts[run + 2];
+      futures.emplace_back(std::async(std::launch::async, [=] {
+        std::inplace_merge(begin, middle, end);
+      }));
+    }
+    merged.emplace_back(runStarts.back());
+    for (auto &future : futures)
+      future.get();
+    runStarts = std::move(merged);
+  }
+}
+
+// Spreads the low 10 bits of x out so there are two zero bits between each.
+constexpr uint32_t expandBits(uint32_t x) noexcept {
+  x = (x * 0x00010001u) & 0xFF0000FFu;
+  x = (x * 0x00000101u) & 0x0F00F00Fu;
+  x = (x * 0x00000011u) & 0xC30C30C3u;
+  x = (x * 0x00000005u) & 0x49249249u;
+  return x;
+}
+
+// Spreads the low 21 bits of x out so there are two zero bits between each.
+constexpr uint64_t expandBits(uint64_t x) noexcept {
+  x &= 0x1fffffu;
+  x = (x | x << 32u) & 0x1f00000000ffffu;
+  x = (x | x << 16u) & 0x1f0000ff0000ffu;
+  x = (x | x << 8u) & 0x100f00f00f00f00fu;
+  x = (x | x << 4u) & 0x10c30c30c30c30c3u;
+  x = (x | x << 2u) & 0x1249249249249249u;
+  return x;
+}
+
+int highestSetBit(uint32_t x) noexcept { return 31 - __builtin_clz(x); }
+int highestSetBit(uint64_t x) noexcept { return 63 - __builtin_clzll(x); }
+
+template <typename Code>
+class LinearBuilder {
+  // 10 bits per axis for 32-bit codes, 21 for 64-bit.
+  static constexpr int BitsPerAxis = (8 * sizeof(Code)) / 3;
+  // Past this depth, ranges are split at their median so that the tree depth
+  // stays within Bvh::MaxDepth however the codes are distributed.
+  static constexpr size_t MaxMortonDepth = Bvh::MaxDepth / 2;
+
+  const std::vector<Aabb> &bounds_;
+  Bvh &bvh_;
+  std::vector<Code> codes_;
+
+  [[nodiscard]] Code mortonCode(const Vec3 &unitPos) const noexcept {
+    constexpr auto scale = static_cast<double>(1u << BitsPerAxis);
+    auto quantise = [](double x) {
+      return static_cast<Code>(std::clamp(x * scale, 0.0, scale - 1));
+    };
+    return (expandBits(quantise(unitPos.x())) << 2u)
+           | (expandBits(quantise(unitPos.y())) << 1u)
+           | expandBits(quantise(unitPos.z()));
+  }
+
+  // Finds the last index of the left half of a range: where the highest bit
+  // that differs between its first and last codes changes.
+  [[nodiscard]] std::pair<size_t, std::optional<int>>
+  findSplit(size_t first, size_t last, size_t depth) const noexcept {
+    const auto firstCode = codes_[first];
+    const auto lastCode = codes_[last];
+    if (firstCode == lastCode || depth >= MaxMortonDepth)
+      return {(first + last) / 2, std::nullopt};
+    const auto bit = highestSetBit(firstCode ^ lastCode);
+    const auto mask = static_cast<Code>(Code(1) << static_cast<unsigned>(bit));
+    const auto split = std::partition_point(
+        codes_.begin() + first, codes_.begin() + last + 1,
+        [mask](Code code) { return !(code & mask); });
+    // Bits go x, y, z from most to least significant within each triple.
+    return {static_cast<size_t>(split - codes_.begin()) - 1, 2 - bit % 3};
+  }
+
+  // Emits the subtree for primitives [first, last] with its root at
+  // nodeIndex. Every leaf holds one primitive, so a subtree over n primitives
+  // is always 2n - 1 nodes: the right child's position is known up front, and
+  // the two children can be emitted concurrently.
+  Aabb emit(size_t first, size_t last, size_t nodeIndex, size_t depth,
+            int numThreads) {
+    auto &node = bvh_.nodes[nodeIndex];
+    if (first == last) {
+      node.index = static_cast<uint32_t>(first);
+      node.numPrimitives = 1;
+      node.bounds = bounds_[bvh_.primitiveOrder[first]].expanded(Epsilon);
+      return node.bounds;
+    }
+
+    const auto [split, axis] = findSplit(first, last, depth);
+    const auto leftIndex = nodeIndex + 1;
+    const auto rightIndex = nodeIndex + 2 * (split - first + 1);
+    Aabb leftBounds;
+    Aabb rightBounds;
+    if (numThreads > 1) {
+      auto left = std::async(std::launch::async, [&, split = split] {
+        return emit(first, split, leftIndex, depth + 1, numThreads / 2);
+      });
+      rightBounds = emit(split + 1, last, rightIndex, depth + 1,
+                         numThreads - numThreads / 2);
+      leftBounds = left.get();
+    } else {
+      leftBounds = emit(first, split, leftIndex, depth + 1, 1);
+      rightBounds = emit(split + 1, last, rightIndex, depth + 1, 1);
+    }
+    node.index = static_cast<uint32_t>(rightIndex);
+    node.bounds = leftBounds.including(rightBounds);
+    node.splitAxis =
+        static_cast<uint32_t>(axis ? *axis : node.bounds.longestAxis());
+    return node.bounds;
+  }
+
+public:
+  LinearBuilder(const std::vector<Aabb> &bounds, Bvh &bvh)
+      : bounds_(bounds), bvh_(bvh) {}
+
+  void build(int numThreads) {
+    const auto count = bounds_.size();
+    Aabb centroidBounds;
+    for (auto &box : bounds_)
+      centroidBounds = centroidBounds.including(box.centre());
+    const auto min = centroidBounds.min();
+    const auto extent = centroidBounds.extent();
+    auto invExtent = [](double e) { return e > 0 ? 1.0 / e : 0.0; };
+    const auto scale = Vec3(invExtent(extent.x()), invExtent(extent.y()),
+                            invExtent(extent.z()));
+
+    // Sort by code, breaking ties by index so the result is deterministic.
+    std::vector<std::pair<Code, uint32_t>> keyed(count);
+    parallelFor(count, numThreads, [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; ++i)
+        keyed[i] = {mortonCode((bounds_[i].centre() - min) * scale),
+                    static_cast<uint32_t>(i)};
+    });
+    parallelSort(keyed, numThreads);
+
+    codes_.resize(count);
+    bvh_.primitiveOrder.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      codes_[i] = keyed[i].first;
+      bvh_.primitiveOrder[i] = keyed[i].second;
+    }
+    bvh_.nodes.resize(2 * count - 1);
+    emit(0, count - 1, 0, 0, numThreads);
+  }
+};
+
+}
+
+Bvh dod::buildSahBvh(const std::vector<Aabb> &primitiveBounds) {
+  Bvh bvh;
+  if (primitiveBounds.empty())
+    return bvh;
+  bvh.primitiveOrder.resize(primitiveBounds.size());
+  std::iota(bvh.primitiveOrder.begin(), bvh.primitiveOrder.end(), 0u);
+  bvh.nodes.reserve(2 * primitiveBounds.size());
+  SahBuilder builder(primitiveBounds, bvh);
+  auto *order = bvh.primitiveOrder.data();
+  builder.build(order, order + bvh.primitiveOrder.size(), 0);
+  return bvh;
+}
+
+Bvh dod::buildLinearBvh(const std::vector<Aabb> &primitiveBounds,
+                        int numThreads) {
+  Bvh bvh;
+  if (primitiveBounds.empty())
+    return bvh;
+  // 30-bit codes give a 1024^3 grid, plenty to tell most primitives apart in
+  // all but the largest scenes.
+  if (primitiveBounds.size() < (1u << 20u))
+    LinearBuilder<uint32_t>(primitiveBounds, bvh).build(numThreads);
+  else
+    LinearBuilder<uint64_t>(primitiveBounds, bvh).build(numThreads);
+  return bvh;
+}
+
+uint32_t dod::mortonCode(const Vec3 &unitPos) noexcept {
+  constexpr auto scale = static_cast<double>(1u << 10u);
+  auto quantise = [](double x) {
+    return static_cast<uint32_t>(std::clamp(x * scale, 0.0, scale - 1));
+  };
+  return (expandBits(quantise(unitPos.x())) << 2u)
+         | (expandBits(quantise(unitPos.y())) << 1u)
+         | expandBits(quantise(unitPos.z()));
+}
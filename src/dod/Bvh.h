@@ -0,0 +1,193 @@
+#pragma once
+
+#include "RayPacket.h"
+#include "math/Aabb.h"
+#include "math/Ray.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace dod {
+
+// A node in a flattened bounding volume hierarchy. Nodes are stored in
+// depth-first order, so an interior node's first child immediately follows it.
+struct BvhNode {
+  Aabb bounds;
+  // For leaves, the index of the first primitive; for interior nodes, the
+  // index of the second child.
+  uint32_t index{};
+  // Zero for interior nodes.
+  uint32_t numPrimitives{};
+  uint32_t splitAxis{};
+
+  [[nodiscard]] constexpr bool isLeaf() const noexcept {
+    return numPrimitives != 0;
+  }
+};
+
+struct Bvh {
+  // The builders guarantee no root-to-leaf path is longer than this.
+  static constexpr size_t MaxDepth = 64;
+
+  std::vector<BvhNode> nodes;
+  // Leaves refer to contiguous primitive ranges, so the primitives must be
+  // reordered to match: primitiveOrder[i] is the original index of the
+  // primitive that belongs in slot i.
+  std::vector<uint32_t> primitiveOrder;
+
+  [[nodiscard]] bool empty() const noexcept { return nodes.empty(); }
+
+  // Calls leafFunc(begin, end, nearerThan) for each leaf whose bounds the ray
+  // hits nearer than the current nearest; leafFunc returns the new nearest
+  // distance. Returns the final nearest distance.
+  template <typename LeafFunc>
+  double traverse(const Ray &ray, double nearerThan,
+                  LeafFunc &&leafFunc) const {
+    size_t nodeVisits = 0;
+    return traverse(ray, nearerThan, leafFunc, nodeVisits);
+  }
+
+  // As above, adding the number of nodes whose bounds were tested to
+  // nodeVisits.
+  template <typename LeafFunc>
+  double traverse(const Ray &ray, double nearerThan, LeafFunc &&leafFunc,
+                  size_t &nodeVisits) const {
+    if (nodes.empty())
+      return nearerThan;
+    const auto inverseDirection = Aabb::inverseDirection(ray);
+    const auto direction = ray.direction().toVec3();
+    std::array<uint32_t, MaxDepth> stack;
+    size_t stackSize = 0;
+    uint32_t nodeIndex = 0;
+    for (;;) {
+      const auto &node = nodes[nodeIndex];
+      ++nodeVisits;
+      if (node.bounds.intersects(ray, inverseDirection, nearerThan)) {
+        if (node.isLeaf()) {
+          nearerThan = leafFunc(node.index, node.index + node.numPrimitives,
+                                nearerThan);
+        } else {
+          // Visit the child on the side the ray comes from first, so the
+          // nearest hit is found early and prunes the other side.
+          auto first = nodeIndex + 1;
+          auto second = node.index;
+          if (direction[node.splitAxis] < 0)
+            std::swap(first, second);
+          stack[stackSize++] = second;
+          nodeIndex = first;
+          continue;
+        }
+      }
+      if (stackSize == 0)
+        break;
+      nodeIndex = stack[--stackSize];
+    }
+    return nearerThan;
+  }
+
+  // Calls leafFunc(begin, end) for each leaf whose bounds the ray hits nearer
+  // than maxDistance, stopping as soon as one returns true: for shadow rays,
+  // where any hit will do. Returns whether one did.
+  template <typename LeafFunc>
+  bool anyHit(const Ray &ray, double maxDistance, LeafFunc &&leafFunc,
+              size_t &nodeVisits) const {
+    if (nodes.empty())
+      return false;
+    const auto inverseDirection = Aabb::inverseDirection(ray);
+    std::array<uint32_t, MaxDepth> stack;
+    size_t stackSize = 0;
+    uint32_t nodeIndex = 0;
+    for (;;) {
+      const auto &node = nodes[nodeIndex];
+      ++nodeVisits;
+      if (node.bounds.intersects(ray, inverseDirection, maxDistance)) {
+        if (!node.isLeaf()) {
+          stack[stackSize++] = node.index;
+          nodeIndex = nodeIndex + 1;
+          continue;
+        }
+        if (leafFunc(node.index, node.index + node.numPrimitives))
+          return true;
+      }
+      if (stackSize == 0)
+        return false;
+      nodeIndex = stack[--stackSize];
+    }
+  }
+
+  // As above for a whole packet of rays, each with its own nearest distance
+  // in nearerThan. Rays travel down the tree together, tracking which of them
+  // are still active with a bitmask, and a node is skipped once none of them
+  // hit it. Calls leafFunc(rayIndex, begin, end, nearerThan) for each active
+  // ray at each leaf reached.
+  template <typename LeafFunc>
+  void traverse(const RayPacket &packet, RayPacket::Distances &nearerThan,
+                LeafFunc &&leafFunc) const {
+    size_t nodeVisits = 0;
+    traverse(packet, nearerThan, leafFunc, nodeVisits);
+  }
+
+  // As above, adding the number of nodes the packet fetched to nodeVisits.
+  template <typename LeafFunc>
+  void traverse(const RayPacket &packet, RayPacket::Distances &nearerThan,
+                LeafFunc &&leafFunc, size_t &nodeVisits) const {
+    if (nodes.empty())
+      return;
+    struct Entry {
+      uint32_t nodeIndex;
+      uint32_t activeRays;
+    };
+    std::array<Entry, MaxDepth> stack;
+    size_t stackSize = 0;
+    // Coherent rays agree on the order to visit children in.
+    const auto direction = packet.ray(0).direction().toVec3();
+    Entry current{0, packet.allRays()};
+    for (;;) {
+      const auto &node = nodes[current.nodeIndex];
+      ++nodeVisits;
+      const auto hitRays =
+          packet.intersects(node.bounds, nearerThan) & current.activeRays;
+      if (hitRays) {
+        if (node.isLeaf()) {
+          for (auto rays = hitRays; rays; rays &= rays - 1) {
+            const auto index = __builtin_ctz(rays);
+            nearerThan[index] =
+                leafFunc(static_cast<size_t>(index), node.index,
+                         node.index + node.numPrimitives, nearerThan[index]);
+          }
+        } else {
+          auto first = current.nodeIndex + 1;
+          auto second = node.index;
+          if (direction[node.splitAxis] < 0)
+            std::swap(first, second);
+          stack[stackSize++] = Entry{second, hitRays};
+          current = Entry{first, hitRays};
+          continue;
+        }
+      }
+      if (stackSize == 0)
+        break;
+      current = stack[--stackSize];
+    }
+  }
+};
+
+// Builds a hierarchy over the given primitive bounds using the surface area
+// heuristic.
+[[nodiscard]] Bvh buildSahBvh(const std::vector<Aabb> &primitiveBounds);
+
+// Builds a linear BVH: primitives are sorted by the Morton code of their
+// centres (30-bit codes, or 63-bit for very large scenes), and the hierarchy
+// is emitted from the sorted codes. Much quicker to build than the SAH, and
+// spread over numThreads threads, at the cost of a somewhat worse tree.
+[[nodiscard]] Bvh buildLinearBvh(const std::vector<Aabb> &primitiveBounds,
+                                 int numThreads);
+
+enum class BvhBuilder { SurfaceAreaHeuristic, Linear };
+
+// The 30-bit Morton code of a position within the unit cube: 10 bits per
+// axis, interleaved so that nearby positions mostly have nearby codes.
+[[nodiscard]] uint32_t mortonCode(const Vec3 &unitPos) noexcept;
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "math/Ray.h"
+#include "math/Sampler.h"
+#include "math/Vec3.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace dod {
+
+// A batch of paths in flight, as structure-of-arrays: the ray each traces
+// next, the weight its radiance carries back to its pixel, which pixel that
+// is, the sampler for the rest of the path, and the density the ray was
+// sampled with if it left a diffuse surface (else zero).
+struct PathBuffer {
+  std::vector<Ray> rays;
+  std::vector<Vec3> throughputs;
+  std::vector<uint32_t> pixels;
+  std::vector<Sampler> samplers;
+  std::vector<double> bsdfPdfs;
+
+  [[nodiscard]] size_t size() const noexcept { return rays.size(); }
+
+  void add(const Ray &ray, const Vec3 &throughput, uint32_t pixel,
+           const Sampler &sampler, double bsdfPdf) {
+    rays.emplace_back(ray);
+    throughputs.emplace_back(throughput);
+    pixels.emplace_back(pixel);
+    samplers.emplace_back(sampler);
+    bsdfPdfs.emplace_back(bsdfPdf);
+  }
+
+  // Rearranges the paths so that the path in slot i was in slot order[i].
+  void reorder(const std::vector<uint32_t> &order) {
+    PathBuffer reordered;
+    reordered.rays.reserve(size());
+    reordered.throughputs.reserve(size());
+    reordered.pixels.reserve(size());
+    reordered.samplers.reserve(size());
+    reordered.bsdfPdfs.reserve(size());
+    for (auto index : order)
+      reordered.add(rays[index], throughputs[index], pixels[index],
+                    samplers[index], bsdfPdfs[index]);
+    *this = std::move(reordered);
+  }
+
+  void clear() noexcept {
+    rays.clear();
+    throughputs.clear();
+    pixels.clear();
+    samplers.clear();
+    bsdfPdfs.clear();
+  }
+};
+
+}
@@ -0,0 +1,22 @@
+#include "RayPacket.h"
+
+#include <stdexcept>
+
+using dod::RayPacket;
+
+RayPacket::RayPacket(std::vector<Ray> rays) : rays_(std::move(rays)) {
+  if (rays_.empty() || rays_.size() > MaxSize)
+    throw std::runtime_error("Unsupported ray packet size");
+  inverseDirections_.reserve(rays_.size());
+  for (size_t i = 0; i < rays_.size(); ++i) {
+    const auto &origin = rays_[i].origin();
+    const auto &inverse =
+        inverseDirections_.emplace_back(Aabb::inverseDirection(rays_[i]));
+    originX_[i] = origin.x();
+    originY_[i] = origin.y();
+    originZ_[i] = origin.z();
+    inverseX_[i] = inverse.x();
+    inverseY_[i] = inverse.y();
+    inverseZ_[i] = inverse.z();
+  }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "math/Aabb.h"
+#include "math/Ray.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace dod {
+
+// A bundle of coherent rays (say, the primary rays for a small block of
+// pixels) traced through a BVH together, so each node fetched is tested
+// against all of them at once.
+class RayPacket {
+public:
+  // Enough for 4x4 pixels. Rays are tracked in bitmasks.
+  static constexpr size_t MaxSize = 16;
+  using Distances = std::array<double, MaxSize>;
+
+private:
+  std::vector<Ray> rays_;
+  std::vector<Vec3> inverseDirections_;
+  // The rays again as structure-of-arrays, for testing them all against a box
+  // at once. Lanes past the end of the packet are zero.
+  Distances originX_{}, originY_{}, originZ_{};
+  Distances inverseX_{}, inverseY_{}, inverseZ_{};
+
+public:
+  explicit RayPacket(std::vector<Ray> rays);
+
+  [[nodiscard]] size_t size() const noexcept { return rays_.size(); }
+  [[nodiscard]] const Ray &ray(size_t index) const noexcept {
+    return rays_[index];
+  }
+  [[nodiscard]] const Vec3 &inverseDirection(size_t index) const noexcept {
+    return inverseDirections_[index];
+  }
+  [[nodiscard]] uint32_t allRays() const noexcept {
+    return static_cast<uint32_t>((uint64_t(1) << rays_.size()) - 1);
+  }
+
+  // Returns the mask of rays that hit the box nearer than their own entry in
+  // nearerThan, each as Aabb::intersects() would decide. The lanes are
+  // independent and branch-free, so the compiler vectorises across the rays.
+  [[nodiscard]] uint32_t
+  intersects(const Aabb &box, const Distances &nearerThan) const noexcept {
+    const auto &min = box.min();
+    const auto &max = box.max();
+    constexpr auto robustScale = 1 + 4 * std::numeric_limits<double>::epsilon();
+    std::array<uint32_t, MaxSize> hit;
+    for (size_t lane = 0; lane < MaxSize; ++lane) {
+      const auto x0 = (min.x() - originX_[lane]) * inverseX_[lane];
+      const auto x1 = (max.x() - originX_[lane]) * inverseX_[lane];
+      const auto y0 = (min.y() - originY_[lane]) * inverseY_[lane];
+      const auto y1 = (max.y() - originY_[lane]) * inverseY_[lane];
+      const auto z0 = (min.z() - originZ_[lane]) * inverseZ_[lane];
+      const auto z1 = (max.z() - originZ_[lane]) * inverseZ_[lane];
+      const auto tNear =
+          std::max(std::max(0.0, std::min(x0, x1)),
+                   std::max(std::min(y0, y1), std::min(z0, z1)));
+      const auto tFar =
+          std::min(std::min(nearerThan[lane], std::max(x0, x1)),
+                   std::min(std::max(y0, y1), std::max(z0, z1)));
+      hit[lane] = tNear <= tFar * robustScale ? 1u << lane : 0u;
+    }
+    uint32_t mask = 0;
+    for (auto bit : hit)
+      mask |= bit;
+    return mask & allRays();
+  }
+};
+
+}
@@ -2,140 +2,358 @@
 #include "math/Epsilon.h"
 #include "math/OrthoNormalBasis.h"
 #include "math/Samples.h"
-#include "util/Progressifier.h"
-#include "util/Unpredictable.h"
+#include "util/CacheMissCounter.h"
+#include "util/PassRunner.h"
+#include "util/RenderProgress.h"
+#include "util/RussianRoulette.h"
+#include "util/TiledRender.h"
 
-#include <future>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
 
 using dod::IntersectionRecord;
 using dod::Scene;
 
-std::optional<IntersectionRecord>
-Scene::intersectSpheres(const Ray &ray, double nearerThan) const {
-  double currentNearestDist = nearerThan;
-  std::optional<size_t> nearestIndex;
-  for (size_t sphereIndex = 0; sphereIndex < spheres_.size(); ++sphereIndex) {
-    // Solve t^2*d.d + 2*t*(o-p).d + (o-p).(o-p)-R^2 = 0
-    auto op = spheres_[sphereIndex].centre - ray.origin();
-    auto b = op.dot(ray.direction().toVec3());
-    auto determinant =
-        b * b - op.lengthSquared() + spheres_[sphereIndex].radiusSquared;
-    if (determinant < 0)
-      continue;
+namespace {
 
-    determinant = sqrt(determinant);
-    auto minusT = b - determinant;
-    auto plusT = b + determinant;
-    if (minusT < Epsilon && plusT < Epsilon)
-      continue;
+template <typename AnyBvh>
+bool isEmpty(const AnyBvh &bvh) {
+  return std::visit([](const auto &b) { return b.empty(); }, bvh);
+}
 
-    auto t = minusT > Epsilon ? minusT : plusT;
-    if (t < currentNearestDist) {
-      nearestIndex = sphereIndex;
-      currentNearestDist = t;
-    }
+// Traverses whichever layout of hierarchy was built. With none built, every
+// primitive is in one big leaf.
+template <typename AnyBvh, typename LeafFunc>
+double traverse(const AnyBvh &bvh, size_t numPrimitives, const Ray &ray,
+                double nearerThan, LeafFunc &&leafFunc, size_t &nodeVisits) {
+  return std::visit(
+      [&](const auto &b) {
+        return b.empty() ? leafFunc(0, numPrimitives, nearerThan)
+                         : b.traverse(ray, nearerThan, leafFunc, nodeVisits);
+      },
+      bvh);
+}
+
+// As above for a packet of rays. Only the binary BVH traces packets; for the
+// others each ray goes on its own.
+template <typename AnyBvh, typename LeafFunc>
+void traverse(const AnyBvh &bvh, size_t numPrimitives,
+              const dod::RayPacket &packet,
+              dod::RayPacket::Distances &nearerThan, LeafFunc &&leafFunc,
+              size_t &nodeVisits) {
+  if (auto *binary = std::get_if<dod::Bvh>(&bvh); binary && !binary->empty()) {
+    binary->traverse(packet, nearerThan, leafFunc, nodeVisits);
+    return;
   }
-  if (!nearestIndex)
-    return {};
+  for (size_t ray = 0; ray < packet.size(); ++ray) {
+    nearerThan[ray] = traverse(
+        bvh, numPrimitives, packet.ray(ray), nearerThan[ray],
+        [&](size_t begin, size_t end, double nearer) {
+          return leafFunc(ray, begin, end, nearer);
+        },
+        nodeVisits);
+  }
+}
+
+// Asks each leaf the ray reaches whether the ray hits anything in it, until
+// one does.
+template <typename AnyBvh, typename LeafFunc>
+bool anyHit(const AnyBvh &bvh, size_t numPrimitives, const Ray &ray,
+            double maxDistance, LeafFunc &&leafFunc, size_t &nodeVisits) {
+  return std::visit(
+      [&](const auto &b) {
+        return b.empty() ? leafFunc(0, numPrimitives)
+                         : b.anyHit(ray, maxDistance, leafFunc, nodeVisits);
+      },
+      bvh);
+}
 
-  auto hitPosition = ray.positionAlong(currentNearestDist);
-  auto normal = (hitPosition - spheres_[*nearestIndex].centre).normalised();
+}
+
+IntersectionRecord Scene::sphereRecord(const Ray &ray, double distance,
+                                       size_t index) const {
+  auto hitPosition = ray.positionAlong(distance);
+  auto normal = (hitPosition - spheres_.centre(index)).normalised();
   bool inside = normal.dot(ray.direction()) > 0;
   if (inside)
     normal = -normal;
-  return IntersectionRecord{
-      Hit{currentNearestDist, inside, hitPosition, normal},
-      sphereMaterials_[*nearestIndex]};
+  return IntersectionRecord{Hit{distance, inside, hitPosition, normal},
+                            sphereMaterials_[index]};
 }
 
 std::optional<IntersectionRecord>
-Scene::intersectTriangles(const Ray &ray, double nearerThan) const {
-  double currentNearestDist = nearerThan;
-  struct Nearest {
-    size_t index;
-    double det;
-    double u;
-    double v;
-  };
-
-  std::optional<Nearest> nearest;
-  for (size_t i = 0; i < triangleVerts_.size(); ++i) {
-    const auto &tv = triangleVerts_[i];
-    const auto pVec = ray.direction().cross(tv.vVector());
-    const auto det = tv.uVector().dot(pVec);
-    // ray and triangle are parallel if det is close to 0
-    if (fabs(det) < Epsilon)
-      continue;
-
-    const auto invDet = 1.0 / det;
-    const auto tVec = ray.origin() - tv.vertex(0);
-    const auto u = tVec.dot(pVec) * invDet;
-    const auto qVec = tVec.cross(tv.uVector());
-    const auto v = ray.direction().dot(qVec) * invDet;
-
-    // This is an important optimisation:
-    // The overall chance of the ray intersecting this triangle is likely to be
-    // extremely small: so this comparison is almost always "true". HOWEVER, if
-    // the compiler implements this as a sequence of compare-and-branches, one
-    // for each continue, then each individual branch is essentially random and
-    // unpredictable. If the compiler is forced to emit only one branch (on the
-    // total result of the expression), then the branch is predictable. This
-    // makes a huge performance difference!
-    // I found GCC (9.1) very sensitive to the ordering of comparisons if I used
-    // regular logical or here: this bitwise or pretty much guarantees a single
-    // branch.
-    // (extra parens around variables are to prevent clang-format from getting
-    // confused).
-    if (Unpredictable::any((u) < 0.0, u > 1.0, (v) < 0.0, u + v > 1))
-      continue;
-
-    const auto t = tv.vVector().dot(qVec) * invDet;
+Scene::intersectSpheres(const Ray &ray, double nearerThan) const {
+  std::optional<size_t> nearestIndex;
+  auto distance =
+      spheres_.nearest(ray, 0, spheres_.size(), nearerThan, nearestIndex);
+  if (!nearestIndex)
+    return {};
+  return sphereRecord(ray, distance, *nearestIndex);
+}
 
-    if (t > Epsilon && t < currentNearestDist) {
-      nearest = Nearest{i, det, u, v};
-      currentNearestDist = t;
+double Scene::nearestTriangle(const Ray &ray, size_t begin, size_t end,
+                              double nearerThan,
+                              std::optional<NearestTriangle> &nearest) const {
+  constexpr auto Lanes = TriangleStore::Lanes;
+  constexpr auto inf = std::numeric_limits<double>::infinity();
+  const auto &tris = triangles_;
+  const auto ox = ray.origin().x();
+  const auto oy = ray.origin().y();
+  const auto oz = ray.origin().z();
+  const auto dx = ray.direction().x();
+  const auto dy = ray.direction().y();
+  const auto dz = ray.direction().z();
+  double currentNearestDist = nearerThan;
+  for (size_t block = begin; block < end; block += Lanes) {
+    std::array<double, Lanes> distance;
+    std::array<double, Lanes> dets;
+    std::array<double, Lanes> us;
+    std::array<double, Lanes> vs;
+    // Möller-Trumbore on a whole block at once. Each lane computes
+    // unconditionally and a mask picks out the hits, rather than each lane
+    // bailing out as soon as it misses: a miss is far more likely than a hit
+    // but which test rejects a triangle is essentially random, so a branch per
+    // test would be mispredicted constantly. Written this way there are no
+    // branches for the compiler to get wrong, and it can vectorise the loop.
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      const auto i = block + lane;
+      const auto px = dy * tris.e2z[i] - dz * tris.e2y[i];
+      const auto py = dz * tris.e2x[i] - dx * tris.e2z[i];
+      const auto pz = dx * tris.e2y[i] - dy * tris.e2x[i];
+      const auto det = tris.e1x[i] * px + tris.e1y[i] * py + tris.e1z[i] * pz;
+      const auto invDet = 1.0 / det;
+      const auto tx = ox - tris.v0x[i];
+      const auto ty = oy - tris.v0y[i];
+      const auto tz = oz - tris.v0z[i];
+      const auto u = (tx * px + ty * py + tz * pz) * invDet;
+      const auto qx = ty * tris.e1z[i] - tz * tris.e1y[i];
+      const auto qy = tz * tris.e1x[i] - tx * tris.e1z[i];
+      const auto qz = tx * tris.e1y[i] - ty * tris.e1x[i];
+      const auto v = (dx * qx + dy * qy + dz * qz) * invDet;
+      const auto t = (tris.e2x[i] * qx + tris.e2y[i] * qy + tris.e2z[i] * qz)
+                     * invDet;
+      // A det near zero means the ray and triangle are parallel. Lanes past
+      // the end of the range are masked off too.
+      const bool hit = (fabs(det) >= Epsilon) & (u >= 0.0) & (u <= 1.0)
+                       & (v >= 0.0) & (u + v <= 1.0) & (t > Epsilon)
+                       & (t < currentNearestDist) & (i < end);
+      distance[lane] = hit ? t : inf;
+      dets[lane] = det;
+      us[lane] = u;
+      vs[lane] = v;
+    }
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      if (distance[lane] < currentNearestDist) {
+        nearest = NearestTriangle{block + lane, dets[lane], us[lane], vs[lane]};
+        currentNearestDist = distance[lane];
+      }
     }
   }
-  if (!nearest)
-    return {};
-  auto &tn = triangleNormals_[nearest->index];
+  return currentNearestDist;
+}
+
+IntersectionRecord
+Scene::triangleRecord(const Ray &ray, double distance,
+                      const NearestTriangle &nearest) const {
+  auto &tn = triangleNormals_[nearest.index];
   auto normalUdelta = tn[1].toVec3() - tn[0].toVec3();
   auto normalVdelta = tn[2].toVec3() - tn[0].toVec3();
   // TODO: proper barycentric coordinates
-  const auto normal = ((nearest->u * normalUdelta) + (nearest->v * normalVdelta)
+  const auto normal = ((nearest.u * normalUdelta) + (nearest.v * normalVdelta)
                        + tn[0].toVec3())
                           .normalised();
-  bool backfacing = nearest->det < Epsilon;
-  return IntersectionRecord{Hit{currentNearestDist, backfacing,
-                                ray.positionAlong(currentNearestDist),
+  bool backfacing = nearest.det < Epsilon;
+  return IntersectionRecord{Hit{distance, backfacing,
+                                ray.positionAlong(distance),
                                 backfacing ? -normal : normal},
-                            triangleMaterials_[nearest->index]};
+                            triangleMaterials_[nearest.index]};
+}
+
+std::optional<IntersectionRecord>
+Scene::intersectTriangles(const Ray &ray, double nearerThan) const {
+  std::optional<NearestTriangle> nearest;
+  auto distance =
+      nearestTriangle(ray, 0, triangles_.size(), nearerThan, nearest);
+  if (!nearest)
+    return {};
+  return triangleRecord(ray, distance, *nearest);
+}
+
+bool Scene::anyTriangle(const Ray &ray, size_t begin, size_t end,
+                        double maxDistance) const {
+  constexpr auto Lanes = TriangleStore::Lanes;
+  const auto &tris = triangles_;
+  const auto ox = ray.origin().x();
+  const auto oy = ray.origin().y();
+  const auto oz = ray.origin().z();
+  const auto dx = ray.direction().x();
+  const auto dy = ray.direction().y();
+  const auto dz = ray.direction().z();
+  for (size_t block = begin; block < end; block += Lanes) {
+    // As nearestTriangle(), but only whether each lane hits, and a block at a
+    // time only until one does.
+    bool hitInBlock = false;
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      const auto i = block + lane;
+      const auto px = dy * tris.e2z[i] - dz * tris.e2y[i];
+      const auto py = dz * tris.e2x[i] - dx * tris.e2z[i];
+      const auto pz = dx * tris.e2y[i] - dy * tris.e2x[i];
+      const auto det = tris.e1x[i] * px + tris.e1y[i] * py + tris.e1z[i] * pz;
+      const auto invDet = 1.0 / det;
+      const auto tx = ox - tris.v0x[i];
+      const auto ty = oy - tris.v0y[i];
+      const auto tz = oz - tris.v0z[i];
+      const auto u = (tx * px + ty * py + tz * pz) * invDet;
+      const auto qx = ty * tris.e1z[i] - tz * tris.e1y[i];
+      const auto qy = tz * tris.e1x[i] - tx * tris.e1z[i];
+      const auto qz = tx * tris.e1y[i] - ty * tris.e1x[i];
+      const auto v = (dx * qx + dy * qy + dz * qz) * invDet;
+      const auto t = (tris.e2x[i] * qx + tris.e2y[i] * qy + tris.e2z[i] * qz)
+                     * invDet;
+      hitInBlock |= (fabs(det) >= Epsilon) & (u >= 0.0) & (u <= 1.0)
+                    & (v >= 0.0) & (u + v <= 1.0) & (t > Epsilon)
+                    & (t < maxDistance) & (i < end);
+    }
+    if (hitInBlock)
+      return true;
+  }
+  return false;
 }
 
 std::optional<IntersectionRecord> Scene::intersect(const Ray &ray) const {
-  auto sphereRec =
-      intersectSpheres(ray, std::numeric_limits<double>::infinity());
-  auto triangleRec = intersectTriangles(
-      ray, sphereRec ? sphereRec->hit.distance
-                     : std::numeric_limits<double>::infinity());
-  return triangleRec ? triangleRec : sphereRec;
+  size_t nodeVisits = 0;
+  return intersect(ray, nodeVisits);
+}
+
+bool Scene::occluded(const Ray &ray, double maxDistance) const {
+  size_t nodeVisits = 0;
+  return occluded(ray, maxDistance, nodeVisits);
+}
+
+bool Scene::occluded(const Ray &ray, double maxDistance,
+                     size_t &nodeVisits) const {
+  return anyHit(
+             sphereBvh_, spheres_.size(), ray, maxDistance,
+             [&](size_t begin, size_t end) {
+               return spheres_.anyHit(ray, begin, end, maxDistance);
+             },
+             nodeVisits)
+         || anyHit(
+             triangleBvh_, triangles_.size(), ray, maxDistance,
+             [&](size_t begin, size_t end) {
+               return anyTriangle(ray, begin, end, maxDistance);
+             },
+             nodeVisits);
+}
+
+std::optional<IntersectionRecord> Scene::intersect(const Ray &ray,
+                                                   size_t &nodeVisits) const {
+  auto nearestDist = std::numeric_limits<double>::infinity();
+  std::optional<size_t> nearestSphereIndex;
+  nearestDist = traverse(
+      sphereBvh_, spheres_.size(), ray, nearestDist,
+      [&](size_t begin, size_t end, double nearerThan) {
+        return spheres_.nearest(ray, begin, end, nearerThan,
+                                nearestSphereIndex);
+      },
+      nodeVisits);
+
+  std::optional<NearestTriangle> nearestTri;
+  nearestDist = traverse(
+      triangleBvh_, triangles_.size(), ray, nearestDist,
+      [&](size_t begin, size_t end, double nearerThan) {
+        return nearestTriangle(ray, begin, end, nearerThan, nearestTri);
+      },
+      nodeVisits);
+
+  if (nearestTri)
+    return triangleRecord(ray, nearestDist, *nearestTri);
+  if (nearestSphereIndex)
+    return sphereRecord(ray, nearestDist, *nearestSphereIndex);
+  return {};
+}
+
+std::vector<std::optional<IntersectionRecord>>
+Scene::intersect(const RayPacket &packet) const {
+  size_t nodeVisits = 0;
+  return intersect(packet, nodeVisits);
+}
+
+std::vector<std::optional<IntersectionRecord>>
+Scene::intersect(const RayPacket &packet, size_t &nodeVisits) const {
+  const auto size = packet.size();
+  RayPacket::Distances nearestDist;
+  nearestDist.fill(std::numeric_limits<double>::infinity());
+  std::vector<std::optional<size_t>> nearestSphereIndex(size);
+  traverse(sphereBvh_, spheres_.size(), packet, nearestDist,
+           [&](size_t ray, size_t begin, size_t end, double nearerThan) {
+             return spheres_.nearest(packet.ray(ray), begin, end, nearerThan,
+                                     nearestSphereIndex[ray]);
+           },
+           nodeVisits);
+
+  std::vector<std::optional<NearestTriangle>> nearestTri(size);
+  traverse(triangleBvh_, triangles_.size(), packet, nearestDist,
+           [&](size_t ray, size_t begin, size_t end, double nearerThan) {
+             return nearestTriangle(packet.ray(ray), begin, end, nearerThan,
+                                    nearestTri[ray]);
+           },
+           nodeVisits);
+
+  std::vector<std::optional<IntersectionRecord>> records;
+  records.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    if (nearestTri[i])
+      records.emplace_back(
+          triangleRecord(packet.ray(i), nearestDist[i], *nearestTri[i]));
+    else if (nearestSphereIndex[i])
+      records.emplace_back(
+          sphereRecord(packet.ray(i), nearestDist[i], *nearestSphereIndex[i]));
+    else
+      records.emplace_back();
+  }
+  return records;
 }
 
-Vec3 Scene::radiance(std::mt19937 &rng, const Ray &ray, int depth,
+Vec3 Scene::radiance(Sampler &sampler, const Ray &ray, int depth,
+                     double bsdfPdf, const Vec3 &throughput,
                      const RenderParams &renderParams) const {
-  int numUSamples = depth == 0 ? renderParams.firstBounceUSamples : 1;
-  int numVSamples = depth == 0 ? renderParams.firstBounceVSamples : 1;
   if (depth >= renderParams.maxDepth)
     return Vec3();
+  const auto survivor =
+      russianRoulette(sampler, throughput, depth, renderParams);
+  if (!survivor)
+    return Vec3();
+  return shade(sampler, ray, intersect(ray), depth, bsdfPdf, *survivor,
+               renderParams);
+}
+
+Vec3 Scene::directLight(Sampler &sampler, const Hit &hit, int depth,
+                        const RenderParams &renderParams) const {
+  // Light found at the last bounce wouldn't have been seen by chance either.
+  if (!renderParams.nextEvent || depth + 1 >= renderParams.maxDepth)
+    return Vec3();
+  return lights_.sampleDirect(
+      sampler, hit, [this](const Ray &shadowRay, double maxDistance) {
+        return occluded(shadowRay, maxDistance);
+      });
+}
 
-  const auto intersectionRecord = intersect(ray);
+Vec3 Scene::shade(Sampler &sampler, const Ray &ray,
+                  const std::optional<IntersectionRecord> &intersectionRecord,
+                  int depth, double bsdfPdf, const Vec3 &throughput,
+                  const RenderParams &renderParams) const {
+  int numUSamples = depth == 0 ? renderParams.firstBounceUSamples : 1;
+  int numVSamples = depth == 0 ? renderParams.firstBounceVSamples : 1;
   if (!intersectionRecord)
-    return environment_;
+    return throughput * environment_;
 
   const auto &mat = intersectionRecord->material;
   const auto &hit = intersectionRecord->hit;
   if (renderParams.preview)
-    return mat.diffuse;
+    return throughput * mat.diffuse;
 
   const auto [iorFrom, iorTo] =
       hit.inside ? std::make_pair(mat.indexOfRefraction, 1.0)
@@ -146,109 +364,428 @@ Vec3 Scene::radiance(std::mt19937 &rng, const Ray &ray, int depth,
           : mat.reflectivity;
 
   // Sample evenly with random offset.
-  std::uniform_real_distribution<> unit(0, 1.0);
+  const auto numSamples = numUSamples * numVSamples;
   // Create a coordinate system local to the point, where the z is the
   // normal at this point.
   const auto basis = OrthoNormalBasis::fromZ(hit.normal);
-  Vec3 result;
+  Vec3 result = throughput * mat.emission
+                * lights_.emissionWeight(ray, hit.distance, bsdfPdf);
+  // Each sample carries its share of the throughput.
+  const auto sampleThroughput = throughput / numSamples;
+  const auto diffuseThroughput = sampleThroughput * mat.diffuse;
 
   for (auto uSample = 0; uSample < numUSamples; ++uSample) {
     for (auto vSample = 0; vSample < numVSamples; ++vSample) {
-      const auto u = (static_cast<double>(uSample) + unit(rng))
-                     / static_cast<double>(numUSamples);
-      const auto v = (static_cast<double>(vSample) + unit(rng))
-                     / static_cast<double>(numVSamples);
-      const auto p = unit(rng);
+      auto branch = sampler.branch(uSample * numVSamples + vSample, numSamples);
+      const auto [u, v] =
+          branch.stratified2D(uSample, numUSamples, vSample, numVSamples);
+      const auto p = branch.next1D();
 
       if (p < reflectivity) {
         auto newRay =
             Ray(hit.position, coneSample(hit.normal.reflect(ray.direction()),
                                          mat.reflectionConeAngleRadians, u, v));
 
-        result += mat.emission + radiance(rng, newRay, depth + 1, renderParams);
+        result += radiance(branch, newRay, depth + 1, 0, sampleThroughput,
+                           renderParams);
       } else {
         auto newRay = Ray(hit.position, hemisphereSample(basis, u, v));
-
-        result +=
-            mat.emission
-            + mat.diffuse * radiance(rng, newRay, depth + 1, renderParams);
+        const auto direct = diffuseThroughput == Vec3()
+                                ? Vec3()
+                                : directLight(branch, hit, depth, renderParams);
+        const auto newPdf =
+            renderParams.nextEvent
+                ? hemisphereSamplePdf(hit.normal, newRay.direction())
+                : 0;
+
+        result += diffuseThroughput * direct
+                  + radiance(branch, newRay, depth + 1, newPdf,
+                             diffuseThroughput, renderParams);
       }
     }
   }
-  return result / (numUSamples * numVSamples);
+  return result;
 }
 
 void Scene::addTriangle(const Vec3 &v0, const Vec3 &v1, const Vec3 &v2,
                         const MaterialSpec &material) {
-  auto &tv = triangleVerts_.emplace_back(TriangleVertices{v0, v1, v2});
+  const auto tv = TriangleVertices{v0, v1, v2};
+  triangles_.add(tv);
   triangleNormals_.emplace_back(
       TriangleNormals{tv.faceNormal(), tv.faceNormal(), tv.faceNormal()});
   triangleMaterials_.emplace_back(material);
+  triangleBvh_ = Bvh();
 }
 
 void Scene::addSphere(const Vec3 &centre, double radius,
                       const MaterialSpec &material) {
-  spheres_.emplace_back(centre, radius);
+  spheres_.add(Sphere(centre, radius));
   sphereMaterials_.emplace_back(material);
+  lights_.add(centre, radius, material);
+  sphereBvh_ = Bvh();
 }
 
 void Scene::setEnvironmentColour(const Vec3 &colour) { environment_ = colour; }
 
+namespace {
+
+dod::Bvh build(dod::BvhBuilder builder, const std::vector<Aabb> &bounds,
+               int numThreads) {
+  switch (builder) {
+  case dod::BvhBuilder::SurfaceAreaHeuristic:
+    return dod::buildSahBvh(bounds);
+  case dod::BvhBuilder::Linear:
+    return dod::buildLinearBvh(bounds, numThreads);
+  }
+  throw std::logic_error("Unknown BVH builder");
+}
+
+template <typename AnyBvh>
+AnyBvh withWidth(dod::Bvh bvh, int width) {
+  switch (width) {
+  case 2:
+    return bvh;
+  case 4:
+    return dod::collapseBvh<4>(bvh);
+  case 8:
+    return dod::collapseBvh<8>(bvh);
+  }
+  throw std::runtime_error("Unsupported BVH width " + std::to_string(width));
+}
+
+template <typename T>
+void reorder(std::vector<T> &items, const std::vector<uint32_t> &order) {
+  std::vector<T> reordered;
+  reordered.reserve(items.size());
+  for (auto index : order)
+    reordered.emplace_back(items[index]);
+  items = std::move(reordered);
+}
+
+}
+
+void Scene::buildBvh(BvhBuilder builder, int numThreads, int width) {
+  if (isEmpty(triangleBvh_) && !triangles_.empty()) {
+    std::vector<Aabb> bounds;
+    bounds.reserve(triangles_.size());
+    for (size_t i = 0; i < triangles_.size(); ++i)
+      bounds.emplace_back(triangles_.bounds(i));
+    auto bvh = build(builder, bounds, numThreads);
+    triangles_.reorder(bvh.primitiveOrder);
+    reorder(triangleNormals_, bvh.primitiveOrder);
+    reorder(triangleMaterials_, bvh.primitiveOrder);
+    triangleBvh_ = withWidth<AnyBvh>(std::move(bvh), width);
+  }
+  if (isEmpty(sphereBvh_) && !spheres_.empty()) {
+    std::vector<Aabb> bounds;
+    bounds.reserve(spheres_.size());
+    for (size_t i = 0; i < spheres_.size(); ++i)
+      bounds.emplace_back(spheres_.bounds(i));
+    auto bvh = build(builder, bounds, numThreads);
+    spheres_.reorder(bvh.primitiveOrder);
+    reorder(sphereMaterials_, bvh.primitiveOrder);
+    sphereBvh_ = withWidth<AnyBvh>(std::move(bvh), width);
+  }
+}
+
+void Scene::renderPackets(const Camera &camera, int pass, ArrayOutput &output,
+                          const RenderParams &renderParams) const {
+  const auto width = renderParams.width;
+  const auto height = renderParams.height;
+  const auto size = renderParams.packetSize;
+  forEachRow(renderParams.deadline, height, size, [&](int blockY) {
+    for (auto blockX = 0; blockX < width; blockX += size) {
+      std::vector<std::pair<int, int>> pixels;
+      std::vector<Sampler> samplers;
+      std::vector<Ray> rays;
+      for (auto y = blockY; y < std::min(blockY + size, height); ++y) {
+        for (auto x = blockX; x < std::min(blockX + size, width); ++x) {
+          pixels.emplace_back(x, y);
+          samplers.emplace_back(renderParams.sampler, renderParams.seed,
+                                x + y * width, pass);
+          rays.emplace_back(camera.randomRay(x, y, samplers.back()));
+        }
+      }
+      const RayPacket packet(std::move(rays));
+      const auto intersections = intersect(packet);
+      // Only the primary rays travel together: each continues on its own from
+      // its first hit.
+      for (size_t i = 0; i < packet.size(); ++i) {
+        const auto [x, y] = pixels[i];
+        const auto colour = renderParams.maxDepth > 0
+                                ? shade(samplers[i], packet.ray(i),
+                                        intersections[i], 0, 0, Vec3(1, 1, 1),
+                                        renderParams)
+                                : Vec3();
+        output.addSamples(x, y, colour, 1);
+      }
+    }
+  });
+}
+
+void Scene::intersectAll(
+    const PathBuffer &paths,
+    std::vector<std::optional<IntersectionRecord>> &intersections,
+    const RenderParams &renderParams, WavefrontStats &stats) const {
+  intersections.clear();
+  intersections.reserve(paths.size());
+  const auto start = std::chrono::steady_clock::now();
+  const CacheMissCounter cacheMisses;
+  const auto packetSize =
+      static_cast<size_t>(renderParams.packetSize * renderParams.packetSize);
+  if (packetSize > 1) {
+    for (size_t first = 0; first < paths.size(); first += packetSize) {
+      const auto last = std::min(first + packetSize, paths.size());
+      const RayPacket packet(std::vector<Ray>(paths.rays.begin() + first,
+                                              paths.rays.begin() + last));
+      for (auto &record : intersect(packet, stats.nodeVisits))
+        intersections.emplace_back(std::move(record));
+    }
+  } else {
+    for (const auto &ray : paths.rays)
+      intersections.emplace_back(intersect(ray, stats.nodeVisits));
+  }
+  stats.raysTraced += paths.size();
+  stats.intersectTime += std::chrono::steady_clock::now() - start;
+  if (const auto count = cacheMisses.count(); count && stats.cacheMisses)
+    *stats.cacheMisses += *count;
+  else
+    stats.cacheMisses.reset();
+}
+
+void Scene::shadeAll(
+    PathBuffer &paths,
+    const std::vector<std::optional<IntersectionRecord>> &intersections,
+    int depth, const RenderParams &renderParams,
+    std::vector<Vec3> &pixelRadiance, PathBuffer &next) const {
+  const int numUSamples = depth == 0 ? renderParams.firstBounceUSamples : 1;
+  const int numVSamples = depth == 0 ? renderParams.firstBounceVSamples : 1;
+  const auto sampleWeight = 1.0 / (numUSamples * numVSamples);
+  const auto numSamples = static_cast<uint32_t>(numUSamples * numVSamples);
+  const bool lastBounce = depth + 1 >= renderParams.maxDepth;
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    const auto &ray = paths.rays[i];
+    const auto &throughput = paths.throughputs[i];
+    const auto pixel = paths.pixels[i];
+    const auto &intersectionRecord = intersections[i];
+    if (!intersectionRecord) {
+      pixelRadiance[pixel] += throughput * environment_;
+      continue;
+    }
+
+    const auto &mat = intersectionRecord->material;
+    const auto &hit = intersectionRecord->hit;
+    if (renderParams.preview) {
+      pixelRadiance[pixel] += throughput * mat.diffuse;
+      continue;
+    }
+    pixelRadiance[pixel] +=
+        throughput * mat.emission
+        * lights_.emissionWeight(ray, hit.distance, paths.bsdfPdfs[i]);
+    if (lastBounce)
+      continue;
+
+    const auto [iorFrom, iorTo] =
+        hit.inside ? std::make_pair(mat.indexOfRefraction, 1.0)
+                   : std::make_pair(1.0, mat.indexOfRefraction);
+    const auto reflectivity =
+        mat.reflectivity < 0
+            ? hit.normal.reflectance(ray.direction(), iorFrom, iorTo)
+            : mat.reflectivity;
+    const auto basis = OrthoNormalBasis::fromZ(hit.normal);
+    const auto diffuseThroughput = throughput * mat.diffuse * sampleWeight;
+
+    for (auto uSample = 0; uSample < numUSamples; ++uSample) {
+      for (auto vSample = 0; vSample < numVSamples; ++vSample) {
+        auto branch = paths.samplers[i].branch(
+            uSample * numVSamples + vSample, numSamples);
+        const auto [u, v] =
+            branch.stratified2D(uSample, numUSamples, vSample, numVSamples);
+        const auto p = branch.next1D();
+
+        if (p < reflectivity) {
+          const auto newRay =
+              Ray(hit.position, coneSample(hit.normal.reflect(ray.direction()),
+                                           mat.reflectionConeAngleRadians, u,
+                                           v));
+          if (const auto survivor = russianRoulette(
+                  branch, throughput * sampleWeight, depth + 1, renderParams))
+            next.add(newRay, *survivor, pixel, branch, 0);
+        } else if (diffuseThroughput != Vec3()) {
+          // Shadow rays are traced there and then, not batched.
+          const auto newRay = Ray(hit.position, hemisphereSample(basis, u, v));
+          pixelRadiance[pixel] +=
+              diffuseThroughput * directLight(branch, hit, depth, renderParams);
+          if (const auto survivor = russianRoulette(
+                  branch, diffuseThroughput, depth + 1, renderParams))
+            next.add(newRay, *survivor, pixel, branch,
+                     renderParams.nextEvent
+                         ? hemisphereSamplePdf(hit.normal, newRay.direction())
+                         : 0);
+        }
+      }
+    }
+  }
+}
+
+namespace {
+
+// An order for the paths that bins them by direction octant and then by the
+// Morton code of the cell their origin lies in, so rays traced one after the
+// other mostly visit the same parts of the BVH. A counting sort on the bin
+// keeps this linear in the number of paths, and stable.
+std::vector<uint32_t> coherentOrder(const dod::PathBuffer &paths) {
+  // 4 bits per axis of origin cell, below the 3 bits of octant.
+  constexpr uint32_t CellBits = 12;
+  constexpr uint32_t NumBins = 8u << CellBits;
+  Aabb originBounds;
+  for (const auto &ray : paths.rays)
+    originBounds = originBounds.including(ray.origin());
+  const auto extent = originBounds.extent();
+  const auto scale = Vec3(extent.x() > 0 ? 1 / extent.x() : 0,
+                          extent.y() > 0 ? 1 / extent.y() : 0,
+                          extent.z() > 0 ? 1 / extent.z() : 0);
+  std::vector<uint32_t> bins;
+  bins.reserve(paths.size());
+  std::vector<uint32_t> binStarts(NumBins + 1);
+  for (const auto &ray : paths.rays) {
+    const auto direction = ray.direction();
+    const auto octant = (direction.x() < 0 ? 4u : 0u)
+                        | (direction.y() < 0 ? 2u : 0u)
+                        | (direction.z() < 0 ? 1u : 0u);
+    const auto cell =
+        dod::mortonCode((ray.origin() - originBounds.min()) * scale)
+        >> (30u - CellBits);
+    const auto bin = (octant << CellBits) | cell;
+    bins.emplace_back(bin);
+    binStarts[bin + 1]++;
+  }
+  for (size_t bin = 0; bin < NumBins; ++bin)
+    binStarts[bin + 1] += binStarts[bin];
+  std::vector<uint32_t> order(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i)
+    order[binStarts[bins[i]]++] = static_cast<uint32_t>(i);
+  return order;
+}
+
+}
+
+dod::WavefrontStats
+Scene::renderWavefront(const Camera &camera, int pass,
+                       ArrayOutput &output,
+                       const RenderParams &renderParams) const {
+  // Each primary ray can fan out into many paths at the first bounce, so
+  // the image is traced a batch of pixels at a time to bound the buffers.
+  constexpr size_t PixelsPerBatch = 16384;
+  const auto width = static_cast<size_t>(renderParams.width);
+  const auto numPixels = width * static_cast<size_t>(renderParams.height);
+  PathBuffer paths;
+  PathBuffer next;
+  std::vector<std::optional<IntersectionRecord>> intersections;
+  std::vector<Vec3> pixelRadiance;
+  WavefrontStats stats;
+  const auto &deadline = renderParams.deadline;
+  forEachRow(deadline, numPixels, PixelsPerBatch, [&](size_t first) {
+    const auto last = std::min(first + PixelsPerBatch, numPixels);
+    pixelRadiance.assign(last - first, Vec3());
+    paths.clear();
+    for (auto pixel = first; pixel < last; ++pixel) {
+      Sampler sampler(renderParams.sampler, renderParams.seed, pixel, pass);
+      const auto ray = camera.randomRay(static_cast<int>(pixel % width),
+                                        static_cast<int>(pixel / width),
+                                        sampler);
+      paths.add(ray, Vec3(1, 1, 1), static_cast<uint32_t>(pixel - first),
+                sampler, 0);
+    }
+    for (auto depth = 0; depth < renderParams.maxDepth && paths.size();
+         ++depth) {
+      if (renderParams.sortRays) {
+        const auto start = std::chrono::steady_clock::now();
+        paths.reorder(coherentOrder(paths));
+        stats.sortTime += std::chrono::steady_clock::now() - start;
+      }
+      intersectAll(paths, intersections, renderParams, stats);
+      next.clear();
+      shadeAll(paths, intersections, depth, renderParams, pixelRadiance,
+               next);
+      std::swap(paths, next);
+    }
+    for (auto pixel = first; pixel < last; ++pixel)
+      output.addSamples(static_cast<int>(pixel % width),
+                        static_cast<int>(pixel / width),
+                        pixelRadiance[pixel - first], 1);
+  });
+  return stats;
+}
+
 ArrayOutput
 Scene::render(const Camera &camera, const RenderParams &renderParams,
               const std::function<void(ArrayOutput &output)> &updateFunc) {
   auto width = renderParams.width;
   auto height = renderParams.height;
-
-  // TODO no raw loops...maybe return whole "Samples" of an entire screen and
-  // accumulate separately? then feeds into a nice multithreaded future based
-  // thing?
-
-  int curSample = 0;
-  auto launch = [&] {
-    return std::async(std::launch::async, [&] {
-      ArrayOutput output(width, height);
-      std::mt19937 rng(renderParams.seed + curSample++);
-      for (auto y = 0; y < height; ++y) {
-        for (auto x = 0; x < width; ++x) {
-          auto ray = camera.randomRay(x, y, rng);
-          output.addSamples(x, y, radiance(rng, ray, 0, renderParams), 1);
-        }
-      }
+  if (renderParams.packetSize < 1
+      || static_cast<size_t>(renderParams.packetSize * renderParams.packetSize)
+             > RayPacket::MaxSize)
+    throw std::runtime_error("Unsupported packet size "
+                             + std::to_string(renderParams.packetSize));
+  if (renderParams.sortRays && !renderParams.wavefront)
+    throw std::runtime_error("Sorting rays needs the wavefront renderer");
+  buildBvh();
+  wavefrontStats_ = WavefrontStats();
+
+  const auto &deadline = renderParams.deadline;
+  auto renderPass = [&](int pass) {
+    ArrayOutput output(width, height);
+    if (renderParams.wavefront) {
+      const auto stats = renderWavefront(camera, pass, output, renderParams);
+      std::lock_guard lock(wavefrontStatsMutex_);
+      wavefrontStats_ += stats;
+      return output;
+    }
+    if (renderParams.packetSize > 1) {
+      renderPackets(camera, pass, output, renderParams);
       return output;
+    }
+    forEachRow(deadline, height, 1, [&](int y) {
+      for (auto x = 0; x < width; ++x) {
+        Sampler sampler(renderParams.sampler, renderParams.seed, x + y * width,
+                        pass);
+        auto ray = camera.randomRay(x, y, sampler);
+        output.addSamples(x, y,
+                          radiance(sampler, ray, 0, 0, Vec3(1, 1, 1),
+                                   renderParams),
+                          1);
+      }
     });
-  };
-
-  std::vector<std::future<ArrayOutput>> futures;
-  auto ensureMaxCpus = [&] {
-    auto numLeft = renderParams.samplesPerPixel - curSample;
-    auto numSpareCpus = renderParams.maxCpus - futures.size();
-    auto numToSpawn = std::min<size_t>(numLeft, numSpareCpus);
-    for (auto i = 0u; i < numToSpawn; ++i)
-      futures.emplace_back(launch());
+    return output;
   };
 
   size_t numDone = 0;
   ArrayOutput output(width, height);
-  Progressifier progressifier(renderParams.samplesPerPixel);
-  do {
-    ensureMaxCpus();
-    const auto firstDone =
-        std::find_if(futures.begin(), futures.end(), [&](auto &f) {
-          return f.wait_for(std::chrono::milliseconds(1))
-                 == std::future_status ::ready;
-        });
-    if (firstDone != futures.end()) {
-      output += firstDone->get();
-      numDone++;
-      progressifier.update(numDone);
-      updateFunc(output);
-      futures.erase(firstDone);
-    } else {
-      std::this_thread::sleep_for(std::chrono::milliseconds(250));
-    }
-
-  } while (curSample < renderParams.samplesPerPixel);
+  RenderProgress progress(deadline, renderParams.samplesPerPixel);
+  runPasses(
+      renderParams.numPasses(), renderParams.maxCpus, renderPass,
+      [&](ArrayOutput pass) {
+        output += pass;
+        numDone++;
+        progress.update(numDone);
+        updateFunc(output);
+      },
+      deadline);
 
   return output;
 }
+
+ArrayOutput Scene::renderTiled(
+    const Camera &camera, const RenderParams &renderParams,
+    const std::function<void(const ArrayOutput &)> &updateFunc) {
+  buildBvh();
+  return ::renderTiled(
+      renderParams,
+      [&](Sampler &sampler, int x, int y, const RenderParams &params) {
+        return radiance(sampler, camera.randomRay(x, y, sampler), 0, 0,
+                        Vec3(1, 1, 1), params);
+      },
+      updateFunc);
+}
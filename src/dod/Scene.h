@@ -1,19 +1,28 @@
 #pragma once
 
+#include "Bvh.h"
 #include "IntersectionRecord.h"
-#include "Sphere.h"
+#include "PathBuffer.h"
+#include "SphereStore.h"
+#include "TriangleStore.h"
 #include "TriangleVertices.h"
+#include "WavefrontStats.h"
+#include "WideBvh.h"
 #include "math/Camera.h"
+#include "math/Sampler.h"
 #include "math/Ray.h"
 #include "math/Vec3.h"
 #include "util/ArrayOutput.h"
 #include "util/MaterialSpec.h"
 #include "util/RenderParams.h"
+#include "util/SphereLights.h"
 
 #include <array>
 #include <functional>
+#include <mutex>
 #include <optional>
 #include <random>
+#include <variant>
 #include <vector>
 
 namespace dod {
@@ -21,17 +30,104 @@ namespace dod {
 class Scene {
   using TriangleNormals = std::array<Norm3, 3>;
 
-  std::vector<TriangleVertices> triangleVerts_;
+  TriangleStore triangles_;
   std::vector<TriangleNormals> triangleNormals_;
   std::vector<MaterialSpec> triangleMaterials_;
 
-  std::vector<Sphere> spheres_;
+  SphereStore spheres_;
   std::vector<MaterialSpec> sphereMaterials_;
+  SphereLights lights_;
+
+  // Empty until buildBvh() is called, and again after any primitive is added.
+  // The layout (binary, 4- or 8-wide) is chosen when building.
+  using AnyBvh = std::variant<Bvh, WideBvh<4>, WideBvh<8>>;
+  AnyBvh triangleBvh_;
+  AnyBvh sphereBvh_;
 
   Vec3 environment_;
 
+  std::mutex wavefrontStatsMutex_;
+  WavefrontStats wavefrontStats_;
+
+  struct NearestTriangle {
+    size_t index;
+    double det;
+    double u;
+    double v;
+  };
+  double nearestTriangle(const Ray &ray, size_t begin, size_t end,
+                         double nearerThan,
+                         std::optional<NearestTriangle> &nearest) const;
+  [[nodiscard]] IntersectionRecord
+  triangleRecord(const Ray &ray, double distance,
+                 const NearestTriangle &nearest) const;
+  // Whether the ray hits any triangle in [begin, end) nearer than
+  // maxDistance.
+  [[nodiscard]] bool anyTriangle(const Ray &ray, size_t begin, size_t end,
+                                 double maxDistance) const;
+
+  [[nodiscard]] IntersectionRecord sphereRecord(const Ray &ray,
+                                                double distance,
+                                                size_t index) const;
+
+  // The radiance along a ray whose intersection with the scene is known,
+  // scaled by throughput.
+  [[nodiscard]] Vec3
+  shade(Sampler &sampler, const Ray &ray,
+        const std::optional<IntersectionRecord> &intersectionRecord,
+        int depth, double bsdfPdf, const Vec3 &throughput,
+        const RenderParams &renderParams) const;
+
+  // With renderParams.nextEvent, the light arriving at a diffuse surface
+  // straight from the lights, weighted against finding them by chance.
+  [[nodiscard]] Vec3 directLight(Sampler &sampler, const Hit &hit, int depth,
+                                 const RenderParams &renderParams) const;
+
+  // Renders the given pass's sample for each pixel, tracing the primary rays
+  // in packets of renderParams.packetSize squared pixels. Each pixel's path
+  // uses the same generator as it would unpacketed, so gives the same result.
+  void renderPackets(const Camera &camera, int pass, ArrayOutput &output,
+                     const RenderParams &renderParams) const;
+
+  // As the public versions, adding the number of BVH nodes fetched to
+  // nodeVisits.
+  [[nodiscard]] std::optional<IntersectionRecord>
+  intersect(const Ray &ray, size_t &nodeVisits) const;
+  [[nodiscard]] std::vector<std::optional<IntersectionRecord>>
+  intersect(const RayPacket &packet, size_t &nodeVisits) const;
+  [[nodiscard]] bool occluded(const Ray &ray, double maxDistance,
+                              size_t &nodeVisits) const;
+
+  // Renders the given pass's sample for each pixel breadth-first. Rather
+  // than following each path to the end before starting the next, a batch of
+  // paths advances a bounce at a time: intersect them all, shade them all
+  // (adding what they pick up to their pixels, and spawning the next bounce's
+  // paths), then carry on with the survivors. With renderParams.sortRays the
+  // paths are binned by where they start and which way they go before each
+  // bounce, and with renderParams.packetSize runs of neighbouring paths are
+  // traced together as packets.
+  [[nodiscard]] WavefrontStats
+  renderWavefront(const Camera &camera, int pass, ArrayOutput &output,
+                  const RenderParams &renderParams) const;
+  void intersectAll(
+      const PathBuffer &paths,
+      std::vector<std::optional<IntersectionRecord>> &intersections,
+      const RenderParams &renderParams, WavefrontStats &stats) const;
+  // As shade(), for every path at the given depth. Paths that can no longer
+  // contribute anything, or that lose at Russian roulette, are dropped rather
+  // than added to next.
+  void
+  shadeAll(PathBuffer &paths,
+           const std::vector<std::optional<IntersectionRecord>> &intersections,
+           int depth, const RenderParams &renderParams,
+           std::vector<Vec3> &pixelRadiance, PathBuffer &next) const;
+
 public:
-  [[nodiscard]] Vec3 radiance(std::mt19937 &rng, const Ray &ray, int depth,
+  // The radiance along the ray, scaled by throughput: the weight it carries
+  // back to its pixel. bsdfPdf is the density the ray was sampled with, if it
+  // left a diffuse surface, or zero.
+  [[nodiscard]] Vec3 radiance(Sampler &sampler, const Ray &ray, int depth,
+                              double bsdfPdf, const Vec3 &throughput,
                               const RenderParams &renderParams) const;
 
   void addTriangle(const Vec3 &v0, const Vec3 &v1, const Vec3 &v2,
@@ -41,9 +137,26 @@ public:
 
   void setEnvironmentColour(const Vec3 &colour);
 
+  // Builds the acceleration structures used by intersect(). Call once the
+  // scene is complete; this reorders the primitives. The linear builder uses
+  // up to numThreads threads. A width of 4 or 8 collapses the built binary
+  // tree into nodes whose children are all tested at once.
+  void buildBvh(BvhBuilder builder = BvhBuilder::SurfaceAreaHeuristic,
+                int numThreads = 1, int width = 2);
+
   ArrayOutput
   render(const Camera &camera, const RenderParams &renderParams,
          const std::function<void(ArrayOutput &output)> &updateFunc);
+  // As render(), but a tile at a time, so memory use doesn't grow with the
+  // number of threads.
+  ArrayOutput
+  renderTiled(const Camera &camera, const RenderParams &renderParams,
+              const std::function<void(const ArrayOutput &)> &updateFunc);
+
+  // Totals for the wavefront renderer's passes in the last render().
+  [[nodiscard]] const WavefrontStats &wavefrontStats() const noexcept {
+    return wavefrontStats_;
+  }
 
   // Visible for tests
   [[nodiscard]] std::optional<IntersectionRecord>
@@ -52,8 +165,19 @@ public:
   [[nodiscard]] std::optional<IntersectionRecord>
   intersectTriangles(const Ray &ray, double nearerThan) const;
 
+  // Uses the BVH if it has been built, else tests every primitive.
   [[nodiscard]] std::optional<dod::IntersectionRecord>
   intersect(const Ray &ray) const;
+
+  // Whether anything lies along the ray nearer than maxDistance. Cheaper than
+  // intersect(): it stops at the first hit found, and works out nothing about
+  // it.
+  [[nodiscard]] bool occluded(const Ray &ray, double maxDistance) const;
+
+  // Intersects every ray in the packet, tracing them through the binary BVH
+  // together. Wide BVHs trace them one by one.
+  [[nodiscard]] std::vector<std::optional<IntersectionRecord>>
+  intersect(const RayPacket &packet) const;
 };
 
 }
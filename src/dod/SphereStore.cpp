@@ -0,0 +1,231 @@
+#include "SphereStore.h"
+#include "math/Epsilon.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+using dod::SphereStore;
+
+void SphereStore::pad() {
+  for (auto *array : {&centreX, &centreY, &centreZ, &radiusSquared})
+    array->resize(size_ + Lanes - 1);
+}
+
+void SphereStore::add(const Sphere &sphere) {
+  const auto index = size_++;
+  pad();
+  centreX[index] = sphere.centre.x();
+  centreY[index] = sphere.centre.y();
+  centreZ[index] = sphere.centre.z();
+  radiusSquared[index] = sphere.radiusSquared;
+}
+
+Aabb SphereStore::bounds(size_t index) const noexcept {
+  const auto radius = sqrt(radiusSquared[index]);
+  const auto offset = Vec3(radius, radius, radius);
+  return Aabb(centre(index) - offset, centre(index) + offset);
+}
+
+void SphereStore::reorder(const std::vector<uint32_t> &order) {
+  for (auto *array : {&centreX, &centreY, &centreZ, &radiusSquared}) {
+    std::vector<double> reordered;
+    reordered.reserve(size_ + Lanes - 1);
+    for (auto index : order)
+      reordered.emplace_back((*array)[index]);
+    *array = std::move(reordered);
+  }
+  pad();
+}
+
+double
+SphereStore::nearestScalar(const Ray &ray, size_t begin, size_t end,
+                           double nearerThan,
+                           std::optional<size_t> &nearestIndex) const noexcept {
+  double currentNearestDist = nearerThan;
+  for (size_t sphereIndex = begin; sphereIndex < end; ++sphereIndex) {
+    // Solve t^2*d.d + 2*t*(o-p).d + (o-p).(o-p)-R^2 = 0
+    auto op = centre(sphereIndex) - ray.origin();
+    auto b = op.dot(ray.direction().toVec3());
+    auto determinant = b * b - op.lengthSquared() + radiusSquared[sphereIndex];
+    if (determinant < 0)
+      continue;
+
+    determinant = sqrt(determinant);
+    auto minusT = b - determinant;
+    auto plusT = b + determinant;
+    if (minusT < Epsilon && plusT < Epsilon)
+      continue;
+
+    auto t = minusT > Epsilon ? minusT : plusT;
+    if (t < currentNearestDist) {
+      nearestIndex = sphereIndex;
+      currentNearestDist = t;
+    }
+  }
+  return currentNearestDist;
+}
+
+#ifdef __AVX__
+
+namespace {
+
+// A ray broadcast to every lane.
+struct RayLanes {
+  __m256d ox, oy, oz;
+  __m256d dx, dy, dz;
+  explicit RayLanes(const Ray &ray) noexcept
+      : ox(_mm256_set1_pd(ray.origin().x())),
+        oy(_mm256_set1_pd(ray.origin().y())),
+        oz(_mm256_set1_pd(ray.origin().z())),
+        dx(_mm256_set1_pd(ray.direction().x())),
+        dy(_mm256_set1_pd(ray.direction().y())),
+        dz(_mm256_set1_pd(ray.direction().z())) {}
+};
+
+struct BlockHits {
+  // Non-zero if any lane has real roots, even if they're behind the ray or
+  // too far away. If not, the others are unset.
+  int anyRoots;
+  __m256d t;
+  // All ones in the lanes whose sphere is hit at t, in front of the ray.
+  __m256d hit;
+};
+
+// As nearestScalar(), for the four spheres starting at block at once.
+BlockHits intersectBlock(const SphereStore &store, size_t block,
+                         const RayLanes &ray) noexcept {
+  const auto opx =
+      _mm256_sub_pd(_mm256_loadu_pd(&store.centreX[block]), ray.ox);
+  const auto opy =
+      _mm256_sub_pd(_mm256_loadu_pd(&store.centreY[block]), ray.oy);
+  const auto opz =
+      _mm256_sub_pd(_mm256_loadu_pd(&store.centreZ[block]), ray.oz);
+  const auto b = _mm256_add_pd(
+      _mm256_add_pd(_mm256_mul_pd(opx, ray.dx), _mm256_mul_pd(opy, ray.dy)),
+      _mm256_mul_pd(opz, ray.dz));
+  const auto opLengthSquared = _mm256_add_pd(
+      _mm256_add_pd(_mm256_mul_pd(opx, opx), _mm256_mul_pd(opy, opy)),
+      _mm256_mul_pd(opz, opz));
+  const auto determinant =
+      _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(b, b), opLengthSquared),
+                    _mm256_loadu_pd(&store.radiusSquared[block]));
+  // Most rays miss most spheres outright: skip the (slow) square root when
+  // the whole block does.
+  const auto realRoots =
+      _mm256_cmp_pd(determinant, _mm256_setzero_pd(), _CMP_GE_OQ);
+  BlockHits hits{_mm256_movemask_pd(realRoots), {}, {}};
+  if (!hits.anyRoots)
+    return hits;
+  // Negative determinants give NaNs here, but those lanes are masked off.
+  const auto epsilon = _mm256_set1_pd(Epsilon);
+  const auto root = _mm256_sqrt_pd(determinant);
+  const auto minusT = _mm256_sub_pd(b, root);
+  const auto plusT = _mm256_add_pd(b, root);
+  hits.t = _mm256_blendv_pd(plusT, minusT,
+                            _mm256_cmp_pd(minusT, epsilon, _CMP_GT_OQ));
+  // The scalar version's two rejections of an intersection behind the ray
+  // both amount to the chosen t being below epsilon.
+  hits.hit =
+      _mm256_and_pd(realRoots, _mm256_cmp_pd(hits.t, epsilon, _CMP_GE_OQ));
+  return hits;
+}
+
+}
+
+double SphereStore::nearest(const Ray &ray, size_t begin, size_t end,
+                            double nearerThan,
+                            std::optional<size_t> &nearestIndex) const
+    noexcept {
+  static_assert(Lanes == 4, "one AVX register of doubles per block");
+  const RayLanes rayLanes(ray);
+  const auto endIndex = _mm256_set1_pd(static_cast<double>(end));
+  const auto laneOffsets = _mm256_set_pd(3, 2, 1, 0);
+  // Each lane keeps its own nearest distance and sphere index (held as a
+  // double, which is exact for any index we could have), and the lanes are
+  // only combined once at the end.
+  auto laneNearest = _mm256_set1_pd(nearerThan);
+  auto laneNearestIndex = _mm256_set1_pd(-1);
+  for (size_t block = begin; block < end; block += Lanes) {
+    const auto hits = intersectBlock(*this, block, rayLanes);
+    if (!hits.anyRoots)
+      continue;
+    const auto index =
+        _mm256_add_pd(_mm256_set1_pd(static_cast<double>(block)), laneOffsets);
+    const auto hit = _mm256_and_pd(
+        hits.hit,
+        _mm256_and_pd(_mm256_cmp_pd(hits.t, laneNearest, _CMP_LT_OQ),
+                      _mm256_cmp_pd(index, endIndex, _CMP_LT_OQ)));
+    laneNearest = _mm256_blendv_pd(laneNearest, hits.t, hit);
+    laneNearestIndex = _mm256_blendv_pd(laneNearestIndex, index, hit);
+  }
+
+  // Horizontal minimum: swap the 128-bit halves, then neighbouring pairs,
+  // leaving the overall minimum in every lane.
+  auto minimum = _mm256_min_pd(
+      laneNearest, _mm256_permute2f128_pd(laneNearest, laneNearest, 1));
+  minimum = _mm256_min_pd(minimum, _mm256_permute_pd(minimum, 0b0101));
+  const auto nearestDist = _mm256_cvtsd_f64(minimum);
+  if (!(nearestDist < nearerThan))
+    return nearerThan;
+  // Several lanes may have found the same distance: like the scalar loop,
+  // prefer the lowest index.
+  alignas(32) std::array<double, Lanes> distances;
+  alignas(32) std::array<double, Lanes> indices;
+  _mm256_store_pd(distances.data(), laneNearest);
+  _mm256_store_pd(indices.data(), laneNearestIndex);
+  auto index = std::numeric_limits<double>::infinity();
+  for (size_t lane = 0; lane < Lanes; ++lane)
+    if (distances[lane] == nearestDist)
+      index = std::min(index, indices[lane]);
+  nearestIndex = static_cast<size_t>(index);
+  return nearestDist;
+}
+
+bool SphereStore::anyHit(const Ray &ray, size_t begin, size_t end,
+                         double maxDistance) const noexcept {
+  const RayLanes rayLanes(ray);
+  const auto endIndex = _mm256_set1_pd(static_cast<double>(end));
+  const auto laneOffsets = _mm256_set_pd(3, 2, 1, 0);
+  const auto limit = _mm256_set1_pd(maxDistance);
+  for (size_t block = begin; block < end; block += Lanes) {
+    const auto hits = intersectBlock(*this, block, rayLanes);
+    if (!hits.anyRoots)
+      continue;
+    const auto index =
+        _mm256_add_pd(_mm256_set1_pd(static_cast<double>(block)), laneOffsets);
+    const auto hit = _mm256_and_pd(
+        hits.hit, _mm256_and_pd(_mm256_cmp_pd(hits.t, limit, _CMP_LT_OQ),
+                                _mm256_cmp_pd(index, endIndex, _CMP_LT_OQ)));
+    if (_mm256_movemask_pd(hit))
+      return true;
+  }
+  return false;
+}
+
+#else
+
+double SphereStore::nearest(const Ray &ray, size_t begin, size_t end,
+                            double nearerThan,
+                            std::optional<size_t> &nearestIndex) const
+    noexcept {
+  return nearestScalar(ray, begin, end, nearerThan, nearestIndex);
+}
+
+bool SphereStore::anyHit(const Ray &ray, size_t begin, size_t end,
+                         double maxDistance) const noexcept {
+  for (auto sphereIndex = begin; sphereIndex < end; ++sphereIndex) {
+    std::optional<size_t> index;
+    nearestScalar(ray, sphereIndex, sphereIndex + 1, maxDistance, index);
+    if (index)
+      return true;
+  }
+  return false;
+}
+
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Sphere.h"
+#include "math/Aabb.h"
+#include "math/Ray.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace dod {
+
+// Spheres held as structure-of-arrays, one array per coordinate of the
+// centres and one of the squared radii, so a ray can be tested against a
+// block of Lanes spheres with a few SIMD instructions.
+class SphereStore {
+public:
+  static constexpr size_t Lanes = 4;
+
+  // Each array is followed by Lanes - 1 spare entries, so a block may start
+  // at any sphere.
+  std::vector<double> centreX, centreY, centreZ;
+  std::vector<double> radiusSquared;
+
+  [[nodiscard]] size_t size() const noexcept { return size_; }
+  [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+
+  void add(const Sphere &sphere);
+
+  [[nodiscard]] Vec3 centre(size_t index) const noexcept {
+    return Vec3(centreX[index], centreY[index], centreZ[index]);
+  }
+  [[nodiscard]] Aabb bounds(size_t index) const noexcept;
+
+  // Puts the sphere at order[i] into slot i.
+  void reorder(const std::vector<uint32_t> &order);
+
+  // Finds the nearest sphere in [begin, end) the ray hits nearer than
+  // nearerThan. If there is one, sets nearestIndex and returns its distance;
+  // otherwise returns nearerThan. Uses AVX where the target supports it.
+  double nearest(const Ray &ray, size_t begin, size_t end, double nearerThan,
+                 std::optional<size_t> &nearestIndex) const noexcept;
+  // As nearest(), one sphere at a time. Visible for tests and benchmarks.
+  double nearestScalar(const Ray &ray, size_t begin, size_t end,
+                       double nearerThan,
+                       std::optional<size_t> &nearestIndex) const noexcept;
+
+  // Whether the ray hits any sphere in [begin, end) nearer than maxDistance,
+  // stopping at the first hit.
+  [[nodiscard]] bool anyHit(const Ray &ray, size_t begin, size_t end,
+                            double maxDistance) const noexcept;
+
+private:
+  size_t size_{};
+
+  void pad();
+};
+
+}
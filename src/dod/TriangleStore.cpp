@@ -0,0 +1,43 @@
+#include "TriangleStore.h"
+
+using dod::TriangleStore;
+
+void TriangleStore::pad() {
+  for (auto *array : {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z})
+    array->resize(size_ + Lanes - 1);
+}
+
+void TriangleStore::add(const TriangleVertices &triangle) {
+  const auto index = size_++;
+  pad();
+  const auto &v0 = triangle.vertex(0);
+  const auto e1 = triangle.uVector();
+  const auto e2 = triangle.vVector();
+  v0x[index] = v0.x();
+  v0y[index] = v0.y();
+  v0z[index] = v0.z();
+  e1x[index] = e1.x();
+  e1y[index] = e1.y();
+  e1z[index] = e1.z();
+  e2x[index] = e2.x();
+  e2y[index] = e2.y();
+  e2z[index] = e2.z();
+}
+
+Aabb TriangleStore::bounds(size_t index) const noexcept {
+  const auto v0 = Vec3(v0x[index], v0y[index], v0z[index]);
+  const auto e1 = Vec3(e1x[index], e1y[index], e1z[index]);
+  const auto e2 = Vec3(e2x[index], e2y[index], e2z[index]);
+  return Aabb().including(v0).including(v0 + e1).including(v0 + e2);
+}
+
+void TriangleStore::reorder(const std::vector<uint32_t> &order) {
+  for (auto *array : {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z}) {
+    std::vector<double> reordered;
+    reordered.reserve(size_ + Lanes - 1);
+    for (auto index : order)
+      reordered.emplace_back((*array)[index]);
+    *array = std::move(reordered);
+  }
+  pad();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "TriangleVertices.h"
+#include "math/Aabb.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace dod {
+
+// Triangles held as structure-of-arrays: each triangle's first vertex and the
+// two edges from it, precomputed, with one array per coordinate. This lets the
+// intersection loop load a block of Lanes triangles' worth of each coordinate
+// at once.
+class TriangleStore {
+public:
+  static constexpr size_t Lanes = 4;
+
+  // Each array is followed by Lanes - 1 all-zero triangles, so a block may
+  // start at any triangle. Being degenerate, they never intersect anything.
+  std::vector<double> v0x, v0y, v0z;
+  std::vector<double> e1x, e1y, e1z;
+  std::vector<double> e2x, e2y, e2z;
+
+  [[nodiscard]] size_t size() const noexcept { return size_; }
+  [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+
+  void add(const TriangleVertices &triangle);
+
+  [[nodiscard]] Aabb bounds(size_t index) const noexcept;
+
+  // Puts the triangle at order[i] into slot i.
+  void reorder(const std::vector<uint32_t> &order);
+
+private:
+  size_t size_{};
+
+  void pad();
+};
+
+}
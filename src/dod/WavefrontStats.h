@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace dod {
+
+// What the wavefront renderer's intersection stage did, and how long it and
+// any sorting took, for judging whether reordering the rays pays for itself.
+struct WavefrontStats {
+  size_t raysTraced{};
+  size_t nodeVisits{};
+  // Empty if the hardware counters weren't available.
+  std::optional<uint64_t> cacheMisses{0};
+  std::chrono::nanoseconds sortTime{};
+  std::chrono::nanoseconds intersectTime{};
+
+  WavefrontStats &operator+=(const WavefrontStats &rhs) noexcept {
+    raysTraced += rhs.raysTraced;
+    nodeVisits += rhs.nodeVisits;
+    sortTime += rhs.sortTime;
+    intersectTime += rhs.intersectTime;
+    if (cacheMisses && rhs.cacheMisses)
+      *cacheMisses += *rhs.cacheMisses;
+    else
+      cacheMisses.reset();
+    return *this;
+  }
+};
+
+}
@@ -0,0 +1,86 @@
+#include "WideBvh.h"
+
+#include <algorithm>
+
+using dod::Bvh;
+using dod::WideBvh;
+
+namespace {
+
+template <size_t Width>
+class Collapser {
+  const Bvh &bvh_;
+  WideBvh<Width> &wide_;
+
+  // Gathers up to Width binary nodes to become the children of one wide
+  // node, starting from the given ones.
+  [[nodiscard]] std::vector<uint32_t>
+  gatherChildren(std::vector<uint32_t> children) const {
+    while (children.size() < Width) {
+      auto largest = children.end();
+      auto largestArea = -1.0;
+      for (auto it = children.begin(); it != children.end(); ++it) {
+        const auto &node = bvh_.nodes[*it];
+        if (node.isLeaf())
+          continue;
+        if (const auto area = node.bounds.surfaceArea(); area > largestArea) {
+          largest = it;
+          largestArea = area;
+        }
+      }
+      if (largest == children.end())
+        break;
+      const auto opened = *largest;
+      *largest = opened + 1;
+      children.insert(largest + 1, bvh_.nodes[opened].index);
+    }
+    return children;
+  }
+
+  // Emits a wide node whose children are gathered from beneath the given
+  // binary nodes, and returns its index.
+  uint32_t emit(std::vector<uint32_t> binaryNodes) {
+    const auto nodeIndex = static_cast<uint32_t>(wide_.nodes.size());
+    wide_.nodes.emplace_back();
+    const auto children = gatherChildren(std::move(binaryNodes));
+    for (size_t lane = 0; lane < children.size(); ++lane) {
+      const auto &child = bvh_.nodes[children[lane]];
+      const auto childIndex =
+          child.isLeaf() ? child.index : emit({children[lane]});
+      // Careful: emit() may have reallocated the nodes.
+      auto &node = wide_.nodes[nodeIndex];
+      node.minX[lane] = child.bounds.min().x();
+      node.minY[lane] = child.bounds.min().y();
+      node.minZ[lane] = child.bounds.min().z();
+      node.maxX[lane] = child.bounds.max().x();
+      node.maxY[lane] = child.bounds.max().y();
+      node.maxZ[lane] = child.bounds.max().z();
+      node.index[lane] = childIndex;
+      node.numPrimitives[lane] = child.numPrimitives;
+    }
+    wide_.nodes[nodeIndex].numChildren = static_cast<uint32_t>(children.size());
+    return nodeIndex;
+  }
+
+public:
+  Collapser(const Bvh &bvh, WideBvh<Width> &wide) : bvh_(bvh), wide_(wide) {}
+
+  void collapse() {
+    // The root's bounds live in its parent, so even a lone leaf needs a node
+    // above it.
+    emit({0});
+  }
+};
+
+}
+
+template <size_t Width>
+WideBvh<Width> dod::collapseBvh(const Bvh &bvh) {
+  WideBvh<Width> wide;
+  if (!bvh.empty())
+    Collapser<Width>(bvh, wide).collapse();
+  return wide;
+}
+
+template WideBvh<4> dod::collapseBvh(const Bvh &bvh);
+template WideBvh<8> dod::collapseBvh(const Bvh &bvh);
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "Bvh.h"
+#include "math/Aabb.h"
+#include "math/Ray.h"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace dod {
+
+// A node with up to Width children. The children's bounds are held as
+// structure-of-arrays so one ray is tested against all of them together:
+// each lane of the test is independent and branch-free, and with
+// -march=native the compiler turns the loop into SSE/AVX instructions.
+template <size_t Width>
+struct WideBvhNode {
+  static constexpr size_t LaneAlignment = Width * sizeof(double);
+
+  alignas(LaneAlignment) std::array<double, Width> minX{};
+  alignas(LaneAlignment) std::array<double, Width> minY{};
+  alignas(LaneAlignment) std::array<double, Width> minZ{};
+  alignas(LaneAlignment) std::array<double, Width> maxX{};
+  alignas(LaneAlignment) std::array<double, Width> maxY{};
+  alignas(LaneAlignment) std::array<double, Width> maxZ{};
+  // For leaf children, the index of the first primitive; for interior
+  // children, the index of the child node.
+  std::array<uint32_t, Width> index{};
+  // Zero for interior children.
+  std::array<uint32_t, Width> numPrimitives{};
+  uint32_t numChildren{};
+
+  // Computes the entry distance of the ray into each child it hits nearer
+  // than nearerThan, and infinity for the ones it misses (and any unused
+  // lanes). Each lane matches Aabb::intersects().
+  void intersect(const Vec3 &origin, const Vec3 &inverseDirection,
+                 double nearerThan,
+                 std::array<double, Width> &distances) const noexcept {
+    constexpr auto inf = std::numeric_limits<double>::infinity();
+    constexpr auto robustScale = 1 + 4 * std::numeric_limits<double>::epsilon();
+    const auto ox = origin.x();
+    const auto oy = origin.y();
+    const auto oz = origin.z();
+    const auto ix = inverseDirection.x();
+    const auto iy = inverseDirection.y();
+    const auto iz = inverseDirection.z();
+    for (size_t lane = 0; lane < Width; ++lane) {
+      const auto x0 = (minX[lane] - ox) * ix;
+      const auto x1 = (maxX[lane] - ox) * ix;
+      const auto y0 = (minY[lane] - oy) * iy;
+      const auto y1 = (maxY[lane] - oy) * iy;
+      const auto z0 = (minZ[lane] - oz) * iz;
+      const auto z1 = (maxZ[lane] - oz) * iz;
+      const auto tNear =
+          std::max(std::max(0.0, std::min(x0, x1)),
+                   std::max(std::min(y0, y1), std::min(z0, z1)));
+      const auto tFar =
+          std::min(std::min(nearerThan, std::max(x0, x1)),
+                   std::min(std::max(y0, y1), std::max(z0, z1)));
+      const bool hit = tNear <= tFar * robustScale && lane < numChildren;
+      distances[lane] = hit ? tNear : inf;
+    }
+  }
+};
+
+// A BVH collapsed from a binary one, so each node has up to Width children.
+// Leaves refer to the same primitive ranges as the binary tree they came from.
+template <size_t Width>
+struct WideBvh {
+  // Collapsing never makes the tree deeper, and each node visited leaves at
+  // most Width - 1 siblings on the stack.
+  static constexpr size_t StackSize = Bvh::MaxDepth * (Width - 1) + 1;
+
+  std::vector<WideBvhNode<Width>> nodes;
+
+  [[nodiscard]] bool empty() const noexcept { return nodes.empty(); }
+
+  // As Bvh::traverse().
+  template <typename LeafFunc>
+  double traverse(const Ray &ray, double nearerThan,
+                  LeafFunc &&leafFunc) const {
+    size_t nodeVisits = 0;
+    return traverse(ray, nearerThan, leafFunc, nodeVisits);
+  }
+
+  // As above, adding the number of nodes whose children were tested to
+  // nodeVisits.
+  template <typename LeafFunc>
+  double traverse(const Ray &ray, double nearerThan, LeafFunc &&leafFunc,
+                  size_t &nodeVisits) const {
+    if (nodes.empty())
+      return nearerThan;
+    const auto inverseDirection = Aabb::inverseDirection(ray);
+    struct Entry {
+      uint32_t index;
+      uint32_t numPrimitives;
+      double distance;
+    };
+    std::array<Entry, StackSize> stack;
+    size_t stackSize = 0;
+    stack[stackSize++] = Entry{0, 0, 0};
+    std::array<double, Width> distances;
+    while (stackSize) {
+      const auto entry = stack[--stackSize];
+      // A hit found since this entry was pushed may have put it out of reach.
+      if (entry.distance > nearerThan)
+        continue;
+      if (entry.numPrimitives) {
+        nearerThan = leafFunc(entry.index, entry.index + entry.numPrimitives,
+                              nearerThan);
+        continue;
+      }
+      const auto &node = nodes[entry.index];
+      ++nodeVisits;
+      node.intersect(ray.origin(), inverseDirection, nearerThan, distances);
+      // Push the children that were hit furthest first, so the nearest is
+      // visited next.
+      const auto firstPushed = stackSize;
+      for (size_t lane = 0; lane < node.numChildren; ++lane) {
+        if (distances[lane] == std::numeric_limits<double>::infinity())
+          continue;
+        const Entry child{node.index[lane], node.numPrimitives[lane],
+                          distances[lane]};
+        auto pos = stackSize++;
+        for (; pos > firstPushed && stack[pos - 1].distance < child.distance;
+             --pos)
+          stack[pos] = stack[pos - 1];
+        stack[pos] = child;
+      }
+    }
+    return nearerThan;
+  }
+
+  // As Bvh::anyHit().
+  template <typename LeafFunc>
+  bool anyHit(const Ray &ray, double maxDistance, LeafFunc &&leafFunc,
+              size_t &nodeVisits) const {
+    if (nodes.empty())
+      return false;
+    const auto inverseDirection = Aabb::inverseDirection(ray);
+    // Any hit will do, so there's no need to order the children.
+    struct Entry {
+      uint32_t index;
+      uint32_t numPrimitives;
+    };
+    std::array<Entry, StackSize> stack;
+    size_t stackSize = 0;
+    stack[stackSize++] = Entry{0, 0};
+    std::array<double, Width> distances;
+    while (stackSize) {
+      const auto entry = stack[--stackSize];
+      if (entry.numPrimitives) {
+        if (leafFunc(entry.index, entry.index + entry.numPrimitives))
+          return true;
+        continue;
+      }
+      const auto &node = nodes[entry.index];
+      ++nodeVisits;
+      node.intersect(ray.origin(), inverseDirection, maxDistance, distances);
+      for (size_t lane = 0; lane < node.numChildren; ++lane) {
+        if (distances[lane] != std::numeric_limits<double>::infinity())
+          stack[stackSize++] =
+              Entry{node.index[lane], node.numPrimitives[lane]};
+      }
+    }
+    return false;
+  }
+};
+
+// Collapses a binary hierarchy into one with up to Width children per node,
+// repeatedly opening the largest interior child until the node is full.
+template <size_t Width>
+[[nodiscard]] WideBvh<Width> collapseBvh(const Bvh &bvh);
+
+extern template WideBvh<4> collapseBvh(const Bvh &bvh);
+extern template WideBvh<8> collapseBvh(const Bvh &bvh);
+
+}
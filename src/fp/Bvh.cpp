@@ -0,0 +1,211 @@
+#include "Bvh.h"
+#include "Scene.h"
+#include "math/Epsilon.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+namespace fp {
+
+namespace {
+
+constexpr size_t MaxLeafSize = 4;
+// Relative costs of visiting a node versus intersecting a primitive.
+constexpr double TraversalCost = 1.0;
+constexpr double IntersectionCost = 2.0;
+
+Aabb boundsOf(const Primitive &primitive) {
+  return std::visit([](const auto &p) { return p.shape.bounds(); }, primitive);
+}
+
+// What the build needs to know about each primitive, worked out once up front.
+struct BuildItem {
+  size_t index;
+  Aabb bounds;
+  Vec3 centre;
+};
+using BuildItems = std::vector<BuildItem>;
+
+Aabb boundsOf(const BuildItems &items) {
+  return std::accumulate(items.begin(), items.end(), Aabb(),
+                         [](const Aabb &bounds, const BuildItem &item) {
+                           return bounds.including(item.bounds);
+                         });
+}
+
+BuildItems sortedAlong(BuildItems items, int axis) {
+  std::sort(items.begin(), items.end(),
+            [axis](const BuildItem &lhs, const BuildItem &rhs) {
+              return lhs.centre[axis] < rhs.centre[axis];
+            });
+  return items;
+}
+
+// The bounds of each prefix of the items: element i bounds the first i + 1
+// of them.
+template <typename Iter>
+std::vector<Aabb> runningBounds(Iter begin, Iter end) {
+  std::vector<Aabb> bounds;
+  std::transform(begin, end, std::back_inserter(bounds),
+                 [](const BuildItem &item) { return item.bounds; });
+  std::partial_sum(bounds.begin(), bounds.end(), bounds.begin(),
+                   [](const Aabb &lhs, const Aabb &rhs) {
+                     return lhs.including(rhs);
+                   });
+  return bounds;
+}
+
+struct Split {
+  int axis;
+  size_t index;
+  double cost;
+};
+
+// The cheapest split along an axis by the surface area heuristic: the areas
+// of the two sides, each weighted by how many primitives are in it.
+Split bestSplit(const BuildItems &sorted, int axis) {
+  const auto left = runningBounds(sorted.begin(), sorted.end());
+  const auto right = runningBounds(sorted.rbegin(), sorted.rend());
+  const auto count = sorted.size();
+  auto costAt = [&](size_t index) {
+    return left[index - 1].surfaceArea() * index
+           + right[count - index - 1].surfaceArea() * (count - index);
+  };
+  auto indices = std::vector<size_t>(count - 1);
+  std::iota(indices.begin(), indices.end(), 1);
+  const auto best = *std::min_element(
+      indices.begin(), indices.end(),
+      [&](size_t lhs, size_t rhs) { return costAt(lhs) < costAt(rhs); });
+  return Split{axis, best, costAt(best)};
+}
+
+// Builds the tree over the items, appending each leaf's primitives to
+// ordered as it goes.
+BvhNode build(const BuildItems &items, const std::vector<Primitive> &source,
+              std::vector<Primitive> &ordered) {
+  auto makeLeaf = [&](const BuildItems &leafItems) {
+    const auto begin = ordered.size();
+    for (auto &item : leafItems)
+      ordered.push_back(source[item.index]);
+    return BvhLeaf{begin, ordered.size()};
+  };
+  if (items.size() <= 1)
+    return makeLeaf(items);
+
+  const auto bounds = boundsOf(items);
+  const auto sorted = std::array<BuildItems, 3>{
+      sortedAlong(items, 0), sortedAlong(items, 1), sortedAlong(items, 2)};
+  const auto splits = std::array<Split, 3>{bestSplit(sorted[0], 0),
+                                           bestSplit(sorted[1], 1),
+                                           bestSplit(sorted[2], 2)};
+  const auto split = *std::min_element(
+      splits.begin(), splits.end(),
+      [](const Split &lhs, const Split &rhs) { return lhs.cost < rhs.cost; });
+
+  const auto leafCost = IntersectionCost * items.size();
+  const auto splitCost =
+      TraversalCost + IntersectionCost * split.cost / bounds.surfaceArea();
+  if (items.size() <= MaxLeafSize && leafCost <= splitCost)
+    return makeLeaf(items);
+
+  const auto &chosen = sorted[split.axis];
+  const auto middle = chosen.begin() + split.index;
+  auto left = build(BuildItems(chosen.begin(), middle), source, ordered);
+  auto right = build(BuildItems(middle, chosen.end()), source, ordered);
+  return BvhInterior{
+      // Padded so rays lying exactly in the plane of a flat box (e.g. one
+      // holding an axis-aligned triangle) still hit it.
+      bounds.expanded(Epsilon), split.axis,
+      std::make_shared<const BvhNode>(std::move(left)),
+      std::make_shared<const BvhNode>(std::move(right))};
+}
+
+struct BvhIntersectVisitor {
+  const std::vector<Primitive> &primitives;
+  const Ray &ray;
+  const Vec3 &inverseDirection;
+  double nearerThan;
+
+  tl::optional<IntersectionRecord> operator()(const BvhLeaf &leaf) const {
+    tl::optional<IntersectionRecord> nearest;
+    for (auto i = leaf.begin; i < leaf.end; ++i) {
+      auto thisIntersection = intersect(primitives[i], ray);
+      if (thisIntersection
+          && thisIntersection->hit.distance
+                 < (nearest ? nearest->hit.distance : nearerThan))
+        nearest.emplace(*thisIntersection);
+    }
+    return nearest;
+  }
+
+  tl::optional<IntersectionRecord>
+  operator()(const BvhInterior &interior) const {
+    if (!interior.bounds.intersects(ray, inverseDirection, nearerThan))
+      return tl::nullopt;
+    // Try the child on the side the ray comes from first: anything it hits
+    // limits how far we look into the other.
+    const auto reversed = ray.direction().toVec3()[interior.splitAxis] < 0;
+    const auto &first = reversed ? *interior.right : *interior.left;
+    const auto &second = reversed ? *interior.left : *interior.right;
+    const auto firstHit = std::visit(*this, first);
+    const auto secondHit = std::visit(
+        BvhIntersectVisitor{primitives, ray, inverseDirection,
+                            firstHit ? firstHit->hit.distance : nearerThan},
+        second);
+    return secondHit ? secondHit : firstHit;
+  }
+};
+
+struct BvhOccludedVisitor {
+  const std::vector<Primitive> &primitives;
+  const Ray &ray;
+  const Vec3 &inverseDirection;
+  double maxDistance;
+
+  bool operator()(const BvhLeaf &leaf) const {
+    return std::any_of(primitives.begin() + leaf.begin,
+                       primitives.begin() + leaf.end,
+                       [this](const Primitive &primitive) {
+                         return occluded(primitive, ray, maxDistance);
+                       });
+  }
+
+  bool operator()(const BvhInterior &interior) const {
+    return interior.bounds.intersects(ray, inverseDirection, maxDistance)
+           && (std::visit(*this, *interior.left)
+               || std::visit(*this, *interior.right));
+  }
+};
+
+}
+
+Bvh buildBvh(const std::vector<Primitive> &primitives) {
+  auto items = BuildItems();
+  for (size_t i = 0; i < primitives.size(); ++i) {
+    const auto bounds = boundsOf(primitives[i]);
+    items.push_back(BuildItem{i, bounds, bounds.centre()});
+  }
+  auto ordered = std::vector<Primitive>();
+  ordered.reserve(primitives.size());
+  auto root = build(items, primitives, ordered);
+  return Bvh{std::make_shared<const std::vector<Primitive>>(std::move(ordered)),
+             std::make_shared<const BvhNode>(std::move(root))};
+}
+
+tl::optional<IntersectionRecord> intersect(const Bvh &bvh, const Ray &ray) {
+  const auto inverseDirection = Aabb::inverseDirection(ray);
+  return std::visit(
+      BvhIntersectVisitor{*bvh.primitives, ray, inverseDirection,
+                          std::numeric_limits<double>::infinity()},
+      *bvh.root);
+}
+
+bool occluded(const Bvh &bvh, const Ray &ray, double maxDistance) {
+  const auto inverseDirection = Aabb::inverseDirection(ray);
+  return std::visit(
+      BvhOccludedVisitor{*bvh.primitives, ray, inverseDirection, maxDistance},
+      *bvh.root);
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "IntersectionRecord.h"
+#include "Primitive.h"
+#include "math/Aabb.h"
+#include "math/Ray.h"
+#include "optional.hpp"
+
+#include <memory>
+#include <variant>
+#include <vector>
+
+namespace fp {
+
+// An immutable bounding volume hierarchy. Subtrees are shared rather than
+// copied, so nodes have value semantics and copies are cheap.
+struct BvhLeaf;
+struct BvhInterior;
+using BvhNode = std::variant<BvhLeaf, BvhInterior>;
+
+// The span [begin, end) of the hierarchy's primitives.
+struct BvhLeaf {
+  size_t begin;
+  size_t end;
+};
+
+struct BvhInterior {
+  Aabb bounds;
+  int splitAxis;
+  std::shared_ptr<const BvhNode> left;
+  std::shared_ptr<const BvhNode> right;
+};
+
+// The primitives are reordered so each leaf's are contiguous, and held once
+// for the whole tree. A default-constructed hierarchy is empty.
+struct Bvh {
+  std::shared_ptr<const std::vector<Primitive>> primitives =
+      std::make_shared<const std::vector<Primitive>>();
+  std::shared_ptr<const BvhNode> root =
+      std::make_shared<const BvhNode>(BvhLeaf{0, 0});
+};
+
+[[nodiscard]] Bvh buildBvh(const std::vector<Primitive> &primitives);
+
+[[nodiscard]] tl::optional<IntersectionRecord> intersect(const Bvh &bvh,
+                                                         const Ray &ray);
+
+// Whether the ray hits anything in the hierarchy nearer than maxDistance,
+// stopping at the first hit found.
+[[nodiscard]] bool occluded(const Bvh &bvh, const Ray &ray,
+                            double maxDistance);
+
+}
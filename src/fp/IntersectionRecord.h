@@ -0,0 +1,13 @@
+#pragma once
+
+#include "math/Hit.h"
+#include "util/MaterialSpec.h"
+
+namespace fp {
+
+struct IntersectionRecord {
+  Hit hit;
+  const MaterialSpec &material;
+};
+
+}
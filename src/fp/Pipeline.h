@@ -0,0 +1,96 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fp {
+
+namespace detail {
+
+// The order in which asynchronous tasks finished, as the slots they ran in.
+class Completions {
+  std::mutex mutex_;
+  std::condition_variable finished_;
+  std::deque<size_t> slots_;
+
+public:
+  void push(size_t slot) {
+    {
+      std::lock_guard lock(mutex_);
+      slots_.emplace_back(slot);
+    }
+    finished_.notify_one();
+  }
+
+  size_t pop() {
+    std::unique_lock lock(mutex_);
+    finished_.wait(lock, [this] { return !slots_.empty(); });
+    const auto slot = slots_.front();
+    slots_.pop_front();
+    return slot;
+  }
+};
+
+}
+
+// Maps func asynchronously over the inputs with at most maxInFlight calls
+// running at once, and folds each result into init as soon as it is ready:
+// a finished call is immediately replaced with the next input, so one slow
+// call never holds up the others. As results fold in the order they finish,
+// fold should be commutative. observe sees each successive accumulation.
+// Any exception from func is rethrown once the calls in flight have finished.
+template <typename Inputs, typename Func, typename Acc, typename Fold,
+          typename Observe>
+Acc foldAsCompleted(Inputs &&inputs, size_t maxInFlight, Func &&func, Acc init,
+                    Fold &&fold, Observe &&observe) {
+  using Input = std::decay_t<decltype(*std::begin(inputs))>;
+  using Result = std::invoke_result_t<Func &, Input>;
+  // Outlives the tasks, which report to it as they finish.
+  detail::Completions completions;
+  std::vector<std::future<Result>> slots(std::max<size_t>(maxInFlight, 1));
+
+  auto next = std::begin(inputs);
+  const auto end = std::end(inputs);
+  auto launch = [&](size_t slot) {
+    slots[slot] = std::async(std::launch::async, [&, slot, input = *next] {
+      // Reports the completion even if func throws.
+      struct Reporter {
+        detail::Completions &completions;
+        size_t slot;
+        ~Reporter() { completions.push(slot); }
+      } reporter{completions, slot};
+      return func(input);
+    });
+    ++next;
+  };
+
+  size_t numInFlight = 0;
+  for (; numInFlight < slots.size() && next != end; ++numInFlight)
+    launch(numInFlight);
+  // Rebound after each fold, as the accumulator need not be assignable.
+  std::optional<Acc> acc(std::move(init));
+  while (numInFlight) {
+    const auto slot = completions.pop();
+    auto result = slots[slot].get();
+    --numInFlight;
+    if (next != end) {
+      launch(slot);
+      ++numInFlight;
+    }
+    auto folded = fold(std::move(*acc), std::move(result));
+    acc.emplace(std::move(folded));
+    observe(std::as_const(*acc));
+  }
+  return std::move(*acc);
+}
+
+}
@@ -1,52 +1,29 @@
 #include "Render.h"
 
+#include "Bvh.h"
+#include "Pipeline.h"
 #include "Primitive.h"
 #include "Scene.h"
 #include "math/Camera.h"
+#include "math/Sampler.h"
 #include "math/Samples.h"
 #include "optional.hpp"
 #include "util/ArrayOutput.h"
-#include "util/Progressifier.h"
+#include "util/RenderProgress.h"
+#include "util/RussianRoulette.h"
+#include "util/TiledRender.h"
 
-#include <future>
 #include <range/v3/all.hpp>
 
 namespace fp {
 
-struct IntersectionRecord {
-  Hit hit;
-  const MaterialSpec &material;
-};
-
-struct IntersectVisitor {
-  const Ray &ray;
-
-  template <typename Primitive>
-  auto operator()(const Primitive &primitive) const {
-    return primitive.shape.intersect(ray).map([&primitive](auto hit) {
-      return IntersectionRecord{hit, primitive.material};
-    });
-  }
-};
-
-tl::optional<IntersectionRecord> intersect(const Primitive &primitive,
-                                           const Ray &ray) {
-  return std::visit(IntersectVisitor{ray}, primitive);
-}
-
-tl::optional<IntersectionRecord> intersect(const Scene &scene, const Ray &ray) {
-  tl::optional<IntersectionRecord> nearest;
-  for (auto &primitive : scene.primitives) {
-    auto thisIntersection = intersect(primitive, ray);
-    if (thisIntersection
-        && (!nearest || thisIntersection->hit.distance < nearest->hit.distance))
-      nearest.emplace(*thisIntersection);
-  }
-  return nearest;
-}
-
-template <typename RadianceFunc>
+// radiance(ray, bsdfPdf, weight) gives the light along a ray, and
+// directLight(weight) the light arriving straight from the lights, when
+// leaving a diffuse surface. Both come scaled by the weight, on top of the
+// path's throughput so far.
+template <typename RadianceFunc, typename DirectLightFunc>
 Vec3 radianceAtIntersection(RadianceFunc &&radiance,
+                            DirectLightFunc &&directLight,
                             const IntersectionRecord &intersectionRecord,
                             const Ray &ray, const OrthoNormalBasis &basis,
                             double u, double v, double p) {
@@ -66,104 +43,153 @@ Vec3 radianceAtIntersection(RadianceFunc &&radiance,
     const auto newRay =
         Ray(hit.position, coneSample(hit.normal.reflect(ray.direction()),
                                      mat.reflectionConeAngleRadians, u, v));
-    return radiance(newRay);
+    return radiance(newRay, 0.0, Vec3(1, 1, 1));
   } else {
     const auto newRay = Ray(hit.position, hemisphereSample(basis, u, v));
-    return mat.diffuse * radiance(newRay);
+    // The direct light takes its samples before the rest of the path.
+    const auto direct = directLight(mat.diffuse);
+    return direct
+           + radiance(newRay,
+                      hemisphereSamplePdf(hit.normal, newRay.direction()),
+                      mat.diffuse);
   }
 }
 
-Vec3 radiance(const Scene &scene, std::mt19937 &rng, const Ray &ray, int depth,
-              const RenderParams &renderParams) {
+// The light along the ray, scaled by throughput: the weight it carries back to
+// its pixel.
+Vec3 radiance(const Scene &scene, const Bvh &bvh, Sampler &sampler,
+              const Ray &ray, int depth, double bsdfPdf,
+              const Vec3 &throughput, const RenderParams &renderParams) {
   using namespace ranges;
   const auto numUSamples = depth == 0 ? renderParams.firstBounceUSamples : 1;
   const auto numVSamples = depth == 0 ? renderParams.firstBounceVSamples : 1;
   if (depth >= renderParams.maxDepth)
     return Vec3();
-  const auto intersectionRecord = intersect(scene, ray);
+  const auto survivor =
+      russianRoulette(sampler, throughput, depth, renderParams);
+  if (!survivor)
+    return Vec3();
+  const auto intersectionRecord = intersect(bvh, ray);
   if (!intersectionRecord)
-    return scene.environment;
+    return *survivor * scene.environment;
 
   const auto &mat = intersectionRecord->material;
   const auto &hit = intersectionRecord->hit;
   if (renderParams.preview)
-    return mat.diffuse;
+    return *survivor * mat.diffuse;
 
   // Create a coordinate system local to the point, where the z is the
   // normal at this point.
   const auto basis = OrthoNormalBasis::fromZ(hit.normal);
-  std::uniform_real_distribution<> unit;
+  const auto numSamples = numUSamples * numVSamples;
+  // Each sample carries its share of the throughput.
+  const auto sampleThroughput = *survivor / numSamples;
 
-  auto toUVSample = [&rng, &unit, numUSamples, numVSamples](auto vu) {
+  auto toBranch = [&sampler, numUSamples, numSamples](auto vu) {
     auto [v, u] = vu;
-    const auto sampleU = (u + unit(rng)) / numUSamples;
-    const auto sampleV = (v + unit(rng)) / numVSamples;
-    return std::make_pair(sampleU, sampleV);
+    return std::make_tuple(u, v,
+                           sampler.branch(v * numUSamples + u, numSamples));
   };
 
-  auto radianceForRay = [&](const Ray &ray) {
-    return radiance(scene, rng, ray, depth + 1, renderParams);
+  auto sampleRadiance = [&](auto branchAt) {
+    const auto uSample = std::get<0>(branchAt);
+    const auto vSample = std::get<1>(branchAt);
+    auto branch = std::get<2>(branchAt);
+    const auto [u, v] =
+        branch.stratified2D(uSample, numUSamples, vSample, numVSamples);
+    const auto p = branch.next1D();
+    auto radianceForRay = [&](const Ray &ray, double rayPdf,
+                              const Vec3 &weight) {
+      return radiance(scene, bvh, branch, ray, depth + 1,
+                      renderParams.nextEvent ? rayPdf : 0.0,
+                      sampleThroughput * weight, renderParams);
+    };
+    auto directLight = [&](const Vec3 &weight) {
+      if (!renderParams.nextEvent || depth + 1 >= renderParams.maxDepth
+          || weight == Vec3())
+        return Vec3();
+      return sampleThroughput * weight
+             * scene.lights.sampleDirect(
+                 branch, hit, [&](const Ray &shadowRay, double maxDistance) {
+                   return occluded(bvh, shadowRay, maxDistance);
+                 });
+    };
+    return radianceAtIntersection(radianceForRay, directLight,
+                                  *intersectionRecord, ray, basis, u, v, p);
   };
 
   const auto incomingLight = accumulate(
       views::cartesian_product(views::ints(0, numVSamples),
                                views::ints(0, numUSamples))
-          | views::transform(toUVSample) | views::transform([&](auto s) {
-              return radianceAtIntersection(radianceForRay, *intersectionRecord,
-                                            ray, basis, s.first, s.second,
-                                            unit(rng));
-            }),
+          | views::transform(toBranch) | views::transform(sampleRadiance),
       Vec3());
-  return mat.emission + incomingLight / (numUSamples * numVSamples);
+  return *survivor * mat.emission
+             * scene.lights.emissionWeight(ray, hit.distance, bsdfPdf)
+         + incomingLight;
 }
 
 ArrayOutput renderWholeScreen(const Camera &camera, const Scene &scene,
-                              size_t seed, const RenderParams &renderParams) {
+                              const Bvh &bvh, int pass,
+                              const RenderParams &renderParams) {
   using namespace ranges;
-  auto renderOnePixel = [seed, &renderParams, &camera, &scene](auto tuple) {
+  auto renderOnePixel = [pass, &renderParams, &camera, &scene,
+                         &bvh](auto tuple) {
     auto [y, x] = tuple;
-    std::mt19937 rng(renderParams.height * renderParams.width * seed
-                     + x * renderParams.width + y);
-    return radiance(scene, rng, camera.randomRay(x, y, rng), 0, renderParams);
+    Sampler sampler(renderParams.sampler, renderParams.seed,
+                    x + y * renderParams.width, pass);
+    return radiance(scene, bvh, sampler, camera.randomRay(x, y, sampler), 0,
+                    0.0, Vec3(1, 1, 1), renderParams);
+  };
+  const auto &deadline = renderParams.deadline;
+  // Rows not started by the deadline are left out.
+  auto beforeDeadline = [&deadline](auto tuple) {
+    return std::get<1>(tuple) != 0 || !deadline.passed();
   };
   auto renderedPixelsView =
       views::cartesian_product(views::ints(0, renderParams.height),
                                views::ints(0, renderParams.width))
-      | views::transform(renderOnePixel);
+      | views::take_while(beforeDeadline) | views::transform(renderOnePixel);
   return ArrayOutput(renderParams.width, renderParams.height,
                      renderedPixelsView);
 }
 
 ArrayOutput render(const Camera &camera, const Scene &scene,
-                   const RenderParams &renderParams,
+                   const Bvh &bvh, const RenderParams &renderParams,
                    const std::function<void(const ArrayOutput &)> &updateFunc) {
-  // TODO no raw loops...maybe return whole "Samples" of an entire screen and
-  // accumulate separately?
-  // future from an async()
-  auto seed = renderParams.seed;
+  auto renderPass = [&](int pass) {
+    return renderWholeScreen(camera, scene, bvh, pass, renderParams);
+  };
+  auto addPass = [](ArrayOutput output, const ArrayOutput &pass) {
+    output += pass;
+    return output;
+  };
+  const auto &deadline = renderParams.deadline;
+  // The passes, for as long as there's time for them.
+  auto passes = ranges::views::ints(0, renderParams.numPasses())
+                | ranges::views::take_while(
+                    [&](int) { return !deadline.passed(); });
   size_t numDone = 0;
-  ArrayOutput output(renderParams.width, renderParams.height);
-  Progressifier progressifier(renderParams.samplesPerPixel);
-  for (int sample = 0; sample < renderParams.samplesPerPixel;
-       sample += renderParams.maxCpus) {
-    std::vector<std::future<ArrayOutput>> futures;
-    for (int ss = sample; ss < std::min(renderParams.samplesPerPixel,
-                                        sample + renderParams.maxCpus);
-         ++ss) {
-      futures.emplace_back(std::async(std::launch::async, [&] {
-        return renderWholeScreen(camera, scene, seed++, renderParams);
-      }));
-    }
-    for (auto &&future : futures) {
-      future.wait();
-      output += future.get();
-      numDone++;
-      progressifier.update(numDone);
-      updateFunc(output);
-    }
-  }
-  progressifier.update(numDone);
-  return output;
+  RenderProgress progress(deadline, renderParams.samplesPerPixel);
+  return foldAsCompleted(
+      passes, renderParams.maxCpus, renderPass,
+      ArrayOutput(renderParams.width, renderParams.height), addPass,
+      [&](const ArrayOutput &output) {
+        progress.update(++numDone);
+        updateFunc(output);
+      });
+}
+
+ArrayOutput
+renderTiled(const Camera &camera, const Scene &scene, const Bvh &bvh,
+            const RenderParams &renderParams,
+            const std::function<void(const ArrayOutput &)> &updateFunc) {
+  return ::renderTiled(
+      renderParams,
+      [&](Sampler &sampler, int x, int y, const RenderParams &params) {
+        return radiance(scene, bvh, sampler, camera.randomRay(x, y, sampler),
+                        0, 0.0, Vec3(1, 1, 1), params);
+      },
+      updateFunc);
 }
 
 }
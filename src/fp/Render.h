@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Bvh.h"
 #include "Scene.h"
 #include "math/Camera.h"
 #include "util/ArrayOutput.h"
@@ -8,8 +9,16 @@
 
 namespace fp {
 
+// Renders the scene, using the given hierarchy built over its primitives.
 ArrayOutput render(const Camera &camera, const Scene &scene,
-                   const RenderParams &renderParams,
+                   const Bvh &bvh, const RenderParams &renderParams,
                    const std::function<void(const ArrayOutput &)> &updateFunc);
 
+// As render(), but a tile at a time rather than a whole screen per pass, so
+// memory use doesn't grow with the number of threads.
+ArrayOutput
+renderTiled(const Camera &camera, const Scene &scene, const Bvh &bvh,
+            const RenderParams &renderParams,
+            const std::function<void(const ArrayOutput &)> &updateFunc);
+
 }
\ No newline at end of file
@@ -1 +1,47 @@
 #include "Scene.h"
+
+#include <algorithm>
+
+namespace fp {
+
+struct IntersectVisitor {
+  const Ray &ray;
+
+  template <typename Primitive>
+  auto operator()(const Primitive &primitive) const {
+    return primitive.shape.intersect(ray).map([&primitive](auto hit) {
+      return IntersectionRecord{hit, primitive.material};
+    });
+  }
+};
+
+tl::optional<IntersectionRecord> intersect(const Primitive &primitive,
+                                           const Ray &ray) {
+  return std::visit(IntersectVisitor{ray}, primitive);
+}
+
+tl::optional<IntersectionRecord> intersect(const Scene &scene, const Ray &ray) {
+  tl::optional<IntersectionRecord> nearest;
+  for (auto &primitive : scene.primitives) {
+    auto thisIntersection = intersect(primitive, ray);
+    if (thisIntersection
+        && (!nearest || thisIntersection->hit.distance < nearest->hit.distance))
+      nearest.emplace(*thisIntersection);
+  }
+  return nearest;
+}
+
+bool occluded(const Primitive &primitive, const Ray &ray, double maxDistance) {
+  return std::visit(
+      [&](const auto &p) { return p.shape.intersects(ray, maxDistance); },
+      primitive);
+}
+
+bool occluded(const Scene &scene, const Ray &ray, double maxDistance) {
+  return std::any_of(scene.primitives.begin(), scene.primitives.end(),
+                     [&](const Primitive &primitive) {
+                       return occluded(primitive, ray, maxDistance);
+                     });
+}
+
+}
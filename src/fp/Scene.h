@@ -1,6 +1,10 @@
 #pragma once
 
+#include "IntersectionRecord.h"
 #include "Primitive.h"
+#include "math/Ray.h"
+#include "optional.hpp"
+#include "util/SphereLights.h"
 
 #include <vector>
 
@@ -9,6 +13,24 @@ namespace fp {
 struct Scene {
   std::vector<Primitive> primitives;
   Vec3 environment;
+  // The emissive spheres, again, for sampling directly.
+  SphereLights lights;
 };
 
+[[nodiscard]] tl::optional<IntersectionRecord>
+intersect(const Primitive &primitive, const Ray &ray);
+
+// Tests every primitive in the scene.
+[[nodiscard]] tl::optional<IntersectionRecord> intersect(const Scene &scene,
+                                                         const Ray &ray);
+
+// Whether the ray hits the primitive nearer than maxDistance, without working
+// out where.
+[[nodiscard]] bool occluded(const Primitive &primitive, const Ray &ray,
+                            double maxDistance);
+
+// Whether the ray hits anything in the scene nearer than maxDistance.
+[[nodiscard]] bool occluded(const Scene &scene, const Ray &ray,
+                            double maxDistance);
+
 }
\ No newline at end of file
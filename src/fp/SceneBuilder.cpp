@@ -12,6 +12,7 @@ void SceneBuilder::addSphere(const Vec3 &centre, double radius,
                              const MaterialSpec &material) {
   scene_.primitives.emplace_back(
       SpherePrimitive{Sphere(centre, radius), material});
+  scene_.lights.add(centre, radius, material);
 }
 
 void SceneBuilder::setEnvironmentColour(const Vec3 &colour) {
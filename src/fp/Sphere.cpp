@@ -13,7 +13,7 @@ tl::optional<double> safeSqrt(double value) {
 
 }
 
-tl::optional<Hit> Sphere::intersect(const Ray &ray) const noexcept {
+tl::optional<double> Sphere::distance(const Ray &ray) const noexcept {
   // Solve t^2*d.d + 2*t*(o-p).d + (o-p).(o-p)-R^2 = 0
   const auto op = centre_ - ray.origin();
   const auto b = op.dot(ray.direction().toVec3());
@@ -24,11 +24,25 @@ tl::optional<Hit> Sphere::intersect(const Ray &ray) const noexcept {
         if (minusT < Epsilon && plusT < Epsilon)
           return tl::nullopt;
         return minusT > Epsilon ? minusT : plusT;
-      })
-      .map([this, &ray](double t) {
-        const auto hitPosition = ray.positionAlong(t);
-        const auto normal = (hitPosition - centre_).normalised();
-        const bool inside = normal.dot(ray.direction()) > 0;
-        return Hit{t, inside, hitPosition, inside ? -normal : normal};
       });
 }
+
+tl::optional<Hit> Sphere::intersect(const Ray &ray) const noexcept {
+  return distance(ray).map([this, &ray](double t) {
+    const auto hitPosition = ray.positionAlong(t);
+    const auto normal = (hitPosition - centre_).normalised();
+    const bool inside = normal.dot(ray.direction()) > 0;
+    return Hit{t, inside, hitPosition, inside ? -normal : normal};
+  });
+}
+
+bool Sphere::intersects(const Ray &ray, double maxDistance) const noexcept {
+  return distance(ray)
+      .map([maxDistance](double t) { return t < maxDistance; })
+      .value_or(false);
+}
+
+Aabb Sphere::bounds() const noexcept {
+  const auto offset = Vec3(radius_, radius_, radius_);
+  return Aabb(centre_ - offset, centre_ + offset);
+}
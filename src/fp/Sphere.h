@@ -1,5 +1,6 @@
 #pragma once
 
+#include "math/Aabb.h"
 #include "math/Hit.h"
 #include "math/Ray.h"
 #include "math/Vec3.h"
@@ -12,6 +13,9 @@ class Sphere {
   Vec3 centre_;
   double radius_;
 
+  // How far along the ray it first hits the sphere, if it does.
+  [[nodiscard]] tl::optional<double> distance(const Ray &ray) const noexcept;
+
 public:
   constexpr Sphere(const Vec3 &centre, double radius) noexcept
       : centre_(centre), radius_(radius) {}
@@ -22,6 +26,11 @@ public:
   [[nodiscard]] constexpr double radius() const noexcept { return radius_; }
 
   [[nodiscard]] tl::optional<Hit> intersect(const Ray &ray) const noexcept;
+  // Whether the ray hits the sphere nearer than maxDistance, without
+  // working out where.
+  [[nodiscard]] bool intersects(const Ray &ray,
+                                double maxDistance) const noexcept;
+  [[nodiscard]] Aabb bounds() const noexcept;
 };
 
 }
\ No newline at end of file
@@ -41,6 +41,31 @@ tl::optional<Hit> Triangle::intersect(const Ray &ray) const noexcept {
              backfacing ? -normal : normal};
 }
 
+bool Triangle::intersects(const Ray &ray, double maxDistance) const noexcept {
+  const auto pVec = ray.direction().cross(vVector());
+  const auto det = uVector().dot(pVec);
+  if (fabs(det) < Epsilon)
+    return false;
+
+  const auto invDet = 1.0 / det;
+  const auto tVec = ray.origin() - vertices_[0];
+  const auto u = tVec.dot(pVec) * invDet;
+  const auto qVec = tVec.cross(uVector());
+  const auto v = ray.direction().dot(qVec) * invDet;
+  if (Unpredictable::any((u) < 0.0, u > 1.0, (v) < 0.0, u + v > 1.0))
+    return false;
+
+  const auto t = vVector().dot(qVec) * invDet;
+  return t >= Epsilon && t < maxDistance;
+}
+
+Aabb Triangle::bounds() const noexcept {
+  return Aabb()
+      .including(vertices_[0])
+      .including(vertices_[1])
+      .including(vertices_[2]);
+}
+
 Triangle::Triangle(const Triangle::Vertices &vertices)
     : vertices_(vertices), normals_{Norm3::xAxis(), Norm3::xAxis(),
                                     Norm3::xAxis()} {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "math/Aabb.h"
 #include "math/Hit.h"
 #include "math/Ray.h"
 #include "math/Vec3.h"
@@ -45,6 +46,11 @@ public:
     return uVector().cross(vVector()).normalised();
   }
   [[nodiscard]] tl::optional<Hit> intersect(const Ray &ray) const noexcept;
+  // Whether the ray hits the triangle nearer than maxDistance, without
+  // working out where.
+  [[nodiscard]] bool intersects(const Ray &ray,
+                                double maxDistance) const noexcept;
+  [[nodiscard]] Aabb bounds() const noexcept;
 };
 
 }
\ No newline at end of file
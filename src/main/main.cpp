@@ -8,20 +8,26 @@
 #include "oo/Renderer.h"
 #include "oo/SceneBuilder.h"
 #include "util/ArrayOutput.h"
+#include "util/AsyncSaver.h"
 #include "util/ObjLoader.h"
 #include "util/RenderParams.h"
+#include "util/SplitBudget.h"
 
 #include <clara.hpp>
 #include <date/chrono_io.h>
 
 #include <algorithm>
 #include <chrono>
+#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <thread>
 #include <utility>
 
+#include <sys/resource.h>
+
 namespace {
 
 struct DirRelativeOpener : ObjLoaderOpener {
@@ -317,50 +323,166 @@ struct StatsSceneBuilder {
   void addSphere(...) { numSpheres++; }
   void setEnvironmentColour(...) {}
 
-  void report() {
+  void report(std::chrono::milliseconds bvhBuildTime) {
+    using namespace date;
     std::cout << "Scene contains " << numTriangles << " triangles and "
-              << numSpheres << " spheres.\n";
+              << numSpheres << " spheres; BVH built in " << bvhBuildTime
+              << ".\n";
   }
 };
 
+template <typename Func>
+std::chrono::milliseconds timed(Func &&func) {
+  auto startTime = std::chrono::steady_clock::now();
+  func();
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - startTime);
+}
+
+dod::BvhBuilder bvhBuilder(const std::string &way, const std::string &bvh) {
+  if (bvh == "sah")
+    return dod::BvhBuilder::SurfaceAreaHeuristic;
+  if (bvh == "lbvh") {
+    if (way != "dod")
+      throw std::runtime_error("The lbvh builder is only available in dod\n");
+    return dod::BvhBuilder::Linear;
+  }
+  throw std::runtime_error("Unknown BVH builder " + bvh + "\n");
+}
+
+SamplerKind samplerKind(const std::string &sampler) {
+  if (sampler == "random")
+    return SamplerKind::Random;
+  if (sampler == "sobol")
+    return SamplerKind::Sobol;
+  throw std::runtime_error("Unknown sampler " + sampler + "\n");
+}
+
+void reportWavefrontStats(const dod::WavefrontStats &stats) {
+  if (stats.raysTraced == 0)
+    return;
+  const auto perRay = [&](uint64_t count) {
+    return static_cast<double>(count) / static_cast<double>(stats.raysTraced);
+  };
+  using std::chrono::duration_cast;
+  using std::chrono::milliseconds;
+  std::cout << "Traced " << stats.raysTraced << " rays in "
+            << duration_cast<milliseconds>(stats.intersectTime).count()
+            << "ms (sorting took "
+            << duration_cast<milliseconds>(stats.sortTime).count()
+            << "ms): " << perRay(stats.nodeVisits)
+            << " BVH nodes fetched and ";
+  if (stats.cacheMisses)
+    std::cout << perRay(*stats.cacheMisses) << " cache misses per ray.\n";
+  else
+    std::cout << "cache misses not counted (no hardware counters).\n";
+}
+
+// Throws unless the raw render in filename, with its history, can be carried
+// on with these settings.
+void checkResumable(const std::string &filename, const ArrayOutput &image,
+                    const RenderHistory &history, const std::string &sceneName,
+                    const RenderParams &renderParams) {
+  if (history.sceneName.empty())
+    throw std::runtime_error(filename
+                             + " doesn't say what scene it's a render of\n");
+  if (history.sceneName != sceneName)
+    throw std::runtime_error(filename + " is a render of "
+                             + history.sceneName + ", not " + sceneName
+                             + "\n");
+  if (image.width() != renderParams.width
+      || image.height() != renderParams.height)
+    throw std::runtime_error(
+        filename + " is " + std::to_string(image.width()) + "x"
+        + std::to_string(image.height()) + ", not "
+        + std::to_string(renderParams.width) + "x"
+        + std::to_string(renderParams.height) + "\n");
+  if (history.used(renderParams.seed))
+    throw std::runtime_error(filename + " already used seed "
+                             + std::to_string(renderParams.seed) + "\n");
+}
+
 ArrayOutput doRender(const std::string &way, const std::string &sceneName,
+                     const std::string &bvh, int bvhWidth,
                      const RenderParams &renderParams,
                      std::chrono::seconds saveEvery,
                      std::function<void(const ArrayOutput &)> save) {
   using namespace std::chrono_literals;
+  // Periodic saves happen on a writer thread of their own; the renderer only
+  // pays for a copy of the image.
+  AsyncSaver saver(std::move(save));
   auto nextSave = std::chrono::system_clock::now() + saveEvery;
   auto throttledSave = [&](const ArrayOutput &output) {
     if (saveEvery == 0s)
       return;
-    // TODO: save is not thread safe even slightly, and yet it still blocks
-    // the threads. this is terrible. Should have a thread safe result queue
-    // and a single thread reading from it.
     auto now = std::chrono::system_clock::now();
     if (now > nextSave) {
-      save(output);
+      saver.post(std::make_shared<const ArrayOutput>(output));
       nextSave = now + saveEvery;
     }
   };
 
+  const auto builder = bvhBuilder(way, bvh);
+  if (bvhWidth != 2 && way != "dod")
+    throw std::runtime_error("Wide BVHs are only available in dod\n");
+  if (renderParams.tiled
+      && (renderParams.packetSize != 1 || renderParams.wavefront))
+    throw std::runtime_error(
+        "Tiled rendering can't be combined with packets or wavefronts\n");
+  if (renderParams.raysPerPixel != 0) {
+    if (!renderParams.tiled)
+      throw std::runtime_error("A ray budget needs --tiled\n");
+    checkRayBudget(renderParams.raysPerPixel);
+  }
+  if (renderParams.adaptiveError > 0) {
+    if (!renderParams.tiled)
+      throw std::runtime_error("Adaptive sampling needs --tiled\n");
+    if (renderParams.raysPerPixel != 0)
+      throw std::runtime_error(
+          "Adaptive sampling can't be combined with a ray budget\n");
+    if (renderParams.samplesPerPixel < 2)
+      throw std::runtime_error(
+          "Adaptive sampling needs at least 2 samples per pixel\n");
+  }
+  if (renderParams.packetSize != 1 && way != "dod")
+    throw std::runtime_error("Ray packets are only available in dod\n");
+  if (renderParams.wavefront && way != "dod")
+    throw std::runtime_error(
+        "The wavefront renderer is only available in dod\n");
   StatsSceneBuilder ssb;
   createScene(ssb, sceneName, renderParams);
-  ssb.report();
 
   std::optional<ArrayOutput> result;
   if (way == "oo") {
     oo::SceneBuilder sceneBuilder;
     auto camera = createScene(sceneBuilder, sceneName, renderParams);
+    ssb.report(timed([&] { sceneBuilder.buildBvh(); }));
     oo::Renderer renderer(sceneBuilder.scene(), camera, renderParams);
+    if (renderParams.tiled)
+      return renderer.renderTiled(throttledSave);
     return renderer.render(throttledSave);
   } else if (way == "fp") {
     fp::SceneBuilder sceneBuilder;
     auto camera = createScene(sceneBuilder, sceneName, renderParams);
-    return fp::render(camera, sceneBuilder.scene(), renderParams,
+    fp::Bvh sceneBvh;
+    ssb.report(timed(
+        [&] { sceneBvh = fp::buildBvh(sceneBuilder.scene().primitives); }));
+    if (renderParams.tiled)
+      return fp::renderTiled(camera, sceneBuilder.scene(), sceneBvh,
+                             renderParams, throttledSave);
+    return fp::render(camera, sceneBuilder.scene(), sceneBvh, renderParams,
                       throttledSave);
   } else if (way == "dod") {
     dod::Scene scene;
     auto camera = createScene(scene, sceneName, renderParams);
-    return scene.render(camera, renderParams, throttledSave);
+    ssb.report(timed(
+        [&] { scene.buildBvh(builder, renderParams.maxCpus, bvhWidth); }));
+    if (renderParams.tiled)
+      return scene.renderTiled(camera, renderParams, throttledSave);
+    auto output = scene.render(camera, renderParams, throttledSave);
+    if (renderParams.wavefront)
+      reportWavefrontStats(scene.wavefrontStats());
+    return output;
   } else {
     throw std::runtime_error("Unknown way " + way + "\n");
   }
@@ -374,10 +496,16 @@ int main(int argc, const char *argv[]) {
   bool help = false;
   bool raw = false;
   int saveEvery = 30;
+  double timeBudget = 0;
   RenderParams renderParams;
   std::string way = "oo";
   std::string sceneName = "cornell";
+  std::string bvh = "sah";
+  std::string sampler = "random";
+  int bvhWidth = 2;
   std::string outputName;
+  std::string referenceName;
+  std::string resumeName;
 
   auto cli =
       Opt(renderParams.width, "width")["-w"]["--width"]("output image width")
@@ -396,11 +524,49 @@ int main(int argc, const char *argv[]) {
       | Opt(renderParams.seed,
             "seed")["--seed"]("set rendering seed (0 to use random seed)")
       | Opt(renderParams.preview)["--preview"]("super quick preview")
+      | Opt(renderParams.tiled)["--tiled"](
+          "render in tiles shared out between the threads")
+      | Opt(renderParams.packetSize, "size")["--packet-size"](
+          "trace rays in size x size packets, e.g. 2 or 4: primary rays for "
+          "blocks of pixels, or runs of paths with --wavefront (dod only)")
+      | Opt(renderParams.wavefront)["--wavefront"](
+          "trace paths a bounce at a time in batches (dod only)")
+      | Opt(renderParams.sortRays)["--sort-rays"](
+          "bin rays by origin and direction before each bounce (needs "
+          "--wavefront)")
+      | Opt(sampler, "sampler")["--sampler"](
+          "where sample positions come from, random (the default) or sobol")
+      | Opt(renderParams.nextEvent)["--next-event"](
+          "at diffuse surfaces, also aim at the spherical lights directly")
+      | Opt(renderParams.rouletteDepth, "depth")["--roulette-depth"](
+          "from this depth on, end paths at random by how much they carry, "
+          "0 (the default) to not")
+      | Opt(renderParams.raysPerPixel, "rays")["--rays-per-pixel"](
+          "instead of --spp, spend this many camera and first bounce rays on "
+          "each pixel, split at the first bounce as the variance suggests "
+          "(needs --tiled)")
+      | Opt(renderParams.adaptiveError, "error")["--adaptive-error"](
+          "keep sampling the tiles noisier than this, relative to their "
+          "brightness, e.g. 0.05, spending at most --spp per pixel on "
+          "average (needs --tiled)")
+      | Opt(timeBudget, "secs")["--time-budget"](
+          "render for this long from the start, then stop and save, instead "
+          "of after --spp samples per pixel (ray budgets and adaptive "
+          "sampling just stop early)")
       | Opt(saveEvery, "secs")["--save-every"](
           "periodically save (every secs), 0 to disable")
       | Opt(way, "way")["--way"]("which way, oo (the default), fp or dod")
       | Opt(sceneName, "scene")["--scene"]("which scene to render")
+      | Opt(bvh, "builder")["--bvh"](
+          "BVH builder, sah (the default) or lbvh (dod only)")
+      | Opt(bvhWidth, "width")["--bvh-width"](
+          "children per BVH node, 2 (the default), 4 or 8 (dod only)")
       | Opt(raw)["--raw"]("output in raw form")
+      | Opt(resumeName, "file")["--resume"](
+          "carry on adding samples to a raw render of the same scene and "
+          "size, such as the output of an earlier run with --raw")
+      | Opt(referenceName, "file")["--reference"](
+          "report the RMS error against a raw render of the same image")
       | Arg(outputName, "output")("output filename").required() | Help(help);
 
   auto result = cli.parse(Args(argc, argv));
@@ -423,15 +589,39 @@ int main(int argc, const char *argv[]) {
         static_cast<int>(std::thread::hardware_concurrency());
   }
 
+  renderParams.sampler = samplerKind(sampler);
+
+  if (timeBudget < 0) {
+    std::cerr << "The time budget can't be negative.\n";
+    exit(1);
+  }
+
+  // Loaded up front, so a bad file doesn't waste a render.
+  std::optional<ArrayOutput> reference;
+  if (!referenceName.empty())
+    reference.emplace(ArrayOutput::load(referenceName));
+  RenderHistory history{sceneName, {}};
+  std::optional<ArrayOutput> resumed;
+  if (!resumeName.empty())
+    resumed.emplace(ArrayOutput::load(resumeName, history));
+
+  // A seed the render being carried on hasn't used, so none of its samples
+  // are repeated.
   if (renderParams.seed == 0) {
     std::random_device device;
-    renderParams.seed = device();
+    while (renderParams.seed == 0 || history.used(renderParams.seed))
+      renderParams.seed = static_cast<int>(device());
   }
+  if (resumed)
+    checkResumable(resumeName, *resumed, history, sceneName, renderParams);
+  history.seeds.emplace_back(renderParams.seed);
 
   std::function<void(const ArrayOutput &)> save;
 
   if (raw) {
-    save = [outputName](const ArrayOutput &output) { output.save(outputName); };
+    save = [outputName, history](const ArrayOutput &output) {
+      output.save(outputName, history);
+    };
   } else {
     save = [outputName](const ArrayOutput &output) {
       PngWriter pw(outputName.c_str(), output.width(), output.height());
@@ -453,11 +643,25 @@ int main(int argc, const char *argv[]) {
   }
 
   auto startTime = std::chrono::system_clock::now();
-  auto output = doRender(way, sceneName, renderParams,
-                         std::chrono::seconds(saveEvery), save);
+  if (timeBudget > 0)
+    renderParams.deadline =
+        Deadline(std::chrono::duration<double>(timeBudget));
+  // Periodic saves are of the whole image, samples carried on from included.
+  auto saveImage = [&](const ArrayOutput &output) {
+    if (!resumed)
+      return save(output);
+    auto image = *resumed;
+    image += output;
+    save(image);
+  };
+  auto output = doRender(way, sceneName, bvh, bvhWidth, renderParams,
+                         std::chrono::seconds(saveEvery), saveImage);
   auto endTime = std::chrono::system_clock::now();
 
-  save(output);
+  if (resumed)
+    *resumed += output;
+  const auto &image = resumed ? *resumed : output;
+  save(image);
 
   using namespace date;
   auto timeTaken = endTime - startTime;
@@ -466,9 +670,26 @@ int main(int argc, const char *argv[]) {
             << std::chrono::duration_cast<std::chrono::seconds>(timeTaken)
             << "\n";
   std::cout << "Total samples: " << totalSamples << "\n";
+  std::cout << "Samples per pixel: "
+            << static_cast<double>(totalSamples)
+                   / (output.width() * output.height())
+            << "\n";
   auto samplesPerSec =
       static_cast<double>(totalSamples)
       / std::chrono::duration_cast<std::chrono::milliseconds>(timeTaken)
             .count();
   std::cout << "Samples/ms: " << samplesPerSec << "\n";
+  if (resumed)
+    std::cout << "Samples per pixel, with those carried on from: "
+              << static_cast<double>(image.totalSamples())
+                     / (image.width() * image.height())
+              << "\n";
+  // The high-water mark of the whole process, so comparable between the ways
+  // whatever each allocates along the way. Linux reports it in KiB.
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    std::cout << "Peak memory: " << usage.ru_maxrss / 1024 << "MiB\n";
+  if (reference)
+    std::cout << "RMS error: " << std::setprecision(5)
+              << image.rmsError(*reference) << "\n";
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "Aabb.h"
+
+#include <iostream>
+
+namespace {
+
+Vec3 minOf(const Vec3 &lhs, const Vec3 &rhs) noexcept {
+  return Vec3(std::min(lhs.x(), rhs.x()), std::min(lhs.y(), rhs.y()),
+              std::min(lhs.z(), rhs.z()));
+}
+
+Vec3 maxOf(const Vec3 &lhs, const Vec3 &rhs) noexcept {
+  return Vec3(std::max(lhs.x(), rhs.x()), std::max(lhs.y(), rhs.y()),
+              std::max(lhs.z(), rhs.z()));
+}
+
+}
+
+Aabb Aabb::including(const Vec3 &point) const noexcept {
+  return Aabb(minOf(min_, point), maxOf(max_, point));
+}
+
+Aabb Aabb::including(const Aabb &box) const noexcept {
+  return Aabb(minOf(min_, box.min_), maxOf(max_, box.max_));
+}
+
+Aabb Aabb::expanded(double amount) const noexcept {
+  const auto offset = Vec3(amount, amount, amount);
+  return Aabb(min_ - offset, max_ + offset);
+}
+
+double Aabb::surfaceArea() const noexcept {
+  if (empty())
+    return 0;
+  const auto e = extent();
+  return 2 * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+}
+
+int Aabb::longestAxis() const noexcept {
+  const auto e = extent();
+  if (e.x() >= e.y() && e.x() >= e.z())
+    return 0;
+  return e.y() >= e.z() ? 1 : 2;
+}
+
+std::ostream &operator<<(std::ostream &o, const Aabb &box) {
+  return o << "{" << box.min() << " - " << box.max() << "}";
+}
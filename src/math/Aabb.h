@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Ray.h"
+#include "Vec3.h"
+
+#include <algorithm>
+#include <iosfwd>
+#include <limits>
+
+// An axis-aligned bounding box. A default-constructed box is empty: including
+// anything in it yields just the bounds of that thing.
+class Aabb {
+  static constexpr double Inf = std::numeric_limits<double>::infinity();
+  Vec3 min_{Inf, Inf, Inf};
+  Vec3 max_{-Inf, -Inf, -Inf};
+
+public:
+  constexpr Aabb() noexcept = default;
+  constexpr Aabb(const Vec3 &min, const Vec3 &max) noexcept
+      : min_(min), max_(max) {}
+
+  [[nodiscard]] constexpr const Vec3 &min() const noexcept { return min_; }
+  [[nodiscard]] constexpr const Vec3 &max() const noexcept { return max_; }
+
+  [[nodiscard]] constexpr bool empty() const noexcept {
+    return min_.x() > max_.x() || min_.y() > max_.y() || min_.z() > max_.z();
+  }
+
+  [[nodiscard]] Aabb including(const Vec3 &point) const noexcept;
+  [[nodiscard]] Aabb including(const Aabb &box) const noexcept;
+
+  [[nodiscard]] constexpr Vec3 centre() const noexcept {
+    return (min_ + max_) * 0.5;
+  }
+  [[nodiscard]] constexpr Vec3 extent() const noexcept { return max_ - min_; }
+  [[nodiscard]] double surfaceArea() const noexcept;
+  [[nodiscard]] int longestAxis() const noexcept;
+
+  // Grows the box by the given amount in every direction.
+  [[nodiscard]] Aabb expanded(double amount) const noexcept;
+
+  [[nodiscard]] static Vec3 inverseDirection(const Ray &ray) noexcept {
+    return 1.0 / ray.direction().toVec3();
+  }
+
+  // Slab test against the part of the ray in [0, nearerThan]. The inverse
+  // direction is passed in so callers testing many boxes against one ray only
+  // divide once. A ray lying exactly in one of the box's planes computes
+  // 0 * inf, and the resulting NaN may give a miss: callers that need such
+  // rays to hit should pad their boxes with expanded().
+  [[nodiscard]] bool intersects(const Ray &ray, const Vec3 &inverseDirection,
+                                double nearerThan) const noexcept {
+    const auto t0 = (min_ - ray.origin()) * inverseDirection;
+    const auto t1 = (max_ - ray.origin()) * inverseDirection;
+    const auto tNear =
+        std::max({0.0, std::min(t0.x(), t1.x()), std::min(t0.y(), t1.y()),
+                  std::min(t0.z(), t1.z())});
+    const auto tFar =
+        std::min({nearerThan, std::max(t0.x(), t1.x()),
+                  std::max(t0.y(), t1.y()), std::max(t0.z(), t1.z())});
+    // Scale up the far distance by a few ulps so rounding in the slab
+    // distances never culls a primitive the exact test would have hit.
+    constexpr auto robustScale = 1 + 4 * std::numeric_limits<double>::epsilon();
+    return tNear <= tFar * robustScale;
+  }
+};
+
+std::ostream &operator<<(std::ostream &o, const Aabb &box);
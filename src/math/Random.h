@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+// Small, fast random number generators for rendering. Each is a standard
+// UniformRandomBitGenerator, so works with the <random> distributions, and
+// each has a few bytes of state that is seeded in O(1): cheap enough to give
+// every sample of every pixel a generator of its own. That way what a sample
+// sees depends only on the seed, the pixel and the sample number, not on
+// which thread rendered it or what it rendered before.
+
+// The SplitMix64 finaliser: a cheap, well-mixing 64-bit hash.
+[[nodiscard]] constexpr uint64_t mix64(uint64_t x) noexcept {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30u)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27u)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31u);
+}
+
+// A seed for the generator of the given sample of the given pixel.
+[[nodiscard]] constexpr uint64_t sampleSeed(uint64_t seed, uint64_t pixel,
+                                            uint64_t sample) noexcept {
+  return mix64(mix64(mix64(seed) ^ pixel) ^ sample);
+}
+
+// PCG-XSH-RR with 64 bits of state and selectable stream, after O'Neill's
+// reference pcg32.
+class Pcg32 {
+  uint64_t state_{};
+  uint64_t increment_{};
+
+public:
+  using result_type = uint32_t;
+  static constexpr result_type min() noexcept { return 0; }
+  static constexpr result_type max() noexcept {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  explicit constexpr Pcg32(uint64_t seed, uint64_t stream = 0) noexcept
+      : increment_((stream << 1u) | 1u) {
+    (*this)();
+    state_ += seed;
+    (*this)();
+  }
+
+  constexpr result_type operator()() noexcept {
+    const auto old = state_;
+    state_ = old * 6364136223846793005ULL + increment_;
+    const auto xorShifted =
+        static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+    const auto rot = static_cast<uint32_t>(old >> 59u);
+    return (xorShifted >> rot) | (xorShifted << ((-rot) & 31u));
+  }
+};
+
+// xoshiro256+ (Blackman and Vigna), seeded through SplitMix64. The lowest
+// bits are weak, but only the top 53 make it into a double.
+class Xoshiro256Plus {
+  uint64_t s_[4]{};
+
+  static constexpr uint64_t rotl(uint64_t x, unsigned k) noexcept {
+    return (x << k) | (x >> (64u - k));
+  }
+
+public:
+  using result_type = uint64_t;
+  static constexpr result_type min() noexcept { return 0; }
+  static constexpr result_type max() noexcept {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  explicit constexpr Xoshiro256Plus(uint64_t seed) noexcept {
+    for (auto &s : s_) {
+      s = mix64(seed);
+      seed += 0x9e3779b97f4a7c15ULL;
+    }
+  }
+
+  constexpr result_type operator()() noexcept {
+    const auto result = s_[0] + s_[3];
+    const auto t = s_[1] << 17u;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+    return result;
+  }
+};
+
+// Widynski's counter-based "Squares" generator (squares64): the nth number
+// is a pure function of the key and n, so any point in the sequence can be
+// reached in O(1), and there is no state beyond the counter.
+class Squares {
+  uint64_t key_;
+  uint64_t counter_;
+
+  static constexpr uint64_t swapHalves(uint64_t x) noexcept {
+    return (x >> 32u) | (x << 32u);
+  }
+
+public:
+  using result_type = uint64_t;
+  static constexpr result_type min() noexcept { return 0; }
+  static constexpr result_type max() noexcept {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  // The key should have plenty of set bits, so it's hashed from the seed.
+  explicit constexpr Squares(uint64_t seed, uint64_t counter = 0) noexcept
+      : key_(mix64(seed) | 1u), counter_(counter) {}
+
+  [[nodiscard]] constexpr result_type at(uint64_t counter) const noexcept {
+    auto x = counter * key_;
+    const auto y = x;
+    const auto z = y + key_;
+    x = swapHalves(x * x + y);
+    x = swapHalves(x * x + z);
+    x = swapHalves(x * x + y);
+    const auto t = x * x + z;
+    x = swapHalves(t);
+    return t ^ ((x * x + y) >> 32u);
+  }
+
+  constexpr result_type operator()() noexcept { return at(counter_++); }
+  constexpr void discard(uint64_t n) noexcept { counter_ += n; }
+};
+
+// The generator the renderers use. Any of the above will do.
+using Rng = Xoshiro256Plus;
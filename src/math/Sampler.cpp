@@ -0,0 +1,103 @@
+#include "Sampler.h"
+
+#include <array>
+
+namespace {
+
+constexpr uint32_t reverseBits(uint32_t x) noexcept {
+  x = ((x >> 1u) & 0x55555555u) | ((x & 0x55555555u) << 1u);
+  x = ((x >> 2u) & 0x33333333u) | ((x & 0x33333333u) << 2u);
+  x = ((x >> 4u) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4u);
+  x = ((x >> 8u) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8u);
+  return (x >> 16u) | (x << 16u);
+}
+
+// Burley's hash, which only ever mixes bits into higher ones: applied to
+// reversed bits, each bit is flipped according to those before it, as an
+// Owen scramble requires.
+constexpr uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed) noexcept {
+  x ^= x * 0x3d20adeau;
+  x += seed;
+  x *= (seed >> 16u) | 1u;
+  x ^= x * 0x05526c56u;
+  x ^= x * 0x53a22864u;
+  return x;
+}
+
+constexpr uint32_t nestedUniformScramble(uint32_t x, uint32_t seed) noexcept {
+  return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+}
+
+// The second dimension of the Sobol sequence; the first is just the index's
+// bits reversed. As it's linear in the index's bits, it's a table lookup per
+// byte of the index.
+using SobolTables = std::array<std::array<uint32_t, 256>, 4>;
+
+constexpr SobolTables makeSobolTables() noexcept {
+  std::array<uint32_t, 32> directions{};
+  uint32_t direction = 1u << 31u;
+  for (auto &d : directions) {
+    d = direction;
+    direction ^= direction >> 1u;
+  }
+  SobolTables tables{};
+  for (uint32_t byte = 0; byte < 4; ++byte)
+    for (uint32_t value = 0; value < 256; ++value)
+      for (uint32_t bit = 0; bit < 8; ++bit)
+        if (value & (1u << bit))
+          tables[byte][value] ^= directions[byte * 8 + bit];
+  return tables;
+}
+
+constexpr SobolTables sobolTables = makeSobolTables();
+
+constexpr uint32_t sobolSecond(uint32_t index) noexcept {
+  return sobolTables[0][index & 0xffu] ^ sobolTables[1][(index >> 8u) & 0xffu]
+         ^ sobolTables[2][(index >> 16u) & 0xffu]
+         ^ sobolTables[3][index >> 24u];
+}
+
+}
+
+Sampler::Sampler(SamplerKind kind, uint64_t seed, uint64_t pixel,
+                 uint64_t sample) noexcept
+    : kind_(kind), pixelSeed_(mix64(mix64(seed) ^ pixel)), index_(sample),
+      rng_(sampleSeed(seed, pixel, sample)) {}
+
+uint32_t Sampler::sobol(uint32_t dimension) const noexcept {
+  const auto pairSeed = mix64(pixelSeed_ ^ (dimension / 2));
+  const auto shuffled = nestedUniformScramble(static_cast<uint32_t>(index_),
+                                              static_cast<uint32_t>(pairSeed));
+  const auto bits =
+      dimension % 2 == 0 ? reverseBits(shuffled) : sobolSecond(shuffled);
+  return nestedUniformScramble(
+      bits, static_cast<uint32_t>(pairSeed >> 32u) + dimension % 2);
+}
+
+std::pair<double, double> Sampler::next2D() noexcept {
+  // Start on a pair, so the two are stratified together.
+  dimension_ += dimension_ % 2;
+  const auto u = next1D();
+  const auto v = next1D();
+  return {u, v};
+}
+
+Sampler Sampler::branch(uint32_t branch, uint32_t numBranches) noexcept {
+  auto result = *this;
+  if (numBranches == 1)
+    return result;
+  if (kind_ == SamplerKind::Random)
+    result.rng_ = Rng(mix64(rng_() + branch));
+  else
+    result.index_ = index_ * numBranches + branch;
+  return result;
+}
+
+std::pair<double, double> Sampler::stratified2D(int uSample, int numUSamples,
+                                                int vSample,
+                                                int numVSamples) noexcept {
+  auto [u, v] = next2D();
+  if (kind_ == SamplerKind::Sobol)
+    return {u, v};
+  return {(uSample + u) / numUSamples, (vSample + v) / numVSamples};
+}
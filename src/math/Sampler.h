@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Random.h"
+
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+enum class SamplerKind { Random, Sobol };
+
+// Supplies the numbers one path needs, a dimension at a time: the pixel
+// offset, then for each bounce the direction and the choice of reflection.
+// Random sampling draws them from a generator seeded for the sample alone.
+// Sobol sampling takes them from an Owen-scrambled Sobol sequence indexed by
+// the sample number, so a pixel's samples are spread far more evenly than
+// random ones and converge faster. The sequence is two-dimensional, padded
+// to as many dimensions as a path needs by giving each pair of dimensions its
+// own shuffle and scramble, seeded by the pixel (after Burley's "Practical
+// Hash-based Owen Scrambling").
+//
+// A Sampler is also a UniformRandomBitGenerator, each call yielding the next
+// dimension, so it works anywhere a generator does; Camera::randomRay() for
+// example.
+class Sampler {
+  SamplerKind kind_;
+  uint64_t pixelSeed_;
+  uint64_t index_;
+  uint32_t dimension_{};
+  Rng rng_;
+
+  [[nodiscard]] uint32_t sobol(uint32_t dimension) const noexcept;
+
+public:
+  using result_type = uint64_t;
+  static constexpr result_type min() noexcept { return 0; }
+  static constexpr result_type max() noexcept {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  Sampler(SamplerKind kind, uint64_t seed, uint64_t pixel,
+          uint64_t sample) noexcept;
+
+  result_type operator()() noexcept {
+    if (kind_ == SamplerKind::Random)
+      return rng_();
+    return static_cast<result_type>(sobol(dimension_++)) << 32u;
+  }
+
+  // A number in [0, 1).
+  [[nodiscard]] double next1D() noexcept {
+    return static_cast<double>((*this)() >> 11u) * 0x1p-53;
+  }
+
+  // A point in [0, 1)^2. For Sobol, the two come from the same pair of
+  // dimensions, so are stratified together.
+  [[nodiscard]] std::pair<double, double> next2D() noexcept;
+
+  // The sampler for one of numBranches paths that split from this one, as at
+  // the first bounce. For Sobol the branches take consecutive indices of the
+  // sequence, so between them they stratify the next2D() that follows.
+  [[nodiscard]] Sampler branch(uint32_t branch, uint32_t numBranches) noexcept;
+
+  // A point within cell (uSample, vSample) of a numUSamples x numVSamples
+  // grid, for the given branch's sampler. Sobol samplers are stratified by
+  // branching, so just return their next2D().
+  [[nodiscard]] std::pair<double, double>
+  stratified2D(int uSample, int numUSamples, int vSample,
+               int numVSamples) noexcept;
+};
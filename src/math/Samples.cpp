@@ -1,6 +1,7 @@
 #include "Samples.h"
 #include "Epsilon.h"
 
+#include <algorithm>
 #include <cmath>
 
 Norm3 coneSample(const Norm3 &direction, double coneTheta, double u,
@@ -28,3 +29,41 @@ Norm3 hemisphereSample(const OrthoNormalBasis &basis, double u,
                       sqrt(1 - radiusSquared)))
       .normalised();
 }
+
+double hemisphereSamplePdf(const Norm3 &normal,
+                           const Norm3 &direction) noexcept {
+  return std::max(normal.dot(direction), 0.0) / M_PI;
+}
+
+namespace {
+
+double cosConeAngle(const Vec3 &from, const Vec3 &centre, double radius) {
+  const auto sinSquared = radius * radius / (centre - from).lengthSquared();
+  return sqrt(std::max(1 - sinSquared, 0.0));
+}
+
+}
+
+Norm3 sphereSample(const Vec3 &from, const Vec3 &centre, double radius,
+                   double u, double v) noexcept {
+  const auto cosTheta = 1 - u * (1 - cosConeAngle(from, centre, radius));
+  const auto sinTheta = sqrt(std::max(1 - cosTheta * cosTheta, 0.0));
+  const auto phi = v * 2 * M_PI;
+  const auto basis = OrthoNormalBasis::fromZ((centre - from).normalised());
+  return basis
+      .transform(Vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta))
+      .normalised();
+}
+
+double sphereSamplePdf(const Vec3 &from, const Vec3 &centre,
+                       double radius) noexcept {
+  if ((centre - from).lengthSquared() <= radius * radius)
+    return 0;
+  return 1 / (2 * M_PI * (1 - cosConeAngle(from, centre, radius)));
+}
+
+double powerHeuristic(double pdf, double otherPdf) noexcept {
+  const auto squared = pdf * pdf;
+  const auto total = squared + otherPdf * otherPdf;
+  return total > 0 ? squared / total : 0;
+}
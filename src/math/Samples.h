@@ -8,3 +8,23 @@
 
 [[nodiscard]] Norm3 hemisphereSample(const OrthoNormalBasis &basis, double u,
                                      double v) noexcept;
+
+// The density (per steradian) of hemisphereSample()'s directions about the
+// given normal.
+[[nodiscard]] double hemisphereSamplePdf(const Norm3 &normal,
+                                         const Norm3 &direction) noexcept;
+
+// A direction from a point outside a sphere, uniformly distributed over the
+// solid angle the sphere subtends.
+[[nodiscard]] Norm3 sphereSample(const Vec3 &from, const Vec3 &centre,
+                                 double radius, double u, double v) noexcept;
+
+// The density (per steradian) of sphereSample()'s directions: zero from
+// inside the sphere, where it has no solid angle to sample.
+[[nodiscard]] double sphereSamplePdf(const Vec3 &from, const Vec3 &centre,
+                                     double radius) noexcept;
+
+// The weight for a sample drawn with the given density, when the same thing
+// could also have been sampled by another strategy with otherPdf: Veach's
+// power heuristic, with a power of two.
+[[nodiscard]] double powerHeuristic(double pdf, double otherPdf) noexcept;
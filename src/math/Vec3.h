@@ -100,6 +100,9 @@ public:
   [[nodiscard]] constexpr double x() const noexcept { return x_; }
   [[nodiscard]] constexpr double y() const noexcept { return y_; }
   [[nodiscard]] constexpr double z() const noexcept { return z_; }
+  [[nodiscard]] constexpr double operator[](int axis) const noexcept {
+    return axis == 0 ? x_ : axis == 1 ? y_ : z_;
+  }
 
   [[nodiscard]] static constexpr Vec3 xAxis() { return Vec3(1, 0, 0); }
   [[nodiscard]] static constexpr Vec3 yAxis() { return Vec3(0, 1, 0); }
@@ -0,0 +1,132 @@
+#include "BvhNode.h"
+#include "math/Epsilon.h"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+
+using oo::BvhNode;
+using oo::Primitive;
+
+namespace {
+
+struct BuildItem {
+  std::unique_ptr<Primitive> primitive;
+  Aabb bounds;
+  Vec3 centre;
+};
+using BuildIter = std::vector<BuildItem>::iterator;
+
+void sortAlong(BuildIter begin, BuildIter end, int axis) {
+  std::sort(begin, end, [axis](const BuildItem &lhs, const BuildItem &rhs) {
+    return lhs.centre[axis] < rhs.centre[axis];
+  });
+}
+
+std::unique_ptr<Primitive> build(BuildIter begin, BuildIter end) {
+  const auto count = static_cast<size_t>(end - begin);
+  if (count == 1)
+    return std::move(begin->primitive);
+
+  // For each axis, sort by centre and sweep to find the split with the
+  // lowest surface area heuristic cost: the areas of the two sides, each
+  // weighted by how many primitives are in it.
+  struct Split {
+    int axis;
+    size_t index;
+    double cost;
+  };
+  std::optional<Split> best;
+  std::vector<double> rightCost(count);
+  for (int axis = 0; axis < 3; ++axis) {
+    sortAlong(begin, end, axis);
+    Aabb right;
+    for (auto index = count - 1; index > 0; --index) {
+      right = right.including(begin[index].bounds);
+      rightCost[index] = right.surfaceArea() * (count - index);
+    }
+    Aabb left;
+    for (size_t index = 1; index < count; ++index) {
+      left = left.including(begin[index - 1].bounds);
+      auto cost = left.surfaceArea() * index + rightCost[index];
+      if (!best || cost < best->cost)
+        best = Split{axis, index, cost};
+    }
+  }
+
+  sortAlong(begin, end, best->axis);
+  auto middle = begin + best->index;
+  return std::make_unique<BvhNode>(build(begin, middle), build(middle, end),
+                                   best->axis);
+}
+
+}
+
+BvhNode::BvhNode(std::unique_ptr<Primitive> left,
+                 std::unique_ptr<Primitive> right, int splitAxis)
+    : children_{std::move(left), std::move(right)},
+      // Padded so rays lying exactly in the plane of a flat box (e.g. one
+      // holding an axis-aligned triangle) still hit it.
+      childBounds_{children_[0]->bounds().expanded(Epsilon),
+                   children_[1]->bounds().expanded(Epsilon)},
+      interiorChildren_{dynamic_cast<const BvhNode *>(children_[0].get()),
+                        dynamic_cast<const BvhNode *>(children_[1].get())},
+      splitAxis_(splitAxis) {}
+
+bool BvhNode::intersect(const Ray &ray,
+                        IntersectionRecord &intersection) const {
+  return intersect(ray, intersection, std::numeric_limits<double>::infinity());
+}
+
+bool BvhNode::intersect(const Ray &ray, IntersectionRecord &intersection,
+                        double maxDistance) const {
+  const auto inverseDirection = Aabb::inverseDirection(ray);
+  // Try the child on the side the ray comes from first: if it's hit, the
+  // other can often be culled without being visited.
+  const auto first = ray.direction().toVec3()[splitAxis_] < 0 ? 1 : 0;
+  auto nearest = maxDistance;
+  bool found = false;
+  for (auto child : {first, 1 - first}) {
+    if (!childBounds_[child].intersects(ray, inverseDirection, nearest))
+      continue;
+    IntersectionRecord rec;
+    // Interior children cull their own children by the nearest hit so far.
+    const auto *interior = interiorChildren_[child];
+    const auto hit = interior ? interior->intersect(ray, rec, nearest)
+                              : children_[child]->intersect(ray, rec);
+    if (hit && rec.hit.distance < nearest) {
+      nearest = rec.hit.distance;
+      intersection = rec;
+      found = true;
+    }
+  }
+  return found;
+}
+
+bool BvhNode::occluded(const Ray &ray, double maxDistance) const {
+  const auto inverseDirection = Aabb::inverseDirection(ray);
+  for (int child = 0; child < 2; ++child) {
+    if (childBounds_[child].intersects(ray, inverseDirection, maxDistance)
+        && children_[child]->occluded(ray, maxDistance))
+      return true;
+  }
+  return false;
+}
+
+Aabb BvhNode::bounds() const {
+  return childBounds_[0].including(childBounds_[1]);
+}
+
+std::unique_ptr<Primitive>
+BvhNode::build(std::vector<std::unique_ptr<Primitive>> primitives) {
+  if (primitives.empty())
+    return {};
+  std::vector<BuildItem> items;
+  items.reserve(primitives.size());
+  for (auto &primitive : primitives) {
+    auto bounds = primitive->bounds();
+    items.emplace_back(
+        BuildItem{std::move(primitive), bounds, bounds.centre()});
+  }
+  return ::build(items.begin(), items.end());
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "oo/Primitive.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace oo {
+
+// An interior node of a bounding volume hierarchy. Each child is either
+// another BvhNode or one of the scene's primitives: the hierarchy is just
+// more Primitives, so nothing that intersects the scene need know it's there.
+class BvhNode : public Primitive {
+  std::array<std::unique_ptr<Primitive>, 2> children_;
+  // Held here rather than asked of the children, so a child can be culled
+  // without a virtual call.
+  std::array<Aabb, 2> childBounds_;
+  // The children that are BvhNodes too, or null, so they can be told how
+  // near a hit they have to beat.
+  std::array<const BvhNode *, 2> interiorChildren_;
+  int splitAxis_;
+
+public:
+  BvhNode(std::unique_ptr<Primitive> left, std::unique_ptr<Primitive> right,
+          int splitAxis);
+
+  [[nodiscard]] bool intersect(const Ray &ray,
+                               IntersectionRecord &intersection) const override;
+  // As intersect(), but only finds hits nearer than maxDistance, culling
+  // anything further away.
+  [[nodiscard]] bool intersect(const Ray &ray, IntersectionRecord &intersection,
+                               double maxDistance) const;
+  [[nodiscard]] bool occluded(const Ray &ray,
+                              double maxDistance) const override;
+  [[nodiscard]] Aabb bounds() const override;
+
+  // The left (0) or right (1) child.
+  [[nodiscard]] const Primitive &child(int index) const {
+    return *children_[index];
+  }
+
+  // Builds a hierarchy over the primitives using the surface area heuristic,
+  // returning its root.
+  [[nodiscard]] static std::unique_ptr<Primitive>
+  build(std::vector<std::unique_ptr<Primitive>> primitives);
+};
+
+}
@@ -15,9 +15,10 @@ public:
     return mat_.diffuse;
   }
 
-  [[nodiscard]] Vec3 totalEmission(const Vec3 &inbound) const
+  [[nodiscard]] Vec3 totalEmission(const Vec3 &inbound,
+                                   const Vec3 &emissionWeight) const
       noexcept override {
-    return mat_.emission + inbound;
+    return mat_.emission * emissionWeight + inbound;
   }
 };
 
@@ -40,9 +41,8 @@ public:
                                        mat_.reflectionConeAngleRadians, u, v)));
     } else {
       auto basis = OrthoNormalBasis::fromZ(hit.normal);
-      return mat_.diffuse
-             * radianceSampler.sample(
-                 Ray(hit.position, hemisphereSample(basis, u, v)));
+      return radianceSampler.sampleDiffuse(
+          hit, Ray(hit.position, hemisphereSample(basis, u, v)), mat_.diffuse);
     }
   }
 };
@@ -59,9 +59,8 @@ public:
                                        mat_.reflectionConeAngleRadians, u, v)));
     } else {
       auto basis = OrthoNormalBasis::fromZ(hit.normal);
-      return mat_.diffuse
-             * radianceSampler.sample(
-                 Ray(hit.position, hemisphereSample(basis, u, v)));
+      return radianceSampler.sampleDiffuse(
+          hit, Ray(hit.position, hemisphereSample(basis, u, v)), mat_.diffuse);
     }
   }
 };
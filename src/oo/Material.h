@@ -19,7 +19,13 @@ public:
   public:
     virtual ~RadianceSampler() = default;
 
+    // The light along the ray, weighted by the path so far.
     [[nodiscard]] virtual Vec3 sample(const Ray &ray) const = 0;
+    // As sample(), for a ray leaving a diffuse surface of the given colour at
+    // hit in a direction chosen by hemisphereSample(). This may also sample
+    // the lights directly.
+    [[nodiscard]] virtual Vec3 sampleDiffuse(const Hit &hit, const Ray &ray,
+                                             const Vec3 &colour) const = 0;
   };
 
   [[nodiscard]] virtual Vec3 sample(const Hit &hit, const Ray &incoming,
@@ -28,7 +34,10 @@ public:
 
   [[nodiscard]] virtual Vec3 previewColour() const noexcept = 0;
 
-  [[nodiscard]] virtual Vec3 totalEmission(const Vec3 &inbound) const
+  // The light leaving the surface: inbound, plus what it emits, scaled by
+  // emissionWeight.
+  [[nodiscard]] virtual Vec3 totalEmission(const Vec3 &inbound,
+                                           const Vec3 &emissionWeight) const
       noexcept = 0;
 
   static std::unique_ptr<Material> from(const MaterialSpec &mat);
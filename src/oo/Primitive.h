@@ -1,5 +1,6 @@
 #pragma once
 
+#include "math/Aabb.h"
 #include "math/Hit.h"
 #include "math/Ray.h"
 #include "oo/Material.h"
@@ -16,6 +17,13 @@ public:
 
   [[nodiscard]] virtual bool
   intersect(const Ray &ray, IntersectionRecord &intersection) const = 0;
+
+  // Whether the ray hits anything nearer than maxDistance. Any hit will do,
+  // so this stops at the first one, and works out nothing about it.
+  [[nodiscard]] virtual bool occluded(const Ray &ray,
+                                      double maxDistance) const = 0;
+
+  [[nodiscard]] virtual Aabb bounds() const = 0;
 };
 
 }
\ No newline at end of file
@@ -1,8 +1,9 @@
 #include "Renderer.h"
-#include "util/WorkQueue.h"
-
-#include <future>
-#include <thread>
+#include "math/Samples.h"
+#include "util/PassRunner.h"
+#include "util/RenderProgress.h"
+#include "util/RussianRoulette.h"
+#include "util/TiledRender.h"
 
 using oo::Renderer;
 
@@ -17,167 +18,126 @@ Renderer::generateTiles(int xTileSize, int yTileSize, int numSamples,
 std::vector<Renderer::Tile>
 Renderer::generateTiles(int width, int height, int xTileSize, int yTileSize,
                         int numSamples, int samplesPerTile, int seed) {
-  std::mt19937 rng(seed);
-  std::vector<Tile> tiles;
-  for (int y = 0; y < height; y += yTileSize) {
-    int yBegin = y;
-    int yEnd = std::min(y + yTileSize, height);
-    for (int x = 0; x < width; x += xTileSize) {
-      int xBegin = x;
-      int xEnd = std::min(x + xTileSize, width);
-      int midX = (xEnd + xBegin) / 2;
-      int midY = (yEnd + yBegin) / 2;
-      int centreX = width / 2;
-      int centreY = height / 2;
-      size_t distanceSqr = (midX - centreX) * (midX - centreX)
-                           + (midY - centreY) * (midY - centreY);
-      for (int s = 0; s < numSamples; s += samplesPerTile) {
-        int nSamples = std::min(s + samplesPerTile, numSamples) - s;
-        tiles.emplace_back(
-            Tile{xBegin, xEnd, yBegin, yEnd, nSamples, s, distanceSqr, rng()});
-      }
-    }
-  }
-  std::sort(tiles.begin(), tiles.end(), [](const Tile &lhs, const Tile &rhs) {
-    return lhs.key() > rhs.key();
-  });
-  return tiles;
+  return ::generateTiles(width, height, xTileSize, yTileSize, numSamples,
+                         samplesPerTile, seed);
 }
 
-class Renderer::Sampler : public oo::Material::RadianceSampler {
+class Renderer::RadianceSampler : public oo::Material::RadianceSampler {
   const Renderer &renderer_;
-  std::mt19937 &rng_;
+  Sampler &sampler_;
   int depth_;
+  Vec3 throughput_;
 
 public:
-  Sampler(const Renderer &renderer, std::mt19937 &rng, int depth)
-      : renderer_(renderer), rng_(rng), depth_(depth) {}
+  RadianceSampler(const Renderer &renderer, Sampler &sampler, int depth,
+                  const Vec3 &throughput)
+      : renderer_(renderer), sampler_(sampler), depth_(depth),
+        throughput_(throughput) {}
   [[nodiscard]] Vec3 sample(const Ray &ray) const override {
-    return renderer_.radiance(rng_, ray, depth_);
+    return renderer_.radiance(sampler_, ray, depth_, 0, throughput_);
+  }
+  [[nodiscard]] Vec3 sampleDiffuse(const Hit &hit, const Ray &ray,
+                                   const Vec3 &colour) const override {
+    const auto throughput = throughput_ * colour;
+    if (!renderer_.renderParams_.nextEvent)
+      return renderer_.radiance(sampler_, ray, depth_, 0, throughput);
+    Vec3 direct;
+    if (depth_ < renderer_.renderParams_.maxDepth)
+      direct = renderer_.scene_.lights().sampleDirect(
+          sampler_, hit, [this](const Ray &shadowRay, double maxDistance) {
+            return renderer_.scene_.occluded(shadowRay, maxDistance);
+          });
+    return throughput * direct
+           + renderer_.radiance(
+               sampler_, ray, depth_,
+               hemisphereSamplePdf(hit.normal, ray.direction()), throughput);
   }
 };
 
-Vec3 Renderer::radiance(std::mt19937 &rng, const Ray &ray, int depth) const {
+Vec3 Renderer::radiance(Sampler &sampler, const Ray &ray, int depth,
+                        double bsdfPdf, const Vec3 &throughput) const {
   if (depth >= renderParams_.maxDepth)
     return Vec3();
+  const auto survivor =
+      russianRoulette(sampler, throughput, depth, renderParams_);
+  if (!survivor)
+    return Vec3();
   int numUSamples = depth == 0 ? renderParams_.firstBounceUSamples : 1;
   int numVSamples = depth == 0 ? renderParams_.firstBounceVSamples : 1;
   Primitive::IntersectionRecord intersectionRecord;
   if (!scene_.intersect(ray, intersectionRecord))
-    return scene_.environment(ray);
+    return *survivor * scene_.environment(ray);
 
   const auto &material = *intersectionRecord.material;
   if (renderParams_.preview)
-    return material.previewColour();
+    return *survivor * material.previewColour();
   const auto &hit = intersectionRecord.hit;
 
   Vec3 result;
-  Sampler sampler(*this, rng, depth + 1);
 
-  // Sample evenly with random offset.
-  std::uniform_real_distribution<> unit(0, 1.0);
+  // Sample evenly with random offset. Each sample carries its share of the
+  // throughput.
+  const auto numSamples = numUSamples * numVSamples;
+  const auto sampleThroughput = *survivor / numSamples;
   for (auto uSample = 0; uSample < numUSamples; ++uSample) {
     for (auto vSample = 0; vSample < numVSamples; ++vSample) {
-      auto u = (uSample + unit(rng)) / numUSamples;
-      auto v = (vSample + unit(rng)) / numVSamples;
-      auto p = unit(rng);
+      auto branch = sampler.branch(uSample * numVSamples + vSample, numSamples);
+      auto [u, v] =
+          branch.stratified2D(uSample, numUSamples, vSample, numVSamples);
+      auto p = branch.next1D();
+      RadianceSampler radianceSampler(*this, branch, depth + 1,
+                                      sampleThroughput);
 
       // TODO point out this is how we deal with "recursion" or encapsulation
       // between material and renderer.
-      result += material.sample(hit, ray, sampler, u, v, p);
+      result += material.sample(hit, ray, radianceSampler, u, v, p);
     }
   }
-  return material.totalEmission(result / (numUSamples * numVSamples));
+  return material.totalEmission(
+      result, *survivor
+                  * scene_.lights().emissionWeight(ray, hit.distance, bsdfPdf));
 }
 
 ArrayOutput Renderer::render(
     const std::function<void(const ArrayOutput &)> &updateFunc) const {
-  int curSample = 0;
-  auto launch = [&] {
-    return std::async(std::launch::async, [&] {
-      ArrayOutput output(renderParams_.width, renderParams_.height);
-      std::mt19937 rng(renderParams_.seed + curSample++);
-      for (auto y = 0; y < renderParams_.height; ++y) {
-        for (auto x = 0; x < renderParams_.width; ++x) {
-          auto ray = camera_.randomRay(x, y, rng);
-          output.addSamples(x, y, radiance(rng, ray, 0), 1);
-        }
+  const auto &deadline = renderParams_.deadline;
+  auto renderPass = [&](int pass) {
+    ArrayOutput output(renderParams_.width, renderParams_.height);
+    forEachRow(deadline, renderParams_.height, 1, [&](int y) {
+      for (auto x = 0; x < renderParams_.width; ++x) {
+        Sampler sampler(renderParams_.sampler, renderParams_.seed,
+                        x + y * renderParams_.width, pass);
+        auto ray = camera_.randomRay(x, y, sampler);
+        output.addSamples(x, y, radiance(sampler, ray, 0, 0, Vec3(1, 1, 1)), 1);
       }
-      return output;
     });
-  };
-
-  std::vector<std::future<ArrayOutput>> futures;
-  auto ensureMaxCpus = [&] {
-    auto numLeft = renderParams_.samplesPerPixel - curSample;
-    auto numSpareCpus = renderParams_.maxCpus - futures.size();
-    auto numToSpawn = std::min<size_t>(numLeft, numSpareCpus);
-    for (size_t i = 0u; i < numToSpawn; ++i)
-      futures.emplace_back(launch());
+    return output;
   };
 
   size_t numDone = 0;
   ArrayOutput output(renderParams_.width, renderParams_.height);
-  Progressifier progressifier(renderParams_.samplesPerPixel);
-  do {
-    ensureMaxCpus();
-    const auto firstDone =
-        std::find_if(futures.begin(), futures.end(), [&](auto &f) {
-          return f.wait_for(std::chrono::milliseconds(1))
-                 == std::future_status ::ready;
-        });
-    if (firstDone != futures.end()) {
-      output += firstDone->get();
-      numDone++;
-      progressifier.update(numDone);
-      updateFunc(output);
-      futures.erase(firstDone);
-    } else {
-      std::this_thread::sleep_for(std::chrono::milliseconds(250));
-    }
-
-  } while (curSample < renderParams_.samplesPerPixel);
+  RenderProgress progress(deadline, renderParams_.samplesPerPixel);
+  runPasses(
+      renderParams_.numPasses(), renderParams_.maxCpus, renderPass,
+      [&](ArrayOutput pass) {
+        output += pass;
+        numDone++;
+        progress.update(numDone);
+        updateFunc(output);
+      },
+      deadline);
   return output;
 }
 
 ArrayOutput Renderer::renderTiled(
     std::function<void(const ArrayOutput &)> updateFunc) const {
-  ArrayOutput output(renderParams_.width, renderParams_.height);
-
-  auto renderPixel = [this](std::mt19937 &rng, int pixelX, int pixelY,
-                            int numSamples) {
-    Vec3 colour;
-    for (int sample = 0; sample < numSamples; ++sample) {
-      auto ray = camera_.randomRay(pixelX, pixelY, rng);
-      colour += radiance(rng, ray, 0);
-    }
-    return colour;
-  };
-
-  WorkQueue<Tile> queue(generateTiles(16, 16, renderParams_.samplesPerPixel, 8,
-                                      renderParams_.seed));
-
-  auto worker = [&] {
-    for (;;) {
-      auto tileOpt = queue.pop([&] { updateFunc(output); });
-      if (!tileOpt)
-        break;
-      auto &tile = *tileOpt;
-
-      std::mt19937 rng(tile.randomPrio);
-      for (int y = tile.yBegin; y < tile.yEnd; ++y) {
-        for (int x = tile.xBegin; x < tile.xEnd; ++x) {
-          output.addSamples(x, y, renderPixel(rng, x, y, tile.samples),
-                            tile.samples);
-        }
-      }
-    }
-  };
-  std::vector<std::thread> threads{static_cast<size_t>(renderParams_.maxCpus)};
-  std::generate(threads.begin(), threads.end(),
-                [&]() { return std::thread(worker); });
-  for (auto &t : threads)
-    t.join();
-
-  return output;
+  return ::renderTiled(
+      renderParams_,
+      [this](Sampler &sampler, int x, int y, const RenderParams &params) {
+        // A renderer of its own, for the tile's first bounce samples.
+        return Renderer(scene_, camera_, params)
+            .radiance(sampler, camera_.randomRay(x, y, sampler), 0, 0,
+                      Vec3(1, 1, 1));
+      },
+      updateFunc);
 }
@@ -2,8 +2,10 @@
 
 #include "Scene.h"
 #include "math/Camera.h"
+#include "math/Sampler.h"
 #include "util/ArrayOutput.h"
 #include "util/RenderParams.h"
+#include "util/TiledRender.h"
 
 #include <functional>
 #include <random>
@@ -26,21 +28,13 @@ public:
   render(const std::function<void(const ArrayOutput &)> &updateFunc) const;
 
   // Visible for testing
-  struct Tile {
-    int xBegin;
-    int xEnd;
-    int yBegin;
-    int yEnd;
-    int samples;
-    int sampleNum;
-    size_t distancePrio;
-    size_t randomPrio;
-    [[nodiscard]] constexpr auto key() const {
-      return std::tie(sampleNum, distancePrio, randomPrio);
-    }
-  };
-
-  Vec3 radiance(std::mt19937 &rng, const Ray &ray, int depth) const;
+  using Tile = ::Tile;
+
+  // The light along the ray, scaled by throughput: the weight it carries back
+  // to its pixel. bsdfPdf is the density the ray was sampled with, if it left
+  // a diffuse surface, or zero.
+  Vec3 radiance(Sampler &sampler, const Ray &ray, int depth, double bsdfPdf,
+                const Vec3 &throughput) const;
   [[nodiscard]] std::vector<Renderer::Tile>
   generateTiles(int xTileSize, int yTileSize, int numSamples,
                 int samplesPerTile, int seed) const;
@@ -49,7 +43,7 @@ public:
                 int numSamples, int samplesPerTile, int seed);
 
 private:
-  class Sampler;
+  class RadianceSampler;
 };
 
 }
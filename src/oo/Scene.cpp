@@ -1,4 +1,7 @@
 #include "Scene.h"
+#include "BvhNode.h"
+
+#include <algorithm>
 
 using oo::Primitive;
 using oo::Scene;
@@ -20,8 +23,35 @@ bool Scene::intersect(const Ray &ray, IntersectionRecord &intersection) const {
   return true;
 }
 
+bool Scene::occluded(const Ray &ray, double maxDistance) const {
+  return std::any_of(primitives_.begin(), primitives_.end(),
+                     [&](const std::unique_ptr<Primitive> &primitive) {
+                       return primitive->occluded(ray, maxDistance);
+                     });
+}
+
+Aabb Scene::bounds() const {
+  Aabb result;
+  for (auto &primitive : primitives_)
+    result = result.including(primitive->bounds());
+  return result;
+}
+
 void Scene::add(std::unique_ptr<Primitive> primitive) {
   primitives_.emplace_back(std::move(primitive));
 }
 
+void Scene::addLight(const Vec3 &centre, double radius,
+                     const MaterialSpec &material) {
+  lights_.add(centre, radius, material);
+}
+
+void Scene::buildBvh() {
+  if (primitives_.size() < 2)
+    return;
+  auto root = BvhNode::build(std::move(primitives_));
+  primitives_.clear();
+  primitives_.emplace_back(std::move(root));
+}
+
 Vec3 Scene::environment(const Ray &) const { return environment_; }
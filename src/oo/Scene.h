@@ -1,6 +1,7 @@
 #pragma once
 
 #include "oo/Primitive.h"
+#include "util/SphereLights.h"
 
 #include <memory>
 #include <vector>
@@ -10,14 +11,25 @@ namespace oo {
 class Scene : public Primitive {
   std::vector<std::unique_ptr<Primitive>> primitives_;
   Vec3 environment_;
+  SphereLights lights_;
 
 public:
   void setEnvironmentColour(const Vec3 &colour) { environment_ = colour; }
   void add(std::unique_ptr<Primitive> primitive);
+  // Lights are added as primitives too; this is just so they can be sampled.
+  void addLight(const Vec3 &centre, double radius,
+                const MaterialSpec &material);
+
+  // Replaces the primitives with a bounding volume hierarchy over them.
+  void buildBvh();
 
   [[nodiscard]] bool intersect(const Ray &ray,
                                IntersectionRecord &intersection) const override;
+  [[nodiscard]] bool occluded(const Ray &ray,
+                              double maxDistance) const override;
+  [[nodiscard]] Aabb bounds() const override;
   [[nodiscard]] Vec3 environment(const Ray &ray) const;
+  [[nodiscard]] const SphereLights &lights() const { return lights_; }
 };
 
 }
\ No newline at end of file
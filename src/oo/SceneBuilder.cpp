@@ -21,6 +21,11 @@ struct SpherePrimitive : Primitive {
     rec = IntersectionRecord{hit, material.get()};
     return true;
   }
+  [[nodiscard]] bool occluded(const Ray &ray,
+                              double maxDistance) const override {
+    return sphere.intersects(ray, maxDistance);
+  }
+  [[nodiscard]] Aabb bounds() const override { return sphere.bounds(); }
 };
 
 struct TrianglePrimitive : Primitive {
@@ -38,6 +43,11 @@ struct TrianglePrimitive : Primitive {
     intersectionRecord = IntersectionRecord{hit, material.get()};
     return true;
   }
+  [[nodiscard]] bool occluded(const Ray &ray,
+                              double maxDistance) const override {
+    return triangle.intersects(ray, maxDistance);
+  }
+  [[nodiscard]] Aabb bounds() const override { return triangle.bounds(); }
 };
 
 }
@@ -52,8 +62,11 @@ void SceneBuilder::addSphere(const Vec3 &centre, double radius,
                              const MaterialSpec &material) {
   scene_.add(std::make_unique<SpherePrimitive>(Sphere(centre, radius),
                                                Material::from(material)));
+  scene_.addLight(centre, radius, material);
 }
 
 void SceneBuilder::setEnvironmentColour(const Vec3 &colour) {
   scene_.setEnvironmentColour(colour);
 }
+
+void SceneBuilder::buildBvh() { scene_.buildBvh(); }
@@ -16,6 +16,9 @@ public:
 
   void setEnvironmentColour(const Vec3 &colour);
 
+  // Call once the scene is complete.
+  void buildBvh();
+
   [[nodiscard]] const Scene &scene() const { return scene_; }
 };
 
@@ -27,3 +27,22 @@ bool Sphere::intersect(const Ray &ray, Hit &hit) const noexcept {
   hit = Hit{t, inside, hitPosition, normal};
   return true;
 }
+
+bool Sphere::intersects(const Ray &ray, double maxDistance) const noexcept {
+  auto op = centre_ - ray.origin();
+  auto b = op.dot(ray.direction().toVec3());
+  auto determinant = b * b - op.lengthSquared() + radius_ * radius_;
+  if (determinant < 0)
+    return false;
+
+  determinant = sqrt(determinant);
+  auto minusT = b - determinant;
+  auto plusT = b + determinant;
+  auto t = minusT > Epsilon ? minusT : plusT;
+  return t >= Epsilon && t < maxDistance;
+}
+
+Aabb Sphere::bounds() const noexcept {
+  const auto offset = Vec3(radius_, radius_, radius_);
+  return Aabb(centre_ - offset, centre_ + offset);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "math/Aabb.h"
 #include "math/Hit.h"
 #include "math/Ray.h"
 #include "math/Vec3.h"
@@ -20,6 +21,11 @@ public:
   [[nodiscard]] constexpr double radius() const noexcept { return radius_; }
 
   [[nodiscard]] bool intersect(const Ray &ray, Hit &hit) const noexcept;
+  // Whether the ray hits the sphere nearer than maxDistance, without
+  // working out where.
+  [[nodiscard]] bool intersects(const Ray &ray,
+                                double maxDistance) const noexcept;
+  [[nodiscard]] Aabb bounds() const noexcept;
 };
 
 }
\ No newline at end of file
@@ -40,6 +40,31 @@ bool Triangle::intersect(const Ray &ray, Hit &hit) const noexcept {
   return true;
 }
 
+bool Triangle::intersects(const Ray &ray, double maxDistance) const noexcept {
+  auto pVec = ray.direction().cross(vVector());
+  auto det = uVector().dot(pVec);
+  if (fabs(det) < Epsilon)
+    return false;
+
+  auto invDet = 1.0 / det;
+  auto tVec = ray.origin() - vertices_[0];
+  auto u = tVec.dot(pVec) * invDet;
+  auto qVec = tVec.cross(uVector());
+  auto v = ray.direction().dot(qVec) * invDet;
+  if (Unpredictable::any((u) < 0.0, u > 1.0, (v) < 0.0, u + v > 1.0))
+    return false;
+
+  auto t = vVector().dot(qVec) * invDet;
+  return t >= Epsilon && t < maxDistance;
+}
+
+Aabb Triangle::bounds() const noexcept {
+  return Aabb()
+      .including(vertices_[0])
+      .including(vertices_[1])
+      .including(vertices_[2]);
+}
+
 Triangle::Triangle(const Triangle::Vertices &vertices)
     : vertices_(vertices), normals_{Norm3::xAxis(), Norm3::xAxis(),
                                     Norm3::xAxis()} {
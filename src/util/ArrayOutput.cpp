@@ -18,9 +18,13 @@ struct FileCloser {
   }
 };
 
+// Version 2 follows the header with the render's history: the length of the
+// scene's name and then its characters, and the number of seeds and then
+// each one.
 struct Header {
   static constexpr uint32_t Signature = 1;
-  static constexpr uint32_t Version = 1;
+  static constexpr uint32_t Version = 2;
+  static constexpr uint32_t WithoutHistory = 1;
   uint32_t signature{Signature};
   uint32_t version{Version};
   uint32_t height{};
@@ -41,6 +45,11 @@ void ArrayOutput::addSamples(int x, int y, const Vec3 &colour,
   output_[indexOf(x, y)].accumulate(colour, numSamples);
 }
 
+void ArrayOutput::addSamples(int x, int y,
+                             const SampledPixel &samples) noexcept {
+  output_[indexOf(x, y)].accumulate(samples);
+}
+
 Vec3 ArrayOutput::rawPixelAt(int x, int y) const noexcept {
   return output_[indexOf(x, y)].result();
 }
@@ -62,7 +71,27 @@ size_t ArrayOutput::totalSamples() const noexcept {
                          });
 }
 
-void ArrayOutput::save(const std::string &filename) const {
+double ArrayOutput::rmsError(const ArrayOutput &reference) const {
+  if (reference.width() != width() || reference.height() != height())
+    throw std::logic_error(
+        "Two differently-sized arrays were attempted to be compared");
+  if (output_.empty())
+    return 0;
+  double sumSquares = 0;
+  for (size_t pixelIndex = 0; pixelIndex < output_.size(); ++pixelIndex) {
+    const auto lhs = output_[pixelIndex].result();
+    const auto rhs = reference.output_[pixelIndex].result();
+    for (int component = 0; component < 3; ++component) {
+      const auto error = std::clamp(lhs[component], 0.0, 1.0)
+                         - std::clamp(rhs[component], 0.0, 1.0);
+      sumSquares += error * error;
+    }
+  }
+  return sqrt(sumSquares / static_cast<double>(output_.size() * 3));
+}
+
+void ArrayOutput::save(const std::string &filename,
+                       const RenderHistory &history) const {
   std::unique_ptr<FILE, FileCloser> out(fopen(filename.c_str(), "wb"));
   if (!out)
     throw std::runtime_error("Unable to open " + filename);
@@ -74,6 +103,12 @@ void ArrayOutput::save(const std::string &filename) const {
     }
   };
   W(header);
+  W(static_cast<uint32_t>(history.sceneName.size()));
+  for (auto c : history.sceneName)
+    W(c);
+  W(static_cast<uint32_t>(history.seeds.size()));
+  for (auto seed : history.seeds)
+    W(static_cast<int32_t>(seed));
   for (auto &&pixel : output_) {
     W(pixel.rawResult());
     W(static_cast<uint32_t>(pixel.numSamples()));
@@ -81,6 +116,12 @@ void ArrayOutput::save(const std::string &filename) const {
 }
 
 ArrayOutput ArrayOutput::load(const std::string &filename) {
+  RenderHistory history;
+  return load(filename, history);
+}
+
+ArrayOutput ArrayOutput::load(const std::string &filename,
+                              RenderHistory &history) {
   std::unique_ptr<FILE, FileCloser> in(fopen(filename.c_str(), "rb"));
   if (!in)
     throw std::runtime_error("Unable to open " + filename);
@@ -93,8 +134,28 @@ ArrayOutput ArrayOutput::load(const std::string &filename) {
   R(header);
   if (header.signature != Header::Signature)
     throw std::runtime_error("Bad file " + filename + " : bad signature");
-  if (header.version != Header::Version)
+  if (header.version != Header::Version
+      && header.version != Header::WithoutHistory)
     throw std::runtime_error("Bad file " + filename + " : bad version");
+  history = RenderHistory();
+  if (header.version != Header::WithoutHistory) {
+    // Far longer than any scene's name, so it must be a corrupt file.
+    constexpr uint32_t MaxNameLength = 4096;
+    uint32_t length;
+    R(length);
+    if (length > MaxNameLength)
+      throw std::runtime_error("Bad file " + filename + " : bad scene name");
+    history.sceneName.resize(length);
+    for (auto &c : history.sceneName)
+      R(c);
+    uint32_t numSeeds;
+    R(numSeeds);
+    for (uint32_t i = 0; i < numSeeds; ++i) {
+      int32_t seed;
+      R(seed);
+      history.seeds.emplace_back(seed);
+    }
+  }
   ArrayOutput result(header.width, header.height);
   for (int y = 0; y < result.height(); ++y) {
     for (int x = 0; x < result.width(); ++x) {
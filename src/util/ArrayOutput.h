@@ -2,10 +2,25 @@
 
 #include "SampledPixel.h"
 
+#include <algorithm>
 #include <array>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
+// What a raw image is a render of, saved along with it so a later run can
+// carry on adding samples to it.
+struct RenderHistory {
+  std::string sceneName;
+  // The seed of each run so far. Each run's samples come from its seed, so a
+  // run with a seed not among them doesn't repeat any earlier samples.
+  std::vector<int> seeds;
+
+  [[nodiscard]] bool used(int seed) const noexcept {
+    return std::find(seeds.begin(), seeds.end(), seed) != seeds.end();
+  }
+};
+
 class ArrayOutput {
   const int width_;
   const int height_;
@@ -21,6 +36,8 @@ public:
     output_.resize(width * height);
   }
 
+  // Takes a sample for each pixel in turn from the source. Any pixels left
+  // when it runs out have none.
   template <typename Source>
   ArrayOutput(int width, int height, Source &&source)
       : width_(width), height_(height) {
@@ -31,14 +48,13 @@ public:
         throw std::logic_error("Too many samples in input");
       output_[index++].accumulate(sample, 1);
     }
-    if (index != width * height)
-      throw std::logic_error("Too few samples in input");
   }
 
   [[nodiscard]] constexpr int height() const noexcept { return height_; }
   [[nodiscard]] constexpr int width() const noexcept { return width_; }
 
   void addSamples(int x, int y, const Vec3 &colour, int numSamples) noexcept;
+  void addSamples(int x, int y, const SampledPixel &samples) noexcept;
 
   [[nodiscard]] Vec3 rawPixelAt(int x, int y) const noexcept;
 
@@ -49,6 +65,14 @@ public:
 
   [[nodiscard]] size_t totalSamples() const noexcept;
 
-  void save(const std::string &filename) const;
+  // The root-mean-square difference from the reference over every component
+  // of every pixel, each clamped to [0, 1] as it would be displayed.
+  [[nodiscard]] double rmsError(const ArrayOutput &reference) const;
+
+  void save(const std::string &filename,
+            const RenderHistory &history = RenderHistory()) const;
   [[nodiscard]] static ArrayOutput load(const std::string &filename);
+  // Files saved before histories were kept have an empty one.
+  [[nodiscard]] static ArrayOutput load(const std::string &filename,
+                                        RenderHistory &history);
 };
@@ -0,0 +1,58 @@
+#include "AsyncSaver.h"
+
+AsyncSaver::AsyncSaver(std::function<void(const ArrayOutput &)> save)
+    : save_(std::move(save)), writer_([this] { write(); }) {}
+
+AsyncSaver::~AsyncSaver() { stop(); }
+
+void AsyncSaver::write() {
+  std::unique_lock lock(mutex_);
+  for (;;) {
+    posted_.wait(lock, [this] { return pending_ || stopping_; });
+    if (stopping_)
+      return;
+    auto snapshot = std::move(pending_);
+    pending_.reset();
+    // Nobody waits on the lock while the snapshot is saved.
+    lock.unlock();
+    save_(*snapshot);
+    lock.lock();
+    numSaved_++;
+  }
+}
+
+void AsyncSaver::post(std::shared_ptr<const ArrayOutput> snapshot) {
+  {
+    std::lock_guard lock(mutex_);
+    if (stopping_)
+      return;
+    if (pending_)
+      numDropped_++;
+    pending_ = std::move(snapshot);
+  }
+  posted_.notify_one();
+}
+
+void AsyncSaver::stop() {
+  {
+    std::lock_guard lock(mutex_);
+    if (stopping_)
+      return;
+    stopping_ = true;
+    if (pending_)
+      numDropped_++;
+    pending_.reset();
+  }
+  posted_.notify_one();
+  writer_.join();
+}
+
+size_t AsyncSaver::numSaved() {
+  std::lock_guard lock(mutex_);
+  return numSaved_;
+}
+
+size_t AsyncSaver::numDropped() {
+  std::lock_guard lock(mutex_);
+  return numDropped_;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ArrayOutput.h"
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Saves snapshots of a render on a thread of its own, so whoever posts one
+// never waits for it to be encoded or written out. Only the newest snapshot
+// waits to be saved: if another is posted before the writer gets to it, the
+// older one is stale and is dropped.
+class AsyncSaver {
+  std::function<void(const ArrayOutput &)> save_;
+  std::mutex mutex_;
+  std::condition_variable posted_;
+  std::shared_ptr<const ArrayOutput> pending_;
+  bool stopping_{false};
+  size_t numSaved_{};
+  size_t numDropped_{};
+  std::thread writer_;
+
+  void write();
+
+public:
+  explicit AsyncSaver(std::function<void(const ArrayOutput &)> save);
+  ~AsyncSaver();
+  AsyncSaver(const AsyncSaver &) = delete;
+  AsyncSaver &operator=(const AsyncSaver &) = delete;
+
+  void post(std::shared_ptr<const ArrayOutput> snapshot);
+
+  // Waits for any save in progress, drops any still pending, and stops the
+  // writer. Called on destruction if not before.
+  void stop();
+
+  [[nodiscard]] size_t numSaved();
+  [[nodiscard]] size_t numDropped();
+};
@@ -0,0 +1,41 @@
+#include "CacheMissCounter.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+
+CacheMissCounter::CacheMissCounter() noexcept {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  fd_ = static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, 0 /* this thread */, -1, -1, 0));
+}
+
+CacheMissCounter::~CacheMissCounter() {
+  if (fd_ >= 0)
+    close(fd_);
+}
+
+std::optional<uint64_t> CacheMissCounter::count() const noexcept {
+  uint64_t count{};
+  if (fd_ < 0 || read(fd_, &count, sizeof(count)) != sizeof(count))
+    return {};
+  return count;
+}
+
+#else
+
+CacheMissCounter::CacheMissCounter() noexcept = default;
+CacheMissCounter::~CacheMissCounter() = default;
+std::optional<uint64_t> CacheMissCounter::count() const noexcept { return {}; }
+
+#endif
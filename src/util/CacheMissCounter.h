@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+// Counts the hardware cache misses of the calling thread while it lives,
+// using the Linux perf events interface. Where that's unavailable (another
+// OS, no PMU under a VM, or perf_event_paranoid forbids it) count() is empty.
+class CacheMissCounter {
+  int fd_{-1};
+
+public:
+  CacheMissCounter() noexcept;
+  ~CacheMissCounter();
+  CacheMissCounter(const CacheMissCounter &) = delete;
+  CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+
+  [[nodiscard]] std::optional<uint64_t> count() const noexcept;
+};
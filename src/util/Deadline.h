@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+// When a render with a time budget has to stop, if it has one. Renders
+// check it as they go: once it has passed, no more passes or tiles start,
+// and passes in flight leave out the rows they haven't got to, so the render
+// finishes soon after with whatever it has.
+class Deadline {
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start_;
+  Clock::duration budget_{};
+  bool set_{false};
+
+public:
+  // Never passes.
+  Deadline() noexcept = default;
+  explicit Deadline(std::chrono::duration<double> budget) noexcept
+      : start_(Clock::now()),
+        budget_(std::chrono::duration_cast<Clock::duration>(budget)),
+        set_(true) {}
+
+  [[nodiscard]] explicit operator bool() const noexcept { return set_; }
+  [[nodiscard]] bool passed() const noexcept {
+    return set_ && Clock::now() - start_ >= budget_;
+  }
+
+  // For reporting progress through the budget.
+  [[nodiscard]] size_t budgetMs() const noexcept {
+    return static_cast<size_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(budget_)
+            .count());
+  }
+  [[nodiscard]] size_t elapsedMs() const noexcept {
+    return static_cast<size_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now()
+                                                              - start_)
+            .count());
+  }
+};
+
+// Calls rowFunc(row) for row = 0, step, 2 * step... below end: the rows, or
+// blocks of rows, of a pass. Those not started by the deadline are left out.
+template <typename Index, typename RowFunc>
+void forEachRow(const Deadline &deadline, Index end, Index step,
+                RowFunc &&rowFunc) {
+  for (Index row = 0; row < end && !deadline.passed(); row += step)
+    rowFunc(row);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Deadline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Runs renderPass(passIndex) for each of numPasses passes on up to maxThreads
+// threads. Each thread starts on the next pass the moment it finishes one.
+// Results come back through a completion queue to the calling thread, which
+// hands each to onDone(result) as soon as it arrives; nothing polls or
+// sleeps. The first exception thrown by a pass stops any more starting, and
+// is rethrown once the passes in flight have finished. No passes start once
+// the deadline has passed.
+template <typename RenderPass, typename OnDone>
+void runPasses(int numPasses, int maxThreads, RenderPass &&renderPass,
+               OnDone &&onDone, const Deadline &deadline = Deadline()) {
+  using Result = std::invoke_result_t<RenderPass &, int>;
+  std::mutex mutex;
+  std::condition_variable completed;
+  std::deque<Result> results;
+  std::exception_ptr error;
+  std::atomic<int> nextPass{0};
+  std::atomic<bool> stopping{false};
+  const auto numThreads = std::clamp(maxThreads, 1, std::max(numPasses, 1));
+  int numWorking = numThreads;
+
+  auto worker = [&] {
+    for (int pass = 0; !stopping && !deadline.passed()
+                       && (pass = nextPass++) < numPasses;) {
+      try {
+        auto result = renderPass(pass);
+        std::lock_guard lock(mutex);
+        results.emplace_back(std::move(result));
+      } catch (...) {
+        std::lock_guard lock(mutex);
+        if (!error)
+          error = std::current_exception();
+        stopping = true;
+      }
+      completed.notify_one();
+    }
+    {
+      std::lock_guard lock(mutex);
+      numWorking--;
+    }
+    completed.notify_one();
+  };
+
+  std::vector<std::thread> threads;
+  // Stops and joins the workers however this function is left.
+  struct Joiner {
+    std::vector<std::thread> &threads;
+    std::atomic<bool> &stopping;
+    ~Joiner() {
+      stopping = true;
+      for (auto &thread : threads)
+        thread.join();
+    }
+  } joiner{threads, stopping};
+  for (int thread = 0; thread < numThreads; ++thread)
+    threads.emplace_back(worker);
+
+  std::unique_lock lock(mutex);
+  for (;;) {
+    completed.wait(lock,
+                   [&] { return !results.empty() || error || !numWorking; });
+    if (error || results.empty())
+      break;
+    auto result = std::move(results.front());
+    results.pop_front();
+    lock.unlock();
+    onDone(std::move(result));
+    lock.lock();
+  }
+  if (error) {
+    lock.unlock();
+    // Let the passes in flight finish before reporting the failure.
+    for (auto &thread : threads)
+      thread.join();
+    threads.clear();
+    std::rethrow_exception(error);
+  }
+}
@@ -1 +1,7 @@
 #include "RenderParams.h"
+
+#include <limits>
+
+int RenderParams::numPasses() const noexcept {
+  return deadline ? std::numeric_limits<int>::max() : samplesPerPixel;
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "Deadline.h"
+#include "math/Sampler.h"
+
 struct RenderParams {
   int width{1920};
   int height{1080};
@@ -10,4 +13,18 @@ struct RenderParams {
   int firstBounceUSamples{4};
   int firstBounceVSamples{4};
   int seed{0};
+  bool tiled{false};
+  int packetSize{1};
+  bool wavefront{false};
+  bool sortRays{false};
+  SamplerKind sampler{SamplerKind::Random};
+  bool nextEvent{false};
+  int rouletteDepth{0};
+  int raysPerPixel{0};
+  double adaptiveError{0};
+  Deadline deadline;
+
+  // How many passes of a sample per pixel to render: samplesPerPixel, or
+  // with a deadline as many as there's time for.
+  [[nodiscard]] int numPasses() const noexcept;
 };
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Deadline.h"
+#include "Progressifier.h"
+
+#include <cstddef>
+
+// Reports how far a render has got: through its time budget if it has one,
+// however much work that turns out to be, or else through its numWork units
+// of work.
+class RenderProgress {
+  const Deadline &deadline_;
+  Progressifier progressifier_;
+
+public:
+  RenderProgress(const Deadline &deadline, size_t numWork) noexcept
+      : deadline_(deadline),
+        progressifier_(deadline ? deadline.budgetMs() : numWork) {}
+
+  void update(size_t numDone) noexcept {
+    progressifier_.update(deadline_ ? deadline_.elapsedMs() : numDone);
+  }
+};
@@ -0,0 +1,21 @@
+#include "RussianRoulette.h"
+
+#include <algorithm>
+
+std::optional<Vec3> russianRoulette(Sampler &sampler, const Vec3 &throughput,
+                                    int depth,
+                                    const RenderParams &renderParams) noexcept {
+  if (renderParams.rouletteDepth <= 0 || depth < renderParams.rouletteDepth)
+    return throughput;
+  // Every path past the first bounce carries its share of the first bounce's
+  // samples. That doesn't make it dim, so it's left out of the chance.
+  const auto firstBounceSamples =
+      renderParams.firstBounceUSamples * renderParams.firstBounceVSamples;
+  const auto brightest =
+      std::max({throughput.x(), throughput.y(), throughput.z()})
+      * firstBounceSamples;
+  const auto survival = std::min(brightest, 1.0);
+  if (sampler.next1D() >= survival)
+    return {};
+  return throughput / survival;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "RenderParams.h"
+#include "math/Sampler.h"
+#include "math/Vec3.h"
+
+#include <optional>
+
+// Russian roulette: from renderParams.rouletteDepth bounces on, a path only
+// carries on with a chance set by its throughput (the weight its radiance
+// carries back to its pixel), and is scaled up by that chance if it does.
+// Dim paths end early, yet on average every path contributes what it would
+// have. A depth of zero turns it off.
+//
+// Returns the throughput a path about to trace its ray at depth carries on
+// with, or nothing if it ends there. Draws from the sampler only if roulette
+// applies at this depth, whatever the throughput, so the samples of a pixel
+// stay in step with each other.
+[[nodiscard]] std::optional<Vec3>
+russianRoulette(Sampler &sampler, const Vec3 &throughput, int depth,
+                const RenderParams &renderParams) noexcept;
@@ -0,0 +1,44 @@
+#include "SampleMoments.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+double brightness(const Vec3 &colour) noexcept {
+  return (colour.x() + colour.y() + colour.z()) / 3;
+}
+
+}
+
+void SampleMoments::add(const Vec3 &sample) noexcept {
+  samples_.accumulate(sample, 1);
+  colourSquares_ += sample * sample;
+}
+
+void SampleMoments::accumulate(const SampleMoments &other) noexcept {
+  samples_.accumulate(other.samples_);
+  colourSquares_ += other.colourSquares_;
+}
+
+Vec3 SampleMoments::variance() const noexcept {
+  const auto numSamples = samples_.numSamples();
+  if (numSamples < 2)
+    return Vec3();
+  const auto n = static_cast<double>(numSamples);
+  const auto colour = samples_.rawResult();
+  const auto variance = (colourSquares_ - colour * colour / n) / (n - 1);
+  // Rounding can take it just below zero when the samples all agree.
+  return Vec3(std::max(variance.x(), 0.0), std::max(variance.y(), 0.0),
+              std::max(variance.z(), 0.0));
+}
+
+double SampleMoments::relativeError() const noexcept {
+  const auto numSamples = samples_.numSamples();
+  if (numSamples == 0)
+    return 0;
+  const auto standardError =
+      std::sqrt(brightness(variance()) / static_cast<double>(numSamples));
+  return standardError
+         / std::sqrt(std::max(brightness(samples_.result()), NearBlack));
+}
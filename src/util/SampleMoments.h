@@ -0,0 +1,35 @@
+#pragma once
+
+#include "SampledPixel.h"
+#include "math/Vec3.h"
+
+// The samples of a pixel so far, along with the sum of their squares, for a
+// running estimate of how noisy they are. Only sampling that follows the
+// noise needs the squares, so images keep just the SampledPixel.
+class SampleMoments {
+  SampledPixel samples_;
+  Vec3 colourSquares_;
+
+public:
+  SampleMoments() noexcept = default;
+  SampleMoments(const SampledPixel &samples,
+                const Vec3 &colourSquares) noexcept
+      : samples_(samples), colourSquares_(colourSquares) {}
+
+  void add(const Vec3 &sample) noexcept;
+  void accumulate(const SampleMoments &other) noexcept;
+  [[nodiscard]] const SampledPixel &samples() const noexcept {
+    return samples_;
+  }
+  [[nodiscard]] Vec3 rawSquares() const noexcept { return colourSquares_; }
+
+  // The variance of a single sample, estimated from those so far; nothing
+  // until there are two.
+  [[nodiscard]] Vec3 variance() const noexcept;
+  // The standard error of the mean's brightness, relative to the square root
+  // of that brightness, as with the noise in counting photons: relative to
+  // the brightness itself, the darkest corners would soak up every sample
+  // going. Pixels darker than NearBlack count as that bright.
+  [[nodiscard]] double relativeError() const noexcept;
+  static constexpr double NearBlack = 0.01;
+};
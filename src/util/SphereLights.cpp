@@ -0,0 +1,66 @@
+#include "SphereLights.h"
+
+#include <algorithm>
+
+namespace {
+
+// Distances to the same point found by different intersection code agree to
+// well within this, relatively.
+constexpr double SameDistance = 0.000001;
+
+bool closeTo(double distance, double expected) noexcept {
+  return fabs(distance - expected) <= SameDistance * std::max(expected, 1.0);
+}
+
+}
+
+void SphereLights::add(const Vec3 &centre, double radius,
+                       const MaterialSpec &material) {
+  if (material.emission == Vec3())
+    return;
+  lights_.emplace_back(Light{centre, radius, material.emission});
+}
+
+std::optional<double> SphereLights::distanceTo(const Light &light,
+                                              const Ray &ray) noexcept {
+  const auto op = light.centre - ray.origin();
+  const auto b = op.dot(ray.direction().toVec3());
+  const auto radiusSquared = light.radius * light.radius;
+  const auto determinant = b * b - op.lengthSquared() + radiusSquared;
+  // Rays sampled right at the sphere's outline can miss it by a rounding
+  // error.
+  if (determinant < -SameDistance * radiusSquared)
+    return {};
+  return b - sqrt(std::max(determinant, 0.0));
+}
+
+double SphereLights::Sample::shadowDistance() const noexcept {
+  return distance - SameDistance * std::max(distance, 1.0);
+}
+
+std::optional<SphereLights::Sample>
+SphereLights::sample(const Vec3 &from, double pick, double u, double v) const
+    noexcept {
+  const auto numLights = lights_.size();
+  const auto index =
+      std::min(static_cast<size_t>(pick * numLights), numLights - 1);
+  const auto &light = lights_[index];
+  const auto pdf = sphereSamplePdf(from, light.centre, light.radius);
+  if (pdf <= 0)
+    return {};
+  const auto direction = sphereSample(from, light.centre, light.radius, u, v);
+  const auto distance = distanceTo(light, Ray(from, direction));
+  if (!distance)
+    return {};
+  return Sample{direction, *distance, light.emission, pdf / numLights};
+}
+
+double SphereLights::pdf(const Ray &ray, double hitDistance) const noexcept {
+  for (const auto &light : lights_) {
+    const auto distance = distanceTo(light, ray);
+    if (distance && closeTo(*distance, hitDistance))
+      return sphereSamplePdf(ray.origin(), light.centre, light.radius)
+             / lights_.size();
+  }
+  return 0;
+}
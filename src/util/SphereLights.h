@@ -0,0 +1,101 @@
+#pragma once
+
+#include "MaterialSpec.h"
+#include "math/Hit.h"
+#include "math/Ray.h"
+#include "math/Sampler.h"
+#include "math/Samples.h"
+#include "math/Vec3.h"
+
+#include <cmath>
+#include <optional>
+#include <vector>
+
+// The emissive spheres in a scene, so a path leaving a diffuse surface can aim
+// at them directly (next event estimation) rather than waiting to hit one by
+// chance. Both ways of finding a light are kept and weighted against each
+// other with the power heuristic (multiple importance sampling), so neither
+// counts its light twice. Light from anything else, such as emissive
+// triangles, is only ever found by chance.
+class SphereLights {
+  struct Light {
+    Vec3 centre;
+    double radius;
+    Vec3 emission;
+  };
+  std::vector<Light> lights_;
+
+  // To the near side of the light, if the ray hits it.
+  [[nodiscard]] static std::optional<double>
+  distanceTo(const Light &light, const Ray &ray) noexcept;
+
+public:
+  // Only adds the sphere if its material emits anything.
+  void add(const Vec3 &centre, double radius, const MaterialSpec &material);
+
+  [[nodiscard]] bool empty() const noexcept { return lights_.empty(); }
+  [[nodiscard]] size_t size() const noexcept { return lights_.size(); }
+
+  struct Sample {
+    Norm3 direction;
+    // Along the direction, to the near side of the light.
+    double distance;
+    Vec3 emission;
+    // Per steradian, including the chance of picking this light.
+    double pdf;
+
+    // How far a shadow ray must get unblocked to reach the light: just short
+    // of distance, so the light itself doesn't count.
+    [[nodiscard]] double shadowDistance() const noexcept;
+  };
+
+  // Picks a light with pick, then a direction towards it with u and v,
+  // uniformly over the solid angle it subtends from from. Nothing if from is
+  // inside the light.
+  [[nodiscard]] std::optional<Sample> sample(const Vec3 &from, double pick,
+                                             double u, double v) const
+      noexcept;
+
+  // The density with which sample() from the ray's origin would have chosen
+  // its direction, given that the first thing it hits, at hitDistance, is the
+  // surface of one of the lights. Zero if it isn't a light.
+  [[nodiscard]] double pdf(const Ray &ray, double hitDistance) const noexcept;
+
+  // The weight for emission found at hitDistance along a ray that left a
+  // diffuse surface with density bsdfPdf. A bsdfPdf of zero means the ray
+  // couldn't have been aimed at a light (it's a camera ray, or was reflected),
+  // so the emission counts in full.
+  [[nodiscard]] double emissionWeight(const Ray &ray, double hitDistance,
+                                      double bsdfPdf) const noexcept {
+    if (bsdfPdf <= 0)
+      return 1;
+    return powerHeuristic(bsdfPdf, pdf(ray, hitDistance));
+  }
+
+  // The radiance reaching a diffuse surface straight from the lights, to be
+  // scaled by its colour. Draws the light and direction from the sampler's
+  // next three dimensions, and weights the result against finding the light
+  // by cosine-weighted hemisphere sampling. occluded(ray, maxDistance) says
+  // whether anything lies along a shadow ray nearer than maxDistance.
+  template <typename Occluded>
+  [[nodiscard]] Vec3 sampleDirect(Sampler &sampler, const Hit &hit,
+                                  Occluded &&occluded) const {
+    if (lights_.empty())
+      return Vec3();
+    const auto pick = sampler.next1D();
+    const auto [u, v] = sampler.next2D();
+    const auto lightSample = sample(hit.position, pick, u, v);
+    if (!lightSample)
+      return Vec3();
+    const auto bsdfPdf =
+        hemisphereSamplePdf(hit.normal, lightSample->direction);
+    if (bsdfPdf <= 0)
+      return Vec3();
+    if (occluded(Ray(hit.position, lightSample->direction),
+                 lightSample->shadowDistance()))
+      return Vec3();
+    return lightSample->emission
+           * (bsdfPdf / lightSample->pdf
+              * powerHeuristic(lightSample->pdf, bsdfPdf));
+  }
+};
@@ -0,0 +1,49 @@
+#include "SplitBudget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+FirstBounceSplit chooseSplit(double unsplitVariance, double pilotVariance,
+                             int maxSplits) noexcept {
+  // unsplit = A + B, pilot = A + B / k.
+  const double k = PilotSplit.numSplits();
+  const auto b = (unsplitVariance - pilotVariance) * k / (k - 1);
+  const auto a = unsplitVariance - b;
+  maxSplits = std::max(maxSplits, 1);
+  // Splitting can't help if there's no variance for it to reduce; and if all
+  // the variance is after the first hit, split as much as allowed.
+  double splits = 1;
+  if (b > 0)
+    splits = a > 0 ? std::clamp(std::sqrt(b / a), 1.0,
+                                static_cast<double>(maxSplits))
+                   : maxSplits;
+  const auto uSamples =
+      std::max(static_cast<int>(std::lround(std::sqrt(splits))), 1);
+  const auto vSamples = std::clamp(
+      static_cast<int>(std::lround(splits / uSamples)), 1,
+      std::max(maxSplits / uSamples, 1));
+  return FirstBounceSplit{uSamples, vSamples};
+}
+
+void checkRayBudget(int raysPerPixel) {
+  // The least split sample is a camera ray and one ray split off it.
+  const auto minRays = pilotRays() + FirstBounceSplit().raysPerSample();
+  if (raysPerPixel < minRays)
+    throw std::runtime_error("A ray budget needs at least "
+                             + std::to_string(minRays) + " rays per pixel");
+}
+
+int budgetedSamples(int raysPerPixel, const FirstBounceSplit &split) noexcept {
+  return std::max(raysPerPixel - pilotRays(), 0) / split.raysPerSample();
+}
+
+void reportSplit(const FirstBounceSplit &split, int raysPerPixel) {
+  std::cout << "Spent " << raysPerPixel << " rays per pixel on "
+            << PilotSamples << " pilot samples unsplit and " << PilotSamples
+            << " split " << PilotSplit.numSplits() << " ways, then "
+            << budgetedSamples(raysPerPixel, split) << " samples split "
+            << split.numSplits() << " ways at the first bounce\n";
+}
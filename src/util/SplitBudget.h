@@ -0,0 +1,60 @@
+#pragma once
+
+#include "RenderParams.h"
+
+// Splitting paths at the first bounce, rather than taking more camera
+// samples, when a pixel's cost is counted in rays: each camera sample costs
+// its camera ray, plus a ray for every path split off where it first hits.
+//
+// With s splits a camera sample's variance is A + B / s, where A comes from
+// what the camera ray hits and B from the paths leaving there. A budget of R
+// rays per pixel buys R / (1 + s) camera samples, for a pixel variance of
+// (1 + s)(A + B / s) / R, which is smallest at s = sqrt(B / A). A and B are
+// found by rendering a few pilot samples of each pixel unsplit and split
+// PilotSplit ways, and the budget left over goes to the best split.
+struct FirstBounceSplit {
+  int uSamples{1};
+  int vSamples{1};
+
+  [[nodiscard]] constexpr int numSplits() const noexcept {
+    return uSamples * vSamples;
+  }
+  [[nodiscard]] constexpr int raysPerSample() const noexcept {
+    return 1 + numSplits();
+  }
+  // renderParams, with this split at the first bounce.
+  [[nodiscard]] RenderParams applyTo(RenderParams renderParams) const noexcept {
+    renderParams.firstBounceUSamples = uSamples;
+    renderParams.firstBounceVSamples = vSamples;
+    return renderParams;
+  }
+};
+
+constexpr FirstBounceSplit PilotSplit{4, 4};
+// The number of pilot samples per pixel taken unsplit, and then again split
+// PilotSplit ways.
+constexpr int PilotSamples = 2;
+
+[[nodiscard]] constexpr int pilotRays() noexcept {
+  return PilotSamples
+         * (FirstBounceSplit().raysPerSample() + PilotSplit.raysPerSample());
+}
+
+// Throws unless the budget covers the pilot samples and a split sample after
+// them: any less, and there'd be nothing left to spend as the pilot suggests.
+void checkRayBudget(int raysPerPixel);
+
+// The split that makes the most of the rays, given the variance of a camera
+// sample measured unsplit and split PilotSplit ways: a grid as near square as
+// may be, of no more than maxSplits.
+[[nodiscard]] FirstBounceSplit chooseSplit(double unsplitVariance,
+                                           double pilotVariance,
+                                           int maxSplits) noexcept;
+
+// How many camera samples per pixel the rays left after the pilot samples buy
+// at the given split.
+[[nodiscard]] int budgetedSamples(int raysPerPixel,
+                                  const FirstBounceSplit &split) noexcept;
+
+// Prints how the budget was spent.
+void reportSplit(const FirstBounceSplit &split, int raysPerPixel);
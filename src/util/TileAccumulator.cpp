@@ -0,0 +1,95 @@
+#include "TileAccumulator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+TileAccumulator::TileAccumulator(int width, int height, int shardWidth,
+                                 int shardHeight, bool trackNoise)
+    : width_(width), height_(height), shardWidth_(shardWidth),
+      shardHeight_(shardHeight),
+      shardsAcross_((width + shardWidth - 1) / shardWidth),
+      pixels_(static_cast<size_t>(width * height)),
+      squares_(trackNoise ? static_cast<size_t>(width * height) : 0),
+      shards_(std::make_unique<Shard[]>(static_cast<size_t>(
+          shardsAcross_ * ((height + shardHeight - 1) / shardHeight)))) {}
+
+namespace {
+
+void checkFits(int xBegin, int xEnd, int yBegin, int yEnd, int width,
+               int height, size_t numPixels) {
+  if (xBegin < 0 || xEnd > width || yBegin < 0 || yEnd > height
+      || numPixels != static_cast<size_t>((xEnd - xBegin) * (yEnd - yBegin)))
+    throw std::logic_error("Tile doesn't fit the image");
+}
+
+}
+
+void TileAccumulator::commit(int xBegin, int xEnd, int yBegin, int yEnd,
+                             const std::vector<Vec3> &colours,
+                             int numSamples) {
+  if (!squares_.empty())
+    throw std::logic_error("Tracking the noise needs the samples' squares");
+  checkFits(xBegin, xEnd, yBegin, yEnd, width_, height_, colours.size());
+  // Shards are always locked in the same order, so tiles that overlap more
+  // than one can't deadlock.
+  std::vector<std::unique_lock<std::mutex>> locks;
+  forEachShard(xBegin, xEnd, yBegin, yEnd,
+               [&](Shard &shard) { locks.emplace_back(shard.mutex); });
+  auto colour = colours.begin();
+  for (int y = yBegin; y < yEnd; ++y)
+    for (int x = xBegin; x < xEnd; ++x)
+      pixels_[x + y * width_].accumulate(*colour++, numSamples);
+}
+
+void TileAccumulator::commit(int xBegin, int xEnd, int yBegin, int yEnd,
+                             const std::vector<SampleMoments> &pixels) {
+  checkFits(xBegin, xEnd, yBegin, yEnd, width_, height_, pixels.size());
+  std::vector<std::unique_lock<std::mutex>> locks;
+  forEachShard(xBegin, xEnd, yBegin, yEnd,
+               [&](Shard &shard) { locks.emplace_back(shard.mutex); });
+  auto pixel = pixels.begin();
+  for (int y = yBegin; y < yEnd; ++y) {
+    for (int x = xBegin; x < xEnd; ++x, ++pixel) {
+      pixels_[x + y * width_].accumulate(pixel->samples());
+      if (!squares_.empty())
+        squares_[x + y * width_] += pixel->rawSquares();
+    }
+  }
+}
+
+double TileAccumulator::relativeError(int xBegin, int xEnd, int yBegin,
+                                      int yEnd) const {
+  if (squares_.empty())
+    throw std::logic_error("The noise isn't being tracked");
+  if (xBegin < 0 || xEnd > width_ || yBegin < 0 || yEnd > height_
+      || xBegin >= xEnd || yBegin >= yEnd)
+    throw std::logic_error("Tile doesn't fit the image");
+  std::vector<std::unique_lock<std::mutex>> locks;
+  forEachShard(xBegin, xEnd, yBegin, yEnd,
+               [&](Shard &shard) { locks.emplace_back(shard.mutex); });
+  double total = 0;
+  for (int y = yBegin; y < yEnd; ++y)
+    for (int x = xBegin; x < xEnd; ++x)
+      total += SampleMoments(pixels_[x + y * width_], squares_[x + y * width_])
+                   .relativeError();
+  return total / ((xEnd - xBegin) * (yEnd - yBegin));
+}
+
+ArrayOutput TileAccumulator::snapshot() const {
+  ArrayOutput output(width_, height_);
+  for (int shardY = 0; shardY < height_; shardY += shardHeight_) {
+    for (int shardX = 0; shardX < width_; shardX += shardWidth_) {
+      const auto xEnd = std::min(shardX + shardWidth_, width_);
+      const auto yEnd = std::min(shardY + shardHeight_, height_);
+      const auto shardIndex =
+          shardX / shardWidth_ + shardY / shardHeight_ * shardsAcross_;
+      std::lock_guard lock(shards_[shardIndex].mutex);
+      for (int y = shardY; y < yEnd; ++y) {
+        for (int x = shardX; x < xEnd; ++x) {
+          output.addSamples(x, y, pixels_[x + y * width_]);
+        }
+      }
+    }
+  }
+  return output;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ArrayOutput.h"
+#include "SampleMoments.h"
+#include "SampledPixel.h"
+#include "math/Vec3.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// An image built up from tiles rendered on several threads at once. Each
+// thread renders a tile into a buffer of its own and then commits it in one
+// go. The image is split into shards, each with its own lock, so commits to
+// different parts of the image never contend; and as a commit holds its
+// shards' locks throughout, a snapshot never sees half a tile.
+class TileAccumulator {
+  // On its own cache line, so neighbouring shards' locks don't share one.
+  struct alignas(64) Shard {
+    std::mutex mutex;
+  };
+
+  int width_;
+  int height_;
+  int shardWidth_;
+  int shardHeight_;
+  int shardsAcross_;
+  std::vector<SampledPixel> pixels_;
+  // The sum of each pixel's squared samples, if the noise is tracked.
+  std::vector<Vec3> squares_;
+  std::unique_ptr<Shard[]> shards_;
+
+  // Calls func(shard) for each shard the rectangle overlaps, in order.
+  template <typename Func>
+  void forEachShard(int xBegin, int xEnd, int yBegin, int yEnd,
+                    Func &&func) const {
+    for (int y = yBegin / shardHeight_; y <= (yEnd - 1) / shardHeight_; ++y)
+      for (int x = xBegin / shardWidth_; x <= (xEnd - 1) / shardWidth_; ++x)
+        func(shards_[x + y * shardsAcross_]);
+  }
+
+public:
+  // With trackNoise, the squares of the samples are kept too, for
+  // relativeError().
+  TileAccumulator(int width, int height, int shardWidth, int shardHeight,
+                  bool trackNoise = false);
+
+  // Adds the summed colours of numSamples samples for each pixel of the
+  // rectangle [xBegin, xEnd) x [yBegin, yEnd), in row-major order. Without
+  // their squares, this can't be used when tracking the noise.
+  void commit(int xBegin, int xEnd, int yBegin, int yEnd,
+              const std::vector<Vec3> &colours, int numSamples);
+  // Adds the samples of each pixel of the rectangle, in row-major order.
+  void commit(int xBegin, int xEnd, int yBegin, int yEnd,
+              const std::vector<SampleMoments> &pixels);
+
+  // The mean over the pixels of the rectangle of their relative error so far
+  // (see SampleMoments). Only when tracking the noise.
+  [[nodiscard]] double relativeError(int xBegin, int xEnd, int yBegin,
+                                     int yEnd) const;
+
+  // A copy of the image so far, made up of whole tiles.
+  [[nodiscard]] ArrayOutput snapshot() const;
+};
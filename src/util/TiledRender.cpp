@@ -0,0 +1,41 @@
+#include "TiledRender.h"
+
+#include <iostream>
+
+std::vector<Tile> generateTiles(int width, int height, int xTileSize,
+                                int yTileSize, int numSamples,
+                                int samplesPerTile, int seed) {
+  std::mt19937 rng(seed);
+  std::vector<Tile> tiles;
+  for (int y = 0; y < height; y += yTileSize) {
+    int yBegin = y;
+    int yEnd = std::min(y + yTileSize, height);
+    for (int x = 0; x < width; x += xTileSize) {
+      int xBegin = x;
+      int xEnd = std::min(x + xTileSize, width);
+      int midX = (xEnd + xBegin) / 2;
+      int midY = (yEnd + yBegin) / 2;
+      int centreX = width / 2;
+      int centreY = height / 2;
+      size_t distanceSqr = (midX - centreX) * (midX - centreX)
+                           + (midY - centreY) * (midY - centreY);
+      for (int s = 0; s < numSamples; s += samplesPerTile) {
+        int nSamples = std::min(s + samplesPerTile, numSamples) - s;
+        tiles.emplace_back(
+            Tile{xBegin, xEnd, yBegin, yEnd, nSamples, s, distanceSqr, rng()});
+      }
+    }
+  }
+  std::sort(tiles.begin(), tiles.end(), [](const Tile &lhs, const Tile &rhs) {
+    return lhs.key() > rhs.key();
+  });
+  return tiles;
+}
+
+void reportAdaptiveSampling(int numRounds, size_t numConverged,
+                            size_t numTiles, double samplesPerPixel) {
+  std::cout << "Sampled adaptively in " << numRounds << " rounds: "
+            << numConverged << " of " << numTiles
+            << " tiles converged, at " << samplesPerPixel
+            << " samples per pixel on average\n";
+}
@@ -0,0 +1,381 @@
+#pragma once
+
+#include "ArrayOutput.h"
+#include "RenderParams.h"
+#include "RenderProgress.h"
+#include "SplitBudget.h"
+#include "TileAccumulator.h"
+#include "WorkStealingQueue.h"
+#include "math/Sampler.h"
+#include "math/Vec3.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// A block of pixels and some of their samples: a unit of work for a tiled
+// render.
+struct Tile {
+  int xBegin;
+  int xEnd;
+  int yBegin;
+  int yEnd;
+  int samples;
+  int sampleNum;
+  size_t distancePrio;
+  size_t randomPrio;
+  [[nodiscard]] constexpr auto key() const {
+    return std::tie(sampleNum, distancePrio, randomPrio);
+  }
+};
+
+// Splits the image into tiles of up to samplesPerTile samples each, most
+// important last: earlier samples first, and within those the tiles nearest
+// the centre.
+[[nodiscard]] std::vector<Tile> generateTiles(int width, int height,
+                                              int xTileSize, int yTileSize,
+                                              int numSamples,
+                                              int samplesPerTile, int seed);
+
+// Prints how adaptive sampling went.
+void reportAdaptiveSampling(int numRounds, size_t numConverged,
+                            size_t numTiles, double samplesPerPixel);
+
+// Calls renderTile(tile) for each tile on up to maxCpus threads, until the
+// deadline passes. After each, onDone(number done so far) is called by
+// whichever thread finished it, unless another is already doing so: nobody
+// waits for it.
+template <typename RenderTile, typename OnDone>
+void forEachTile(std::vector<Tile> tiles, int maxCpus, const Deadline &deadline,
+                 RenderTile &&renderTile, OnDone &&onDone) {
+  WorkStealingQueue<Tile> queue(std::move(tiles),
+                                static_cast<size_t>(maxCpus));
+  std::atomic<size_t> numDone{0};
+  std::atomic_flag reporting = ATOMIC_FLAG_INIT;
+  auto worker = [&](size_t thread) {
+    while (!deadline.passed()) {
+      auto tileOpt = queue.pop(thread);
+      if (!tileOpt)
+        break;
+      renderTile(*tileOpt);
+      const auto done = ++numDone;
+      if (!reporting.test_and_set(std::memory_order_acquire)) {
+        onDone(done);
+        reporting.clear(std::memory_order_release);
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < queue.numThreads(); ++thread)
+    threads.emplace_back(worker, thread);
+  for (auto &t : threads)
+    t.join();
+}
+
+namespace detail {
+
+// What a tiled render's ways of choosing its samples share: the image, how to
+// render a tile's samples, and how to hand out tiles, reporting progress and
+// snapshots along the way. See renderTiled().
+template <typename RenderSample>
+class TiledRenderer {
+  static constexpr int TileSize = 16;
+  static constexpr int SamplesPerTile = 8;
+
+  const RenderParams &renderParams_;
+  RenderSample &renderSample_;
+  const std::function<void(const ArrayOutput &)> &updateFunc_;
+  int width_;
+  int height_;
+  // Each thread renders its tiles privately and commits them whole.
+  TileAccumulator accumulator_;
+  // The samples of every pixel rendered so far, for reporting progress.
+  std::atomic<size_t> samplesDone_{0};
+
+  [[nodiscard]] static size_t numPixels(const Tile &tile) noexcept {
+    return static_cast<size_t>((tile.xEnd - tile.xBegin)
+                               * (tile.yEnd - tile.yBegin));
+  }
+
+  [[nodiscard]] size_t imageSamples(int samplesPerPixel) const noexcept {
+    return static_cast<size_t>(width_) * static_cast<size_t>(height_)
+           * static_cast<size_t>(samplesPerPixel);
+  }
+
+  [[nodiscard]] std::vector<Tile> generate(int numSamples,
+                                           int samplesPerTile) const {
+    return generateTiles(width_, height_, TileSize, TileSize, numSamples,
+                         samplesPerTile, renderParams_.seed);
+  }
+
+  // Renders the tile's samples, returning them for each pixel.
+  [[nodiscard]] std::vector<SampleMoments>
+  sampleTile(const Tile &tile, const RenderParams &params) const {
+    std::vector<SampleMoments> pixels;
+    for (int y = tile.yBegin; y < tile.yEnd; ++y) {
+      for (int x = tile.xBegin; x < tile.xEnd; ++x) {
+        SampleMoments pixel;
+        for (int sample = 0; sample < tile.samples; ++sample) {
+          Sampler sampler(renderParams_.sampler, renderParams_.seed,
+                          x + y * width_, tile.sampleNum + sample);
+          pixel.add(renderSample_(sampler, x, y, params));
+        }
+        pixels.emplace_back(pixel);
+      }
+    }
+    return pixels;
+  }
+
+  void renderTile(const Tile &tile, const RenderParams &params) {
+    accumulator_.commit(tile.xBegin, tile.xEnd, tile.yBegin, tile.yEnd,
+                        sampleTile(tile, params));
+  }
+
+  // Calls tileFunc(tile) for each tile until the deadline, counting its
+  // samples towards the progress. Snapshotting the image isn't free, so
+  // updates only go out every percent or so of the tiles.
+  template <typename TileFunc>
+  void render(std::vector<Tile> tiles, RenderProgress &progress,
+              TileFunc &&tileFunc) {
+    const auto updateEvery = std::max<size_t>(tiles.size() / 100, 1);
+    size_t nextUpdate = updateEvery;
+    forEachTile(
+        std::move(tiles), renderParams_.maxCpus, renderParams_.deadline,
+        [&](const Tile &tile) {
+          tileFunc(tile);
+          samplesDone_ += numPixels(tile) * tile.samples;
+        },
+        [&](size_t done) {
+          progress.update(samplesDone_);
+          if (done >= nextUpdate) {
+            updateFunc_(accumulator_.snapshot());
+            nextUpdate = done + updateEvery;
+          }
+        });
+  }
+
+public:
+  TiledRenderer(const RenderParams &renderParams, RenderSample &renderSample,
+                const std::function<void(const ArrayOutput &)> &updateFunc)
+      : renderParams_(renderParams), renderSample_(renderSample),
+        updateFunc_(updateFunc), width_(renderParams.width),
+        height_(renderParams.height),
+        accumulator_(width_, height_, TileSize, TileSize,
+                     renderParams.adaptiveError > 0) {}
+
+  // renderParams.samplesPerPixel samples of every pixel or, with a deadline,
+  // a round of a pass of every tile at a time until time runs out.
+  void renderSamples() {
+    const auto &deadline = renderParams_.deadline;
+    RenderProgress progress(deadline,
+                            imageSamples(renderParams_.samplesPerPixel));
+    auto renderAll = [&](const Tile &tile) { renderTile(tile, renderParams_); };
+    if (!deadline) {
+      render(generate(renderParams_.samplesPerPixel, SamplesPerTile), progress,
+             renderAll);
+      return;
+    }
+    for (int sampleNum = 0; !deadline.passed(); sampleNum += SamplesPerTile) {
+      auto tiles = generate(SamplesPerTile, SamplesPerTile);
+      for (auto &tile : tiles)
+        tile.sampleNum = sampleNum;
+      render(std::move(tiles), progress, renderAll);
+    }
+  }
+
+  // Every tile starts with a pass of a few samples, enough to tell how noisy
+  // it is. Each round after that gives another pass to every tile still
+  // noisier than renderParams.adaptiveError, noisiest first, until none are
+  // or the budget runs out: as many samples in all as
+  // renderParams.samplesPerPixel would have spent on every pixel.
+  void renderAdaptively() {
+    const auto budget = imageSamples(renderParams_.samplesPerPixel);
+    auto tiles =
+        generate(std::min(SamplesPerTile, renderParams_.samplesPerPixel),
+                 SamplesPerTile);
+    size_t spent = 0;
+    for (const auto &tile : tiles)
+      spent += numPixels(tile) * tile.samples;
+
+    RenderProgress progress(renderParams_.deadline, budget);
+    auto round = tiles;
+    int numRounds = 0;
+    size_t numConverged = 0;
+    for (;;) {
+      render(std::move(round), progress,
+             [&](const Tile &tile) { renderTile(tile, renderParams_); });
+      ++numRounds;
+      for (auto &tile : tiles)
+        tile.sampleNum += tile.samples;
+
+      std::vector<std::pair<double, size_t>> noisy;
+      for (size_t index = 0; index < tiles.size(); ++index) {
+        const auto &tile = tiles[index];
+        const auto error = accumulator_.relativeError(tile.xBegin, tile.xEnd,
+                                                      tile.yBegin, tile.yEnd);
+        if (error > renderParams_.adaptiveError)
+          noisy.emplace_back(error, index);
+      }
+      numConverged = tiles.size() - noisy.size();
+      std::sort(noisy.begin(), noisy.end(), std::greater<>());
+      round.clear();
+      for (auto &tile : tiles)
+        tile.samples = 0;
+      for (const auto &[error, index] : noisy) {
+        auto &tile = tiles[index];
+        const auto samples = static_cast<int>(std::min<size_t>(
+            SamplesPerTile, (budget - spent) / numPixels(tile)));
+        if (samples == 0)
+          continue;
+        tile.samples = samples;
+        spent += numPixels(tile) * samples;
+        round.emplace_back(tile);
+      }
+      if (round.empty() || renderParams_.deadline.passed())
+        break;
+    }
+    reportAdaptiveSampling(numRounds, numConverged, tiles.size(),
+                           static_cast<double>(samplesDone_)
+                               / (width_ * height_));
+  }
+
+  // renderParams.raysPerPixel rays on every pixel, split at the first bounce
+  // as the pilot samples suggest.
+  void renderBudgeted() {
+    checkRayBudget(renderParams_.raysPerPixel);
+    const auto tilesAcross = (width_ + TileSize - 1) / TileSize;
+    const auto tilesDown = (height_ + TileSize - 1) / TileSize;
+    auto tileIndex = [&](const Tile &tile) {
+      return static_cast<size_t>(tile.xBegin / TileSize
+                                 + tile.yBegin / TileSize * tilesAcross);
+    };
+    // The total over the tile's pixels of the variance between their
+    // samples, taking the brightness of each. The samples are only added to
+    // the image if keep is set.
+    auto renderVariance = [&](const Tile &tile, const RenderParams &params,
+                              bool keep) {
+      const auto pixels = sampleTile(tile, params);
+      if (keep)
+        accumulator_.commit(tile.xBegin, tile.xEnd, tile.yBegin, tile.yEnd,
+                            pixels);
+      double total = 0;
+      for (const auto &pixel : pixels) {
+        const auto variance = pixel.variance();
+        total += (variance.x() + variance.y() + variance.z()) / 3;
+      }
+      return total;
+    };
+
+    // The pilot samples come first. The unsplit ones are far noisier than the
+    // rest, so are only measured; the split ones count towards the image like
+    // any other. A few samples of a tile say little about its variance, so the
+    // split is chosen for the whole image: from the median over the tiles,
+    // weighted by their variance, of how much splitting cut it. The total
+    // would be swamped by the few tiles along a bright light's edge.
+    struct PilotVariances {
+      double unsplit{};
+      double split{};
+      [[nodiscard]] double ratio() const noexcept {
+        return split > 0 ? unsplit / split
+                         : std::numeric_limits<double>::infinity();
+      }
+    };
+    std::vector<PilotVariances> tileVariances(
+        static_cast<size_t>(tilesAcross * tilesDown));
+    RenderProgress pilotProgress(renderParams_.deadline,
+                                 imageSamples(PilotSamples));
+    render(generate(PilotSamples, PilotSamples), pilotProgress,
+           [&](const Tile &tile) {
+             auto splitTile = tile;
+             splitTile.sampleNum += PilotSamples;
+             tileVariances[tileIndex(tile)] = PilotVariances{
+                 renderVariance(tile, FirstBounceSplit().applyTo(renderParams_),
+                                false),
+                 renderVariance(splitTile, PilotSplit.applyTo(renderParams_),
+                                true)};
+           });
+    std::sort(tileVariances.begin(), tileVariances.end(),
+              [](const PilotVariances &lhs, const PilotVariances &rhs) {
+                return lhs.ratio() < rhs.ratio();
+              });
+    double totalVariance = 0;
+    for (const auto &variances : tileVariances)
+      totalVariance += variances.unsplit;
+    // With no variance at all, there's nothing to split for.
+    auto varianceRatio = 1.0;
+    double runningVariance = 0;
+    for (const auto &variances : tileVariances) {
+      runningVariance += variances.unsplit;
+      if (totalVariance > 0 && runningVariance >= totalVariance / 2) {
+        varianceRatio = variances.ratio();
+        break;
+      }
+    }
+    // The model only holds between the splits measured, so the split is no
+    // more than the pilot's.
+    const auto split = chooseSplit(
+        varianceRatio, 1,
+        std::min(PilotSplit.numSplits(),
+                 renderParams_.raysPerPixel - pilotRays() - 1));
+    const auto numSamples = budgetedSamples(renderParams_.raysPerPixel, split);
+    reportSplit(split, renderParams_.raysPerPixel);
+
+    std::vector<Tile> tiles;
+    for (auto tile : generate(numSamples, SamplesPerTile)) {
+      tile.sampleNum += 2 * PilotSamples;
+      tiles.emplace_back(tile);
+    }
+    const auto params = split.applyTo(renderParams_);
+    // Carrying on from the pilot samples.
+    RenderProgress progress(renderParams_.deadline,
+                            samplesDone_ + imageSamples(numSamples));
+    render(std::move(tiles), progress,
+           [&](const Tile &tile) { renderTile(tile, params); });
+  }
+
+  // The image as it ends up, sent out as a last update too.
+  [[nodiscard]] ArrayOutput finish() {
+    auto output = accumulator_.snapshot();
+    updateFunc_(output);
+    return output;
+  }
+};
+
+}
+
+// Renders the image a tile at a time on renderParams.maxCpus threads, calling
+// renderSample(sampler, x, y, params) for the radiance of each sample of each
+// pixel, with a sampler for that sample alone. params is renderParams, but
+// with the first bounce samples to use. Each thread needs just one tile's
+// worth of buffer, so beyond the image itself memory use doesn't grow with
+// the size of the image or the number of passes. updateFunc sees a snapshot
+// every percent or so of the tiles.
+//
+// With renderParams.raysPerPixel, that many rays are spent on each pixel
+// instead of renderParams.samplesPerPixel samples, split at the first bounce
+// as the pilot samples suggest (see SplitBudget.h). With
+// renderParams.adaptiveError instead, the samples go to the tiles that are
+// still noisy, until they all have a relative error (see SampleMoments.h) no
+// more than that. Whichever it is, no tiles start once renderParams.deadline
+// has passed; without a ray budget or adaptive sampling, the tiles are
+// rendered over and over until it does.
+template <typename RenderSample>
+ArrayOutput
+renderTiled(const RenderParams &renderParams, RenderSample &&renderSample,
+            const std::function<void(const ArrayOutput &)> &updateFunc) {
+  detail::TiledRenderer<std::remove_reference_t<RenderSample>> renderer(
+      renderParams, renderSample, updateFunc);
+  if (renderParams.raysPerPixel > 0)
+    renderer.renderBudgeted();
+  else if (renderParams.adaptiveError > 0)
+    renderer.renderAdaptively();
+  else
+    renderer.renderSamples();
+  return renderer.finish();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Shares out a fixed set of work items between a number of threads without a
+// lock. Each thread has its own deque of items, dealt out in turn so each gets
+// a similar mix. A thread takes its own items from the front, most important
+// first; when it runs out it steals from the back of another thread's deque,
+// taking the least important items and so keeping out of the owner's way.
+//
+// As the items are all known up front, a deque is just a range of indices
+// into its items, packed into one atomic word so that the owner and thieves
+// can each shrink it from their own end with a compare-and-swap.
+template <typename WorkItem>
+class WorkStealingQueue {
+  // On its own cache line so threads taking from different deques don't
+  // contend.
+  struct alignas(64) Deque {
+    std::vector<WorkItem> items;
+    std::atomic<uint64_t> range{};
+  };
+  std::unique_ptr<Deque[]> deques_;
+  size_t numThreads_;
+  size_t size_;
+
+  static constexpr uint64_t pack(uint32_t begin, uint32_t end) noexcept {
+    return (static_cast<uint64_t>(begin) << 32u) | end;
+  }
+  static constexpr uint32_t beginOf(uint64_t range) noexcept {
+    return static_cast<uint32_t>(range >> 32u);
+  }
+  static constexpr uint32_t endOf(uint64_t range) noexcept {
+    return static_cast<uint32_t>(range);
+  }
+
+  std::optional<WorkItem> takeFront(Deque &deque) noexcept {
+    auto range = deque.range.load(std::memory_order_relaxed);
+    while (beginOf(range) < endOf(range)) {
+      if (deque.range.compare_exchange_weak(
+              range, pack(beginOf(range) + 1, endOf(range)),
+              std::memory_order_relaxed))
+        return deque.items[beginOf(range)];
+    }
+    return {};
+  }
+
+  std::optional<WorkItem> stealBack(Deque &deque) noexcept {
+    auto range = deque.range.load(std::memory_order_relaxed);
+    while (beginOf(range) < endOf(range)) {
+      if (deque.range.compare_exchange_weak(
+              range, pack(beginOf(range), endOf(range) - 1),
+              std::memory_order_relaxed))
+        return deque.items[endOf(range) - 1];
+    }
+    return {};
+  }
+
+public:
+  // As with a stack, the items are handed out starting from the back of todo.
+  WorkStealingQueue(std::vector<WorkItem> todo, size_t numThreads)
+      : deques_(std::make_unique<Deque[]>(std::max<size_t>(numThreads, 1))),
+        numThreads_(std::max<size_t>(numThreads, 1)), size_(todo.size()) {
+    for (size_t i = 0; i < size_; ++i)
+      deques_[i % numThreads_].items.emplace_back(
+          std::move(todo[size_ - 1 - i]));
+    for (size_t thread = 0; thread < numThreads_; ++thread) {
+      auto &deque = deques_[thread];
+      deque.range.store(pack(0, static_cast<uint32_t>(deque.items.size())));
+    }
+  }
+
+  [[nodiscard]] size_t size() const noexcept { return size_; }
+  [[nodiscard]] size_t numThreads() const noexcept { return numThreads_; }
+
+  // Returns the next item for the given thread (0 to numThreads - 1), or
+  // nothing once every item has been handed out.
+  std::optional<WorkItem> pop(size_t thread) noexcept {
+    if (auto item = takeFront(deques_[thread]))
+      return item;
+    for (size_t i = 1; i < numThreads_; ++i)
+      if (auto item = stealBack(deques_[(thread + i) % numThreads_]))
+        return item;
+    return {};
+  }
+};
@@ -0,0 +1,144 @@
+#include <catch2/catch.hpp>
+
+#include "dod/Bvh.h"
+#include "dod/WideBvh.h"
+
+#include <random>
+
+using dod::Bvh;
+
+namespace {
+
+std::vector<Aabb> randomBoxes(size_t count) {
+  std::mt19937 rng(4321);
+  std::uniform_real_distribution<> coord(-10, 10);
+  std::uniform_real_distribution<> size(0, 0.5);
+  std::vector<Aabb> boxes;
+  for (size_t i = 0; i < count; ++i) {
+    auto min = Vec3(coord(rng), coord(rng), coord(rng));
+    boxes.emplace_back(min, min + Vec3(size(rng), size(rng), size(rng)));
+  }
+  return boxes;
+}
+
+bool contains(const Aabb &outer, const Aabb &inner) {
+  return outer.including(inner).min() == outer.min()
+         && outer.including(inner).max() == outer.max();
+}
+
+// Walks the tree checking each node's bounds contain its children's, and
+// counts how many times each primitive is reached. Returns the depth.
+size_t checkNode(const Bvh &bvh, const std::vector<Aabb> &boxes,
+                 size_t nodeIndex, std::vector<int> &seen) {
+  auto &node = bvh.nodes.at(nodeIndex);
+  if (node.isLeaf()) {
+    for (auto i = node.index; i < node.index + node.numPrimitives; ++i) {
+      auto prim = bvh.primitiveOrder.at(i);
+      seen.at(prim)++;
+      CHECK(contains(node.bounds, boxes[prim]));
+    }
+    return 1;
+  }
+  auto &left = bvh.nodes.at(nodeIndex + 1);
+  auto &right = bvh.nodes.at(node.index);
+  CHECK(contains(node.bounds, left.bounds));
+  CHECK(contains(node.bounds, right.bounds));
+  return 1 + std::max(checkNode(bvh, boxes, nodeIndex + 1, seen),
+                      checkNode(bvh, boxes, node.index, seen));
+}
+
+template <size_t Width>
+void checkWideNode(const dod::WideBvh<Width> &bvh, size_t nodeIndex,
+                   std::vector<int> &seen) {
+  auto &node = bvh.nodes.at(nodeIndex);
+  REQUIRE(node.numChildren >= 1);
+  REQUIRE(node.numChildren <= Width);
+  for (size_t lane = 0; lane < node.numChildren; ++lane) {
+    if (node.numPrimitives[lane] == 0) {
+      checkWideNode(bvh, node.index[lane], seen);
+      continue;
+    }
+    for (auto i = node.index[lane];
+         i < node.index[lane] + node.numPrimitives[lane]; ++i)
+      seen.at(i)++;
+  }
+}
+
+template <size_t Width>
+void checkCollapsed(const Bvh &bvh) {
+  auto wide = dod::collapseBvh<Width>(bvh);
+  std::vector<int> seen(bvh.primitiveOrder.size());
+  checkWideNode(wide, 0, seen);
+  CHECK(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+  // Each wide node absorbs at least one binary interior node, usually more.
+  CHECK(wide.nodes.size() <= bvh.nodes.size() / 2);
+}
+
+void checkBvh(const Bvh &bvh, const std::vector<Aabb> &boxes) {
+  std::vector<int> seen(boxes.size());
+  auto depth = checkNode(bvh, boxes, 0, seen);
+  CHECK(depth <= Bvh::MaxDepth);
+  CHECK(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+}
+
+}
+
+TEST_CASE("BVH builders", "[Bvh]") {
+  SECTION("empty") {
+    CHECK(dod::buildSahBvh({}).empty());
+    CHECK(dod::buildLinearBvh({}, 4).empty());
+  }
+  SECTION("single primitive") {
+    auto boxes = randomBoxes(1);
+    checkBvh(dod::buildSahBvh(boxes), boxes);
+    auto linear = dod::buildLinearBvh(boxes, 4);
+    CHECK(linear.nodes.size() == 1);
+    checkBvh(linear, boxes);
+  }
+  SECTION("surface area heuristic") {
+    auto boxes = randomBoxes(1000);
+    checkBvh(dod::buildSahBvh(boxes), boxes);
+  }
+  SECTION("linear") {
+    auto boxes = randomBoxes(1000);
+    auto bvh = dod::buildLinearBvh(boxes, 4);
+    CHECK(bvh.nodes.size() == 2 * boxes.size() - 1);
+    checkBvh(bvh, boxes);
+  }
+  SECTION("linear with coincident primitives") {
+    std::vector<Aabb> boxes(1000, Aabb(Vec3(1, 2, 3), Vec3(2, 3, 4)));
+    checkBvh(dod::buildLinearBvh(boxes, 2), boxes);
+  }
+  SECTION("linear is independent of thread count") {
+    auto boxes = randomBoxes(1000);
+    auto single = dod::buildLinearBvh(boxes, 1);
+    auto multi = dod::buildLinearBvh(boxes, 7);
+    CHECK(single.primitiveOrder == multi.primitiveOrder);
+    REQUIRE(single.nodes.size() == multi.nodes.size());
+    for (size_t i = 0; i < single.nodes.size(); ++i) {
+      INFO("Node " << i);
+      CHECK(single.nodes[i].index == multi.nodes[i].index);
+      CHECK(single.nodes[i].numPrimitives == multi.nodes[i].numPrimitives);
+    }
+  }
+}
+
+TEST_CASE("Collapsed BVHs", "[Bvh]") {
+  SECTION("empty") { CHECK(dod::collapseBvh<4>(Bvh()).empty()); }
+  SECTION("single leaf") {
+    auto boxes = randomBoxes(1);
+    auto wide = dod::collapseBvh<8>(dod::buildSahBvh(boxes));
+    REQUIRE(wide.nodes.size() == 1);
+    CHECK(wide.nodes[0].numChildren == 1);
+  }
+  SECTION("4-wide") {
+    auto boxes = randomBoxes(1000);
+    checkCollapsed<4>(dod::buildSahBvh(boxes));
+    checkCollapsed<4>(dod::buildLinearBvh(boxes, 2));
+  }
+  SECTION("8-wide") {
+    auto boxes = randomBoxes(1000);
+    checkCollapsed<8>(dod::buildSahBvh(boxes));
+    checkCollapsed<8>(dod::buildLinearBvh(boxes, 2));
+  }
+}
@@ -0,0 +1,109 @@
+#include <catch2/catch.hpp>
+
+#include "dod/RayPacket.h"
+#include "dod/Scene.h"
+
+#include <random>
+
+using dod::RayPacket;
+
+namespace {
+
+// Rays fanning out from around a point, as primary rays for a block of
+// pixels would.
+std::vector<Ray> coherentRays(std::mt19937 &rng, size_t count) {
+  std::uniform_real_distribution<> coord(-10, 10);
+  std::uniform_real_distribution<> jitter(-0.05, 0.05);
+  const auto origin = Vec3(coord(rng), coord(rng), coord(rng));
+  const auto target = Vec3(coord(rng), coord(rng), coord(rng));
+  std::vector<Ray> rays;
+  for (size_t i = 0; i < count; ++i) {
+    auto offset = Vec3(jitter(rng), jitter(rng), jitter(rng));
+    rays.emplace_back(
+        Ray::fromTwoPoints(origin + offset * 0.1, target + offset * 20));
+  }
+  return rays;
+}
+
+}
+
+TEST_CASE("Ray packets", "[RayPacket]") {
+  std::mt19937 rng(1357);
+  std::uniform_real_distribution<> coord(-10, 10);
+  std::uniform_real_distribution<> size(0, 3);
+  auto randomVec = [&] { return Vec3(coord(rng), coord(rng), coord(rng)); };
+
+  SECTION("rejects bad sizes") {
+    CHECK_THROWS(RayPacket({}));
+    CHECK_THROWS(RayPacket(coherentRays(rng, RayPacket::MaxSize + 1)));
+  }
+
+  SECTION("masks") {
+    CHECK(RayPacket(coherentRays(rng, 4)).allRays() == 0xfu);
+    CHECK(RayPacket(coherentRays(rng, RayPacket::MaxSize)).allRays()
+          == (1u << RayPacket::MaxSize) - 1);
+  }
+
+  SECTION("box tests match single rays") {
+    size_t numHits = 0;
+    for (int i = 0; i < 2000; ++i) {
+      RayPacket packet(coherentRays(rng, 1 + i % RayPacket::MaxSize));
+      // Near the rays, so a fair number of them hit.
+      auto min =
+          packet.ray(0).positionAlong(coord(rng) + 10) + randomVec() * 0.1;
+      auto box = Aabb(min, min + Vec3(size(rng), size(rng), size(rng)));
+      RayPacket::Distances nearerThan;
+      for (auto &distance : nearerThan)
+        distance = i % 2 ? 1e10 : coord(rng) + 10;
+      uint32_t expected = 0;
+      for (size_t ray = 0; ray < packet.size(); ++ray)
+        if (box.intersects(packet.ray(ray), packet.inverseDirection(ray),
+                           nearerThan[ray]))
+          expected |= 1u << ray;
+      INFO("Packet " << i);
+      REQUIRE(packet.intersects(box, nearerThan) == expected);
+      numHits += expected != 0;
+    }
+    CHECK(numHits > 100);
+  }
+}
+
+TEST_CASE("Scene packet intersection", "[RayPacket]") {
+  std::mt19937 rng(8642);
+  std::uniform_real_distribution<> coord(-10, 10);
+  std::uniform_real_distribution<> small(-1, 1);
+  auto randomVec = [&] { return Vec3(coord(rng), coord(rng), coord(rng)); };
+  dod::Scene scene;
+  for (int i = 0; i < 500; ++i) {
+    auto v0 = randomVec();
+    scene.addTriangle(v0, v0 + Vec3(small(rng), small(rng), small(rng)),
+                      v0 + Vec3(small(rng), small(rng), small(rng)),
+                      MaterialSpec::makeDiffuse(Vec3(i, 0, 0)));
+  }
+  for (int i = 0; i < 50; ++i)
+    scene.addSphere(randomVec(), 1, MaterialSpec::makeDiffuse(Vec3(0, i, 0)));
+
+  SECTION("binary BVH") { scene.buildBvh(); }
+  SECTION("wide BVH") {
+    scene.buildBvh(dod::BvhBuilder::SurfaceAreaHeuristic, 1, 4);
+  }
+  SECTION("no BVH") {}
+
+  size_t numHits = 0;
+  for (int i = 0; i < 200; ++i) {
+    RayPacket packet(coherentRays(rng, 16));
+    auto records = scene.intersect(packet);
+    REQUIRE(records.size() == packet.size());
+    for (size_t ray = 0; ray < packet.size(); ++ray) {
+      INFO("Packet " << i << " ray " << ray);
+      auto single = scene.intersect(packet.ray(ray));
+      REQUIRE(single.has_value() == records[ray].has_value());
+      if (!single)
+        continue;
+      numHits++;
+      CHECK(single->hit.distance == records[ray]->hit.distance);
+      CHECK(single->material == records[ray]->material);
+    }
+  }
+  CHECK(numHits > 100);
+}
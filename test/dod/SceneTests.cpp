@@ -5,6 +5,8 @@
 #include "math/Ray.h"
 
 #include <cmath>
+#include <random>
+#include <vector>
 
 using dod::Scene;
 
@@ -81,4 +83,306 @@ TEST_CASE("Scenes", "[Scene]") {
   // TODO: mixture of triangles and spheres
 }
 
-}
\ No newline at end of file
+TEST_CASE("Scene BVH", "[Scene]") {
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<> coord(-10, 10);
+  std::uniform_real_distribution<> small(-1, 1);
+  auto randomVec = [&] { return Vec3(coord(rng), coord(rng), coord(rng)); };
+  auto nearbyVec = [&](const Vec3 &v) {
+    return v + Vec3(small(rng), small(rng), small(rng));
+  };
+
+  Scene s;
+  for (int i = 0; i < 500; ++i) {
+    auto v0 = randomVec();
+    s.addTriangle(v0, nearbyVec(v0), nearbyVec(v0),
+                  MaterialSpec::makeDiffuse(Vec3(i, 0, 0)));
+  }
+  for (int i = 0; i < 50; ++i)
+    s.addSphere(randomVec(), 0.5 + small(rng) * 0.25,
+                MaterialSpec::makeDiffuse(Vec3(0, i, 0)));
+  // Axis-aligned rays lying in the planes of bounding box faces are a tricky
+  // case for the box tests.
+  s.addTriangle(Vec3(0, 0, 0), Vec3(0, 1, 0), Vec3(0, 1, 1),
+                MaterialSpec::makeDiffuse(Vec3(0, 0, 1)));
+
+  std::vector<Ray> rays;
+  for (int i = 0; i < 2000; ++i)
+    rays.emplace_back(Ray::fromTwoPoints(randomVec(), randomVec()));
+  rays.emplace_back(Ray::fromTwoPoints(Vec3(-1, 1, 0.5), Vec3(0, 1, 0.5)));
+  rays.emplace_back(Ray::fromTwoPoints(Vec3(1, 1, 0.5), Vec3(0, 1, 0.5)));
+  rays.emplace_back(Ray::fromTwoPoints(Vec3(-1, 0.5, 0), Vec3(0, 0.5, 0)));
+
+  struct Result {
+    double distance;
+    Vec3 position;
+    Norm3 normal;
+    MaterialSpec material;
+  };
+  auto intersectAll = [&] {
+    std::vector<std::optional<Result>> results;
+    for (auto &ray : rays) {
+      auto ir = s.intersect(ray);
+      results.emplace_back(ir ? std::optional<Result>(
+                                    Result{ir->hit.distance, ir->hit.position,
+                                           ir->hit.normal, ir->material})
+                              : std::nullopt);
+    }
+    return results;
+  };
+
+  // Whether anything is nearer than a few distances along each ray.
+  const auto maxDistances = {2.0, 10.0};
+  auto occludedAll = [&] {
+    std::vector<bool> results;
+    for (auto &ray : rays)
+      for (auto maxDistance : maxDistances)
+        results.emplace_back(s.occluded(ray, maxDistance));
+    return results;
+  };
+
+  auto bruteForce = intersectAll();
+  const auto bruteForceOccluded = occludedAll();
+  SECTION("surface area heuristic") { s.buildBvh(); }
+  SECTION("linear") { s.buildBvh(dod::BvhBuilder::Linear, 3); }
+  SECTION("4-wide") {
+    s.buildBvh(dod::BvhBuilder::SurfaceAreaHeuristic, 1, 4);
+  }
+  SECTION("8-wide") { s.buildBvh(dod::BvhBuilder::Linear, 2, 8); }
+  auto withBvh = intersectAll();
+  CHECK(occludedAll() == bruteForceOccluded);
+
+  REQUIRE(bruteForce.size() == withBvh.size());
+  size_t numHits = 0;
+  size_t occludedIndex = 0;
+  for (size_t i = 0; i < bruteForce.size(); ++i) {
+    for (auto maxDistance : maxDistances) {
+      INFO("Ray " << i << " within " << maxDistance);
+      CHECK(bruteForceOccluded[occludedIndex++]
+            == (bruteForce[i] && bruteForce[i]->distance < maxDistance));
+    }
+  }
+  for (size_t i = 0; i < bruteForce.size(); ++i) {
+    INFO("Ray " << i);
+    REQUIRE(bruteForce[i].has_value() == withBvh[i].has_value());
+    if (!bruteForce[i])
+      continue;
+    numHits++;
+    CHECK(bruteForce[i]->distance == withBvh[i]->distance);
+    CHECK(bruteForce[i]->position == withBvh[i]->position);
+    CHECK(bruteForce[i]->normal == withBvh[i]->normal);
+    CHECK(bruteForce[i]->material == withBvh[i]->material);
+  }
+  // Make sure the test is testing something.
+  CHECK(numHits > 100);
+}
+
+// The radiance of the rendered image, averaged over its pixels.
+Vec3 meanRadiance(Scene &scene, const Camera &camera,
+                  const RenderParams &params) {
+  const auto output = scene.render(camera, params, [](ArrayOutput &) {});
+  Vec3 total;
+  for (int y = 0; y < params.height; ++y)
+    for (int x = 0; x < params.width; ++x)
+      total += output.rawPixelAt(x, y);
+  return total / (params.width * params.height);
+}
+
+// For renders that sample differently, so only their expectations match.
+void checkSameMean(const Vec3 &actual, const Vec3 &expected, double epsilon) {
+  CHECK(actual.x() == Approx(expected.x()).epsilon(epsilon));
+  CHECK(actual.y() == Approx(expected.y()).epsilon(epsilon));
+  CHECK(actual.z() == Approx(expected.z()).epsilon(epsilon));
+}
+
+TEST_CASE("Wavefront rendering", "[Scene]") {
+  Scene s;
+  s.setEnvironmentColour(Vec3(0.2, 0.3, 0.4));
+  s.addSphere(Vec3(-1, 0, 0), 1,
+              MaterialSpec::makeDiffuse(Vec3(0.8, 0.5, 0.2)));
+  s.addSphere(Vec3(1, 0, 0), 1,
+              MaterialSpec::makeReflective(Vec3(0.5, 0.5, 0.5), 0.5, 10));
+  s.addSphere(Vec3(0, 3, 0), 1, MaterialSpec::makeLight(Vec3(4, 4, 4)));
+  s.addTriangle(Vec3(-10, -1, -10), Vec3(10, -1, -10), Vec3(0, -1, 10),
+                MaterialSpec::makeSpecular(Vec3(0.7, 0.7, 0.7), 1.5));
+
+  RenderParams params;
+  params.width = 24;
+  params.height = 16;
+  params.samplesPerPixel = 8;
+  params.maxCpus = 4;
+  params.seed = 1234;
+  Camera camera(Vec3(0, 1, -8), Vec3(0, 0, 0), Norm3::yAxis(), params.width,
+                params.height, 40);
+
+  // The paths are sampled in a different order, so only the expectation
+  // matches.
+  const auto depthFirst = meanRadiance(s, camera, params);
+  params.wavefront = true;
+  const auto breadthFirst = meanRadiance(s, camera, params);
+  checkSameMean(breadthFirst, depthFirst, 0.02);
+  const auto stats = s.wavefrontStats();
+  CHECK(stats.raysTraced > static_cast<size_t>(params.width * params.height
+                                               * params.samplesPerPixel));
+  CHECK(stats.nodeVisits > stats.raysTraced);
+
+  params.sortRays = true;
+  const auto sorted = meanRadiance(s, camera, params);
+  checkSameMean(sorted, depthFirst, 0.02);
+
+  params.packetSize = 4;
+  const auto packets = meanRadiance(s, camera, params);
+  checkSameMean(packets, depthFirst, 0.02);
+
+  params.wavefront = false;
+  CHECK_THROWS(s.render(camera, params, [](ArrayOutput &) {}));
+}
+
+TEST_CASE("Rendering is repeatable", "[Scene]") {
+  Scene s;
+  s.setEnvironmentColour(Vec3(0.2, 0.3, 0.4));
+  s.addSphere(Vec3(-1, 0, 0), 1,
+              MaterialSpec::makeDiffuse(Vec3(0.8, 0.5, 0.2)));
+  s.addSphere(Vec3(1, 0, 0), 1,
+              MaterialSpec::makeReflective(Vec3(0.5, 0.5, 0.5), 0.5, 10));
+  s.addSphere(Vec3(0, 3, 0), 1, MaterialSpec::makeLight(Vec3(4, 4, 4)));
+
+  RenderParams params;
+  params.width = 20;
+  params.height = 12;
+  params.samplesPerPixel = 4;
+  params.seed = 4321;
+  Camera camera(Vec3(0, 1, -8), Vec3(0, 0, 0), Norm3::yAxis(), params.width,
+                params.height, 40);
+  auto render = [&] {
+    return params.tiled
+               ? s.renderTiled(camera, params, [](const ArrayOutput &) {})
+               : s.render(camera, params, [](ArrayOutput &) {});
+  };
+  // Each sample of each pixel has a generator of its own, so only the order
+  // the samples are summed in can differ.
+  auto checkSame = [&](const ArrayOutput &lhs, const ArrayOutput &rhs) {
+    for (int y = 0; y < params.height; ++y)
+      for (int x = 0; x < params.width; ++x)
+        REQUIRE(lhs.rawPixelAt(x, y) == ApproxVec3(rhs.rawPixelAt(x, y)));
+  };
+
+  params.maxCpus = 1;
+  const auto reference = render();
+  SECTION("whatever the number of threads") {
+    params.maxCpus = 3;
+    checkSame(render(), reference);
+  }
+  SECTION("with ray packets") {
+    params.packetSize = 2;
+    checkSame(render(), reference);
+  }
+  SECTION("in tiles") {
+    params.tiled = true;
+    params.maxCpus = 3;
+    checkSame(render(), reference);
+  }
+  SECTION("breadth first") {
+    params.wavefront = true;
+    checkSame(render(), reference);
+  }
+  SECTION("with a Sobol sampler") {
+    params.sampler = SamplerKind::Sobol;
+    const auto sobol = render();
+    params.maxCpus = 3;
+    checkSame(render(), sobol);
+  }
+  SECTION("with next event estimation, however it's traced") {
+    params.nextEvent = true;
+    const auto nextEvent = render();
+    params.wavefront = true;
+    checkSame(render(), nextEvent);
+    params.wavefront = false;
+    params.packetSize = 2;
+    checkSame(render(), nextEvent);
+  }
+  SECTION("with a ray budget") {
+    params.tiled = true;
+    params.raysPerPixel = 40;
+    const auto budgeted = render();
+    params.maxCpus = 3;
+    checkSame(render(), budgeted);
+  }
+  SECTION("with adaptive sampling") {
+    params.tiled = true;
+    params.samplesPerPixel = 16;
+    params.adaptiveError = 0.2;
+    const auto adaptive = render();
+    params.maxCpus = 3;
+    checkSame(render(), adaptive);
+  }
+  SECTION("with Russian roulette, however it's traced") {
+    params.maxDepth = 20;
+    params.rouletteDepth = 2;
+    params.nextEvent = true;
+    const auto roulette = render();
+    params.wavefront = true;
+    checkSame(render(), roulette);
+    params.wavefront = false;
+    params.tiled = true;
+    checkSame(render(), roulette);
+  }
+}
+
+TEST_CASE("Russian roulette", "[Scene]") {
+  Scene s;
+  s.setEnvironmentColour(Vec3(0.1, 0.1, 0.1));
+  s.addSphere(Vec3(-1, 0, 0), 1,
+              MaterialSpec::makeDiffuse(Vec3(0.8, 0.5, 0.2)));
+  s.addSphere(Vec3(1, 0, 0), 1,
+              MaterialSpec::makeReflective(Vec3(0.5, 0.5, 0.5), 0.5, 10));
+  s.addSphere(Vec3(0, 3, 0), 1, MaterialSpec::makeLight(Vec3(4, 4, 4)));
+  s.addTriangle(Vec3(-10, -1, -10), Vec3(10, -1, -10), Vec3(0, -1, 10),
+                MaterialSpec::makeDiffuse(Vec3(0.7, 0.7, 0.7)));
+
+  RenderParams params;
+  params.width = 24;
+  params.height = 16;
+  params.samplesPerPixel = 16;
+  params.maxDepth = 12;
+  params.seed = 8765;
+  Camera camera(Vec3(0, 1, -8), Vec3(0, 0, 0), Norm3::yAxis(), params.width,
+                params.height, 40);
+
+  // Ending paths at random changes the noise, but not what it converges to.
+  const auto full = meanRadiance(s, camera, params);
+  params.rouletteDepth = 2;
+  const auto roulette = meanRadiance(s, camera, params);
+  checkSameMean(roulette, full, 0.03);
+  params.wavefront = true;
+  const auto breadthFirst = meanRadiance(s, camera, params);
+  checkSameMean(breadthFirst, full, 0.03);
+}
+
+TEST_CASE("Next event estimation", "[Scene]") {
+  Scene s;
+  s.setEnvironmentColour(Vec3(0.1, 0.1, 0.1));
+  s.addSphere(Vec3(-1, 0, 0), 1,
+              MaterialSpec::makeDiffuse(Vec3(0.8, 0.5, 0.2)));
+  s.addSphere(Vec3(1, 0, 0), 1,
+              MaterialSpec::makeReflective(Vec3(0.5, 0.5, 0.5), 0.5, 10));
+  s.addSphere(Vec3(0, 3, 0), 1, MaterialSpec::makeLight(Vec3(4, 4, 4)));
+  s.addSphere(Vec3(2, 3, -2), 0.5, MaterialSpec::makeLight(Vec3(8, 2, 2)));
+  s.addTriangle(Vec3(-10, -1, -10), Vec3(10, -1, -10), Vec3(0, -1, 10),
+                MaterialSpec::makeDiffuse(Vec3(0.7, 0.7, 0.7)));
+
+  RenderParams params;
+  params.width = 24;
+  params.height = 16;
+  params.samplesPerPixel = 16;
+  params.seed = 5678;
+  Camera camera(Vec3(0, 1, -8), Vec3(0, 0, 0), Norm3::yAxis(), params.width,
+                params.height, 40);
+
+  // Aiming at the lights changes the noise, but not what it converges to.
+  const auto byChance = meanRadiance(s, camera, params);
+  params.nextEvent = true;
+  checkSameMean(meanRadiance(s, camera, params), byChance, 0.03);
+}
+
+}
@@ -1,10 +1,12 @@
 #include <catch2/catch.hpp>
 
 #include "dod/Scene.h"
+#include "dod/SphereStore.h"
 #include "math/ApproxVec3.h"
 #include "math/Ray.h"
 
 #include <cmath>
+#include <random>
 
 namespace {
 
@@ -52,4 +54,53 @@ TEST_CASE("Spheres", "[Sphere]") {
   }
 }
 
-}
\ No newline at end of file
+TEST_CASE("Sphere store", "[Sphere]") {
+  std::mt19937 rng(2468);
+  std::uniform_real_distribution<> coord(-10, 10);
+  std::uniform_real_distribution<> radius(0.5, 3);
+  auto randomVec = [&] { return Vec3(coord(rng), coord(rng), coord(rng)); };
+  dod::SphereStore store;
+  // Not a multiple of the block size, so the last block is partial.
+  for (int i = 0; i < 23; ++i)
+    store.add(dod::Sphere(randomVec(), radius(rng)));
+  REQUIRE(store.size() == 23);
+
+  SECTION("SIMD and scalar kernels agree") {
+    size_t numHits = 0;
+    for (int i = 0; i < 1000; ++i) {
+      auto ray = Ray::fromTwoPoints(randomVec(), randomVec());
+      // Ranges starting and ending mid-block, as BVH leaves do.
+      auto begin = static_cast<size_t>(i % 7);
+      auto end = store.size() - static_cast<size_t>(i % 5);
+      auto nearerThan = i % 3 ? std::numeric_limits<double>::infinity() : 8.0;
+      std::optional<size_t> simdIndex;
+      std::optional<size_t> scalarIndex;
+      auto simd = store.nearest(ray, begin, end, nearerThan, simdIndex);
+      auto scalar =
+          store.nearestScalar(ray, begin, end, nearerThan, scalarIndex);
+      INFO("Ray " << i);
+      REQUIRE(simdIndex == scalarIndex);
+      CHECK(simd == Approx(scalar));
+      if (scalarIndex) {
+        numHits++;
+        CHECK(*scalarIndex >= begin);
+        CHECK(*scalarIndex < end);
+      }
+    }
+    CHECK(numHits > 100);
+  }
+
+  SECTION("reordering") {
+    std::vector<uint32_t> order(store.size());
+    for (size_t i = 0; i < order.size(); ++i)
+      order[i] = static_cast<uint32_t>(order.size() - 1 - i);
+    auto centre = store.centre(0);
+    auto radiusSquared = store.radiusSquared[0];
+    store.reorder(order);
+    CHECK(store.size() == 23);
+    CHECK(store.centre(22) == centre);
+    CHECK(store.radiusSquared[22] == radiusSquared);
+  }
+}
+
+}
@@ -40,6 +40,26 @@ TEST_CASE("Triangles", "[Triangles]") {
     CHECK(ir->hit.position == ApproxVec3(0.0, 0.0, 3.0));
     CHECK(ir->hit.normal == ApproxVec3(0, 0, -1));
   }
+  SECTION("picks the nearest across blocks of triangles") {
+    // Enough triangles that the nearest lands in different lanes of
+    // different blocks, with the furthest last.
+    for (auto z : {7, 5, 9, 4, 6, 8, 10, 3, 11}) {
+      MaterialSpec zMat;
+      zMat.diffuse = Vec3(z, 0, 0);
+      scene.addTriangle(Vec3(0, 0, z), Vec3(0, 1, z), Vec3(1, 1, z), zMat);
+    }
+    auto ray = Ray::fromTwoPoints(Vec3(0.1, 0.5, 0), Vec3(0.1, 0.5, 1));
+    auto ir = scene.intersectTriangles(ray, inf);
+    REQUIRE(ir);
+    CHECK(ir->hit.distance == Approx(3.0));
+    CHECK(ir->material.diffuse == Vec3(3, 0, 0));
+    auto nearer = scene.intersectTriangles(ray, 3.5);
+    REQUIRE(nearer);
+    CHECK(nearer->hit.distance == Approx(3.0));
+    CHECK(!scene.intersectTriangles(ray, 2.5));
+    CHECK(!scene.intersectTriangles(
+        Ray::fromTwoPoints(Vec3(0.1, 0.5, 12), Vec3(0.1, 0.5, 13)), inf));
+  }
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include <catch2/catch.hpp>
+
+#include "fp/Bvh.h"
+#include "fp/Scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+Aabb boundsOf(const fp::Primitive &primitive) {
+  return std::visit([](const auto &p) { return p.shape.bounds(); }, primitive);
+}
+
+const MaterialSpec &materialOf(const fp::Primitive &primitive) {
+  return std::visit(
+      [](const auto &p) -> const MaterialSpec & { return p.material; },
+      primitive);
+}
+
+bool contains(const Aabb &outer, const Aabb &inner) {
+  return outer.min().x() <= inner.min().x()
+         && outer.min().y() <= inner.min().y()
+         && outer.min().z() <= inner.min().z()
+         && outer.max().x() >= inner.max().x()
+         && outer.max().y() >= inner.max().y()
+         && outer.max().z() >= inner.max().z();
+}
+
+// Collects the leaves in order, checking each interior node bounds everything
+// beneath it. Returns the bounds of the primitives under the node.
+struct LeafCollector {
+  const std::vector<fp::Primitive> &primitives;
+  std::vector<fp::BvhLeaf> &leaves;
+
+  Aabb operator()(const fp::BvhLeaf &leaf) const {
+    leaves.push_back(leaf);
+    Aabb bounds;
+    for (auto i = leaf.begin; i < leaf.end; ++i)
+      bounds = bounds.including(boundsOf(primitives[i]));
+    return bounds;
+  }
+
+  Aabb operator()(const fp::BvhInterior &interior) const {
+    const auto left = std::visit(*this, *interior.left);
+    const auto right = std::visit(*this, *interior.right);
+    CHECK(contains(interior.bounds, left));
+    CHECK(contains(interior.bounds, right));
+    return left.including(right);
+  }
+};
+
+TEST_CASE("BVH", "[Bvh]") {
+  // Rolling terrain with a flat border, under a scattering of balls. The
+  // border's triangles have flat boxes, which rays skimming it lie in.
+  auto height = [](int x, int z) {
+    if (std::abs(x) >= 7 || std::abs(z) >= 7)
+      return 0.0;
+    return std::sin(x * 0.7) * std::cos(z * 0.5);
+  };
+  fp::Scene scene;
+  for (int x = -8; x < 8; ++x)
+    for (int z = -8; z < 8; ++z) {
+      const auto corner = [&](int dx, int dz) {
+        return Vec3(x + dx, height(x + dx, z + dz), z + dz);
+      };
+      scene.primitives.emplace_back(fp::TrianglePrimitive{
+          fp::Triangle(corner(0, 0), corner(1, 0), corner(0, 1)),
+          MaterialSpec::makeDiffuse(Vec3(x, z, 0))});
+      scene.primitives.emplace_back(fp::TrianglePrimitive{
+          fp::Triangle(corner(1, 0), corner(1, 1), corner(0, 1)),
+          MaterialSpec::makeDiffuse(Vec3(x, z, 1))});
+    }
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<> across(-8, 8);
+  std::uniform_real_distribution<> unit(0, 1);
+  for (int i = 0; i < 40; ++i)
+    scene.primitives.emplace_back(fp::SpherePrimitive{
+        fp::Sphere(Vec3(across(rng), 2 + unit(rng) * 2, across(rng)),
+                   0.2 + unit(rng) * 0.5),
+        MaterialSpec::makeDiffuse(Vec3(0, 0, i + 2))});
+  const auto bvh = fp::buildBvh(scene.primitives);
+
+  // Rain falling at a slant onto the terrain, and rays along the border.
+  std::vector<Ray> rays;
+  for (int i = 0; i < 1000; ++i) {
+    const auto from = Vec3(across(rng) * 2, 10, across(rng) * 2);
+    const auto to = Vec3(across(rng), 0, across(rng));
+    rays.emplace_back(Ray::fromTwoPoints(from, to));
+  }
+  for (double z = -7.75; z < 8; z += 0.5)
+    rays.emplace_back(Ray::fromTwoPoints(Vec3(-20, 0, z), Vec3(-8, 0, z)));
+
+  SECTION("finds the same intersections as brute force") {
+    size_t numHits = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+      INFO("Ray " << i);
+      const auto expected = fp::intersect(scene, rays[i]);
+      const auto actual = fp::intersect(bvh, rays[i]);
+      REQUIRE(expected.has_value() == actual.has_value());
+      if (!expected)
+        continue;
+      numHits++;
+      CHECK(expected->hit.distance == actual->hit.distance);
+      CHECK(expected->hit.position == actual->hit.position);
+      CHECK(expected->hit.normal == actual->hit.normal);
+      CHECK(expected->material == actual->material);
+    }
+    // The rain all lands on the terrain, if not on a ball first.
+    CHECK(numHits >= 1000);
+  }
+
+  SECTION("finds occluders wherever intersect() finds a nearer hit") {
+    for (size_t i = 0; i < rays.size(); ++i) {
+      INFO("Ray " << i);
+      for (auto maxDistance : {5.0, 15.0}) {
+        const auto nearest = fp::intersect(scene, rays[i]);
+        const bool expected = nearest && nearest->hit.distance < maxDistance;
+        CHECK(fp::occluded(bvh, rays[i], maxDistance) == expected);
+      }
+    }
+  }
+
+  SECTION("leaves are small, and between them span every primitive once") {
+    std::vector<fp::BvhLeaf> leaves;
+    std::visit(LeafCollector{*bvh.primitives, leaves}, *bvh.root);
+    size_t next = 0;
+    for (auto &leaf : leaves) {
+      CHECK(leaf.begin == next);
+      CHECK(leaf.end > leaf.begin);
+      CHECK(leaf.end - leaf.begin <= 4);
+      next = leaf.end;
+    }
+    CHECK(next == scene.primitives.size());
+
+    auto materials = [](const std::vector<fp::Primitive> &primitives) {
+      std::vector<Vec3> diffuse;
+      for (auto &primitive : primitives)
+        diffuse.push_back(materialOf(primitive).diffuse);
+      std::sort(diffuse.begin(), diffuse.end(),
+                [](const Vec3 &lhs, const Vec3 &rhs) {
+                  return std::make_tuple(lhs.x(), lhs.y(), lhs.z())
+                         < std::make_tuple(rhs.x(), rhs.y(), rhs.z());
+                });
+      return diffuse;
+    };
+    CHECK(materials(*bvh.primitives) == materials(scene.primitives));
+  }
+
+  SECTION("copies share structure") {
+    const auto copy = bvh;
+    CHECK(copy.root == bvh.root);
+    CHECK(copy.primitives == bvh.primitives);
+  }
+
+  SECTION("handles empty scenes") {
+    for (const auto &empty : {fp::buildBvh({}), fp::Bvh()}) {
+      CHECK(!fp::intersect(empty, rays.front()));
+      CHECK(!fp::occluded(empty, rays.front(), 100));
+    }
+  }
+}
+
+}
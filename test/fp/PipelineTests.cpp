@@ -0,0 +1,95 @@
+#include <catch2/catch.hpp>
+
+#include "fp/Pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <range/v3/all.hpp>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+auto append = [](std::vector<int> acc, int value) {
+  acc.emplace_back(value);
+  return acc;
+};
+
+}
+
+TEST_CASE("Pipeline", "[Pipeline]") {
+  using fp::foldAsCompleted;
+  using ranges::views::ints;
+
+  SECTION("folds every result once") {
+    const auto maxInFlight = GENERATE(1, 3, 16);
+    auto result = foldAsCompleted(
+        ints(0, 10), maxInFlight, [](int x) { return x * x; },
+        std::vector<int>(), append, [](const auto &) {});
+    std::sort(result.begin(), result.end());
+    CHECK(result == std::vector<int>{0, 1, 4, 9, 16, 25, 36, 49, 64, 81});
+  }
+
+  SECTION("observes each accumulation") {
+    std::vector<size_t> sizes;
+    foldAsCompleted(
+        ints(0, 4), 2, [](int x) { return x; }, std::vector<int>(), append,
+        [&](const std::vector<int> &acc) { sizes.emplace_back(acc.size()); });
+    CHECK(sizes == std::vector<size_t>{1, 2, 3, 4});
+  }
+
+  SECTION("keeps no more than maxInFlight running") {
+    std::atomic<int> running{0};
+    std::atomic<int> maxRunning{0};
+    foldAsCompleted(
+        ints(0, 20), 3,
+        [&](int x) {
+          const auto now = ++running;
+          for (auto seen = maxRunning.load();
+               now > seen && !maxRunning.compare_exchange_weak(seen, now);)
+            ;
+          std::this_thread::sleep_for(1ms);
+          --running;
+          return x;
+        },
+        std::vector<int>(), append, [](const auto &) {});
+    CHECK(maxRunning <= 3);
+  }
+
+  SECTION("folds a quick result without waiting for a slow one") {
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    std::vector<int> observed;
+    auto result = foldAsCompleted(
+        ints(0, 2), 2,
+        [&](int x) {
+          if (x == 0)
+            released.wait();
+          return x;
+        },
+        std::vector<int>(), append,
+        [&](const std::vector<int> &acc) {
+          observed.emplace_back(acc.back());
+          if (acc.size() == 1)
+            release.set_value();
+        });
+    CHECK(observed == std::vector<int>{1, 0});
+  }
+
+  SECTION("rethrows an exception") {
+    CHECK_THROWS_AS(foldAsCompleted(
+                        ints(0, 5), 2,
+                        [](int x) {
+                          if (x == 2)
+                            throw std::runtime_error("bad");
+                          return x;
+                        },
+                        std::vector<int>(), append, [](const auto &) {}),
+                    std::runtime_error);
+  }
+}
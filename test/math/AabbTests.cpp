@@ -0,0 +1,58 @@
+#include <catch2/catch.hpp>
+
+#include "math/Aabb.h"
+#include "math/Epsilon.h"
+
+#include <cmath>
+
+namespace {
+
+TEST_CASE("Bounding boxes", "[Aabb]") {
+  auto inf = std::numeric_limits<double>::infinity();
+  auto rayTest = [&](const Aabb &box, const Ray &ray, double nearerThan) {
+    return box.intersects(ray, Aabb::inverseDirection(ray), nearerThan);
+  };
+
+  SECTION("default constructs empty") {
+    CHECK(Aabb().empty());
+    CHECK(Aabb().surfaceArea() == 0);
+  }
+  SECTION("includes points and boxes") {
+    auto box = Aabb().including(Vec3(1, 2, 3));
+    CHECK(!box.empty());
+    CHECK(box.min() == Vec3(1, 2, 3));
+    CHECK(box.max() == Vec3(1, 2, 3));
+    box = box.including(Vec3(-1, 4, 3));
+    CHECK(box.min() == Vec3(-1, 2, 3));
+    CHECK(box.max() == Vec3(1, 4, 3));
+    box = box.including(Aabb(Vec3(0, 0, 0), Vec3(0, 0, 10)));
+    CHECK(box.min() == Vec3(-1, 0, 0));
+    CHECK(box.max() == Vec3(1, 4, 10));
+    CHECK(box.centre() == Vec3(0, 2, 5));
+    CHECK(box.longestAxis() == 2);
+  }
+  SECTION("surface area") {
+    CHECK(Aabb(Vec3(0, 0, 0), Vec3(1, 2, 3)).surfaceArea() == 22);
+  }
+  SECTION("intersects rays") {
+    Aabb box(Vec3(-1, -1, 9), Vec3(1, 1, 11));
+    CHECK(rayTest(box, Ray::fromTwoPoints(Vec3(), Vec3(0, 0, 1)), inf));
+    CHECK(!rayTest(box, Ray::fromTwoPoints(Vec3(), Vec3(0, 0, -1)), inf));
+    CHECK(!rayTest(box, Ray::fromTwoPoints(Vec3(), Vec3(0, 1, 0)), inf));
+    CHECK(!rayTest(box, Ray::fromTwoPoints(Vec3(), Vec3(0, 0, 1)), 8.9));
+    CHECK(rayTest(box, Ray::fromTwoPoints(Vec3(0, 0, 10), Vec3(0, 0, 1)), 0.1));
+  }
+  SECTION("intersects padded flat boxes with rays in their planes") {
+    auto flat = Aabb(Vec3(-1, -1, 3), Vec3(1, 1, 3)).expanded(Epsilon);
+    CHECK(flat.min() == Vec3(-1 - Epsilon, -1 - Epsilon, 3 - Epsilon));
+    CHECK(rayTest(flat, Ray::fromTwoPoints(Vec3(), Vec3(0, 0, 1)), inf));
+    CHECK(rayTest(flat, Ray::fromTwoPoints(Vec3(-5, 1, 3), Vec3(0, 1, 3)),
+                  inf));
+    CHECK(rayTest(flat, Ray::fromTwoPoints(Vec3(1, -5, 3), Vec3(1, 0, 3)),
+                  inf));
+    CHECK(!rayTest(flat, Ray::fromTwoPoints(Vec3(-5, 2, 3), Vec3(0, 2, 3)),
+                   inf));
+  }
+}
+
+}
@@ -0,0 +1,69 @@
+#include <catch2/catch.hpp>
+
+#include "math/Random.h"
+
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+template <typename Generator>
+double meanOf(Generator &&generator, int count) {
+  std::uniform_real_distribution<> unit;
+  double total = 0;
+  for (int i = 0; i < count; ++i)
+    total += unit(generator);
+  return total / count;
+}
+
+TEST_CASE("Random numbers", "[Random]") {
+  SECTION("PCG32 matches the reference implementation") {
+    // pcg32_srandom_r(&rng, 42u, 54u) in O'Neill's pcg32-demo.
+    Pcg32 rng(42, 54);
+    const std::vector<uint32_t> expected{0xa15c02b7, 0x7b47f409, 0xba1d3330,
+                                         0x83d2f293, 0xbfa4784b, 0xcbed606e};
+    for (auto value : expected)
+      CHECK(rng() == value);
+  }
+
+  SECTION("generators are uniform over [0, 1)") {
+    CHECK(meanOf(Pcg32(1), 100000) == Approx(0.5).epsilon(0.01));
+    CHECK(meanOf(Xoshiro256Plus(1), 100000) == Approx(0.5).epsilon(0.01));
+    CHECK(meanOf(Squares(1), 100000) == Approx(0.5).epsilon(0.01));
+  }
+
+  SECTION("generators repeat for the same seed") {
+    Xoshiro256Plus a(1234);
+    Xoshiro256Plus b(1234);
+    Xoshiro256Plus c(1235);
+    for (int i = 0; i < 10; ++i) {
+      const auto value = a();
+      CHECK(b() == value);
+      CHECK(c() != value);
+    }
+  }
+
+  SECTION("Squares can skip to any point") {
+    Squares rng(99);
+    std::vector<uint64_t> sequence;
+    for (int i = 0; i < 10; ++i)
+      sequence.emplace_back(rng());
+    Squares skipped(99);
+    skipped.discard(7);
+    CHECK(skipped() == sequence[7]);
+    CHECK(Squares(99, 3)() == sequence[3]);
+    CHECK(rng.at(5) == sequence[5]);
+  }
+
+  SECTION("each pixel and sample gets its own seed") {
+    std::set<uint64_t> seeds;
+    for (uint64_t pixel = 0; pixel < 100; ++pixel)
+      for (uint64_t sample = 0; sample < 100; ++sample)
+        seeds.emplace(sampleSeed(1, pixel, sample));
+    CHECK(seeds.size() == 100 * 100);
+    CHECK(sampleSeed(1, 2, 3) != sampleSeed(2, 2, 3));
+  }
+}
+
+}
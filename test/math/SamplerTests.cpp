@@ -0,0 +1,97 @@
+#include <catch2/catch.hpp>
+
+#include "math/Sampler.h"
+
+#include <cmath>
+#include <random>
+#include <set>
+
+namespace {
+
+// Which cell of an n x n grid the point falls in.
+int cellOf(std::pair<double, double> point, int n) {
+  return static_cast<int>(point.first * n) * n
+         + static_cast<int>(point.second * n);
+}
+
+// The mean error over many pixels of estimating the integral of a smooth
+// function over the unit square with the given number of samples.
+double meanError(SamplerKind kind, int numSamples) {
+  constexpr int NumPixels = 200;
+  double totalError = 0;
+  for (int pixel = 0; pixel < NumPixels; ++pixel) {
+    double total = 0;
+    for (int sample = 0; sample < numSamples; ++sample) {
+      Sampler sampler(kind, 1, pixel, sample);
+      const auto [u, v] = sampler.next2D();
+      total += std::sin(M_PI * u) * v * v;
+    }
+    totalError += std::abs(total / numSamples - 2 / (3 * M_PI));
+  }
+  return totalError / NumPixels;
+}
+
+TEST_CASE("Samplers", "[Sampler]") {
+  SECTION("a pixel's Sobol samples are stratified") {
+    for (int pixel = 0; pixel < 10; ++pixel) {
+      std::set<int> cells;
+      std::set<int> uIntervals;
+      for (int sample = 0; sample < 16; ++sample) {
+        Sampler sampler(SamplerKind::Sobol, 1234, pixel, sample);
+        // Past a pixel offset and an odd dimension, as a bounce would be.
+        for (int dimension = 0; dimension < 3; ++dimension)
+          sampler();
+        const auto point = sampler.next2D();
+        cells.emplace(cellOf(point, 4));
+        uIntervals.emplace(static_cast<int>(point.first * 16));
+      }
+      CHECK(cells.size() == 16);
+      CHECK(uIntervals.size() == 16);
+    }
+  }
+
+  SECTION("Sobol branches are stratified between them") {
+    Sampler sampler(SamplerKind::Sobol, 1234, 5, 3);
+    std::set<int> cells;
+    for (uint32_t branch = 0; branch < 16; ++branch)
+      cells.emplace(cellOf(
+          sampler.branch(branch, 16).stratified2D(branch / 4, 4, branch % 4, 4),
+          4));
+    CHECK(cells.size() == 16);
+  }
+
+  SECTION("random branches are jittered in their cells") {
+    Sampler sampler(SamplerKind::Random, 1234, 5, 3);
+    for (int branch = 0; branch < 16; ++branch) {
+      const auto point = sampler.branch(branch, 16).stratified2D(
+          branch / 4, 4, branch % 4, 4);
+      CHECK(cellOf(point, 4) == branch);
+    }
+  }
+
+  SECTION("samplers repeat") {
+    for (auto kind : {SamplerKind::Random, SamplerKind::Sobol}) {
+      Sampler a(kind, 99, 12, 7);
+      Sampler b(kind, 99, 12, 7);
+      for (int i = 0; i < 10; ++i)
+        CHECK(a.next1D() == b.next1D());
+    }
+  }
+
+  SECTION("work with the standard distributions") {
+    Sampler sampler(SamplerKind::Sobol, 1, 2, 3);
+    std::uniform_real_distribution<> angle(0, 2 * M_PI);
+    for (int i = 0; i < 100; ++i) {
+      const auto value = angle(sampler);
+      REQUIRE(value >= 0);
+      REQUIRE(value < 2 * M_PI);
+    }
+  }
+
+  SECTION("Sobol converges faster than random") {
+    CHECK(meanError(SamplerKind::Sobol, 64)
+          < meanError(SamplerKind::Random, 64) / 4);
+  }
+}
+
+}
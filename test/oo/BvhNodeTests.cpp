@@ -0,0 +1,288 @@
+#include <catch2/catch.hpp>
+
+#include "oo/BvhNode.h"
+#include "oo/SceneBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <random>
+#include <set>
+#include <vector>
+
+using oo::BvhNode;
+using oo::Primitive;
+using oo::SceneBuilder;
+
+namespace {
+
+// A primitive that is never hit, but counts how often it's asked.
+struct Probe : Primitive {
+  Aabb box;
+  mutable int visits{};
+
+  explicit Probe(const Aabb &box) : box(box) {}
+
+  bool intersect(const Ray &, IntersectionRecord &) const override {
+    ++visits;
+    return false;
+  }
+  bool occluded(const Ray &, double) const override {
+    ++visits;
+    return false;
+  }
+  Aabb bounds() const override { return box; }
+};
+
+// How far along the ray it enters the box, if it does at all.
+std::optional<double> entryDistance(const Aabb &box, const Ray &ray) {
+  const auto inverseDirection = Aabb::inverseDirection(ray);
+  const auto t0 = (box.min() - ray.origin()) * inverseDirection;
+  const auto t1 = (box.max() - ray.origin()) * inverseDirection;
+  const auto tNear =
+      std::max({0.0, std::min(t0.x(), t1.x()), std::min(t0.y(), t1.y()),
+                std::min(t0.z(), t1.z())});
+  const auto tFar = std::min({std::max(t0.x(), t1.x()),
+                              std::max(t0.y(), t1.y()),
+                              std::max(t0.z(), t1.z())});
+  if (tNear > tFar)
+    return std::nullopt;
+  return tNear;
+}
+
+// A primitive hit where the ray enters its box. It counts the times it's
+// asked about a ray that has already hit something nearer than it, which a
+// hierarchy ought to have culled it for.
+struct Block : Primitive {
+  Aabb box;
+  double &nearestSoFar;
+  int &numTooFar;
+
+  Block(const Aabb &box, double &nearestSoFar, int &numTooFar)
+      : box(box), nearestSoFar(nearestSoFar), numTooFar(numTooFar) {}
+
+  bool intersect(const Ray &ray, IntersectionRecord &record) const override {
+    const auto entry = entryDistance(box, ray);
+    if (!entry)
+      return false;
+    // Allowing for the padding of the boxes the hierarchy holds.
+    if (*entry > nearestSoFar + 0.000001)
+      ++numTooFar;
+    nearestSoFar = std::min(nearestSoFar, *entry);
+    record.hit.distance = *entry;
+    return true;
+  }
+  bool occluded(const Ray &ray, double maxDistance) const override {
+    const auto entry = entryDistance(box, ray);
+    return entry && *entry < maxDistance;
+  }
+  Aabb bounds() const override { return box; }
+};
+
+bool contains(const Aabb &outer, const Aabb &inner) {
+  return outer.min().x() <= inner.min().x()
+         && outer.min().y() <= inner.min().y()
+         && outer.min().z() <= inner.min().z()
+         && outer.max().x() >= inner.max().x()
+         && outer.max().y() >= inner.max().y()
+         && outer.max().z() >= inner.max().z();
+}
+
+// Checks every node's children lie within it, and collects the leaves.
+void walk(const Primitive &node, std::vector<const Primitive *> &leaves) {
+  const auto *interior = dynamic_cast<const BvhNode *>(&node);
+  if (!interior) {
+    leaves.push_back(&node);
+    return;
+  }
+  for (int child = 0; child < 2; ++child) {
+    CHECK(contains(interior->bounds(), interior->child(child).bounds()));
+    walk(interior->child(child), leaves);
+  }
+}
+
+TEST_CASE("BVH nodes", "[BvhNode]") {
+  // A 10x10x10 lattice of unit cubes, a cube's width apart.
+  std::vector<std::unique_ptr<Primitive>> probes;
+  for (int x = 0; x < 10; ++x)
+    for (int y = 0; y < 10; ++y)
+      for (int z = 0; z < 10; ++z) {
+        const auto corner = Vec3(x, y, z) * 2;
+        probes.emplace_back(
+            std::make_unique<Probe>(Aabb(corner, corner + Vec3(1, 1, 1))));
+      }
+  std::set<const Primitive *> all;
+  for (auto &probe : probes)
+    all.insert(probe.get());
+
+  SECTION("are not made for no primitives") {
+    CHECK(!BvhNode::build({}));
+  }
+
+  SECTION("leave a lone primitive as it is") {
+    auto *lone = probes.front().get();
+    std::vector<std::unique_ptr<Primitive>> justOne;
+    justOne.emplace_back(std::move(probes.front()));
+    CHECK(BvhNode::build(std::move(justOne)).get() == lone);
+  }
+
+  SECTION("hold each primitive as its own leaf, inside its parents") {
+    const auto root = BvhNode::build(std::move(probes));
+    std::vector<const Primitive *> leaves;
+    walk(*root, leaves);
+    CHECK(leaves.size() == all.size());
+    CHECK(std::set<const Primitive *>(leaves.begin(), leaves.end()) == all);
+  }
+
+  SECTION("visit only the primitives near a ray") {
+    const auto root = BvhNode::build(std::move(probes));
+    // Straight down the column of cubes at x = y = 0.
+    const auto ray = Ray::fromTwoPoints(Vec3(0.5, 0.5, -5), Vec3(0.5, 0.5, 0));
+    Primitive::IntersectionRecord record;
+    CHECK(!root->intersect(ray, record));
+    CHECK(!root->occluded(ray, 100));
+    int visits = 0;
+    for (auto *probe : all)
+      visits += static_cast<const Probe *>(probe)->visits;
+    // Each of the column's ten cubes is asked twice; nothing else should be.
+    CHECK(visits == 20);
+  }
+}
+
+TEST_CASE("BVH node culling", "[BvhNode]") {
+  // Boxes of all sizes, piled up over each other, shot at from all around.
+  // Which side of a split a ray comes from says little about which box it
+  // meets first.
+  double nearestSoFar{};
+  int numTooFar = 0;
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<> unit(0, 1);
+  std::vector<std::unique_ptr<Primitive>> blocks;
+  std::vector<Aabb> boxes;
+  for (int i = 0; i < 500; ++i) {
+    const auto corner = Vec3(unit(rng), unit(rng), unit(rng)) * 20;
+    const auto size = Vec3(unit(rng), unit(rng), unit(rng)) * 4;
+    boxes.emplace_back(corner, corner + size);
+    blocks.emplace_back(
+        std::make_unique<Block>(boxes.back(), nearestSoFar, numTooFar));
+  }
+  const auto root = BvhNode::build(std::move(blocks));
+
+  size_t numHits = 0;
+  for (int i = 0; i < 1000; ++i) {
+    const auto from =
+        Vec3(unit(rng) - 0.5, unit(rng) - 0.5, unit(rng) - 0.5) * 80;
+    const auto to = Vec3(unit(rng), unit(rng), unit(rng)) * 20;
+    const auto ray = Ray::fromTwoPoints(from, to);
+    INFO("Ray " << i);
+    auto expected = std::numeric_limits<double>::infinity();
+    for (const auto &box : boxes)
+      expected = std::min(expected, entryDistance(box, ray).value_or(expected));
+
+    nearestSoFar = std::numeric_limits<double>::infinity();
+    Primitive::IntersectionRecord record;
+    REQUIRE(root->intersect(ray, record) == std::isfinite(expected));
+    if (!std::isfinite(expected))
+      continue;
+    ++numHits;
+    CHECK(record.hit.distance == expected);
+
+    // Nothing is found beyond the distance asked about.
+    nearestSoFar = std::numeric_limits<double>::infinity();
+    const auto &node = static_cast<const BvhNode &>(*root);
+    CHECK(!node.intersect(ray, record, expected));
+    nearestSoFar = std::numeric_limits<double>::infinity();
+    CHECK(node.intersect(ray, record, expected + 1));
+    CHECK(record.hit.distance == expected);
+  }
+  // Only the cubes the ray could still reach once it's hit one are asked.
+  CHECK(numTooFar == 0);
+  CHECK(numHits > 100);
+}
+
+TEST_CASE("BVH scenes", "[BvhNode]") {
+  // Balls scattered over a floor of tiles. The tiles are flat, so their boxes
+  // have no height, and rays skimming the floor lie in their planes.
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<> unit(0, 1);
+  SceneBuilder bruteForce;
+  SceneBuilder withBvh;
+  for (int x = -5; x < 5; ++x)
+    for (int z = -5; z < 5; ++z) {
+      const auto mat = MaterialSpec::makeDiffuse(Vec3(x, 0, z));
+      const auto v0 = Vec3(x, 0, z);
+      const auto v1 = Vec3(x + 1, 0, z);
+      const auto v2 = Vec3(x, 0, z + 1);
+      bruteForce.addTriangle(v0, v1, v2, mat);
+      withBvh.addTriangle(v0, v1, v2, mat);
+    }
+  for (int i = 0; i < 200; ++i) {
+    const auto centre =
+        Vec3(unit(rng) * 10 - 5, unit(rng) * 4, unit(rng) * 10 - 5);
+    const auto radius = 0.1 + unit(rng) * 0.3;
+    const auto mat = MaterialSpec::makeDiffuse(Vec3(0, i, 0));
+    bruteForce.addSphere(centre, radius, mat);
+    withBvh.addSphere(centre, radius, mat);
+  }
+  withBvh.buildBvh();
+
+  // From all around, aimed into the scene, plus a few along the floor.
+  std::vector<Ray> rays;
+  for (int i = 0; i < 1000; ++i) {
+    const auto from =
+        Vec3(unit(rng) - 0.5, unit(rng) - 0.5, unit(rng) - 0.5) * 40;
+    const auto to = Vec3(unit(rng) * 10 - 5, unit(rng) * 4, unit(rng) * 10 - 5);
+    rays.emplace_back(Ray::fromTwoPoints(from, to));
+  }
+  for (double z = -4.75; z < 5; z += 0.5)
+    rays.emplace_back(Ray::fromTwoPoints(Vec3(-8, 0, z), Vec3(0, 0, z)));
+
+  SECTION("bound the scene") {
+    CHECK(contains(withBvh.scene().bounds(), bruteForce.scene().bounds()));
+  }
+
+  SECTION("find the same intersections as brute force") {
+    size_t numHits = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+      INFO("Ray " << i);
+      Primitive::IntersectionRecord expected;
+      Primitive::IntersectionRecord actual;
+      const auto expectedHit = bruteForce.scene().intersect(rays[i], expected);
+      const auto actualHit = withBvh.scene().intersect(rays[i], actual);
+      REQUIRE(expectedHit == actualHit);
+      if (!expectedHit)
+        continue;
+      numHits++;
+      CHECK(expected.hit.distance == actual.hit.distance);
+      CHECK(expected.hit.position == actual.hit.position);
+      CHECK(expected.hit.normal == actual.hit.normal);
+      CHECK(expected.material->previewColour()
+            == actual.material->previewColour());
+    }
+    // Most rays are aimed at the scene, so a good share should hit.
+    CHECK(numHits > rays.size() / 4);
+  }
+
+  SECTION("find occluders wherever intersect() finds a nearer hit") {
+    for (size_t i = 0; i < rays.size(); ++i) {
+      INFO("Ray " << i);
+      for (auto maxDistance : {5.0, 25.0}) {
+        Primitive::IntersectionRecord nearest;
+        const bool expected = bruteForce.scene().intersect(rays[i], nearest)
+                              && nearest.hit.distance < maxDistance;
+        CHECK(withBvh.scene().occluded(rays[i], maxDistance) == expected);
+      }
+    }
+  }
+
+  SECTION("are left alone when there's nothing to build over") {
+    SceneBuilder empty;
+    empty.buildBvh();
+    Primitive::IntersectionRecord record;
+    CHECK(!empty.scene().intersect(rays.front(), record));
+    CHECK(!empty.scene().occluded(rays.front(), 100));
+  }
+}
+
+}
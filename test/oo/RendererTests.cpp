@@ -1,9 +1,11 @@
 #include "oo/Renderer.h"
+#include "oo/SceneBuilder.h"
 
 #include <catch2/catch.hpp>
 #include <iostream>
 
 using oo::Renderer;
+using oo::SceneBuilder;
 
 namespace {
 
@@ -28,4 +30,78 @@ TEST_CASE("Renderer", "[Renderer]") {
   }
 }
 
-}
\ No newline at end of file
+// The radiance of the rendered image, averaged over its pixels.
+Vec3 meanRadiance(const oo::Scene &scene, const Camera &camera,
+                  const RenderParams &params) {
+  const auto output =
+      Renderer(scene, camera, params).render([](const ArrayOutput &) {});
+  Vec3 total;
+  for (int y = 0; y < params.height; ++y)
+    for (int x = 0; x < params.width; ++x)
+      total += output.rawPixelAt(x, y);
+  return total / (params.width * params.height);
+}
+
+// For renders that sample differently, so only their expectations match.
+void checkSameMean(const Vec3 &actual, const Vec3 &expected, double epsilon) {
+  CHECK(actual.x() == Approx(expected.x()).epsilon(epsilon));
+  CHECK(actual.y() == Approx(expected.y()).epsilon(epsilon));
+  CHECK(actual.z() == Approx(expected.z()).epsilon(epsilon));
+}
+
+TEST_CASE("Russian roulette", "[Renderer]") {
+  SceneBuilder builder;
+  builder.setEnvironmentColour(Vec3(0.1, 0.1, 0.1));
+  builder.addSphere(Vec3(-1, 0, 0), 1,
+                    MaterialSpec::makeDiffuse(Vec3(0.8, 0.5, 0.2)));
+  builder.addSphere(Vec3(1, 0, 0), 1,
+                    MaterialSpec::makeReflective(Vec3(0.5, 0.5, 0.5), 0.5, 10));
+  builder.addSphere(Vec3(0, 3, 0), 1, MaterialSpec::makeLight(Vec3(4, 4, 4)));
+  builder.addTriangle(Vec3(-10, -1, -10), Vec3(10, -1, -10), Vec3(0, -1, 10),
+                      MaterialSpec::makeDiffuse(Vec3(0.7, 0.7, 0.7)));
+  builder.buildBvh();
+
+  RenderParams params;
+  params.width = 24;
+  params.height = 16;
+  params.samplesPerPixel = 16;
+  params.maxDepth = 12;
+  params.seed = 8765;
+  Camera camera(Vec3(0, 1, -8), Vec3(0, 0, 0), Norm3::yAxis(), params.width,
+                params.height, 40);
+
+  // Ending paths at random changes the noise, but not what it converges to.
+  const auto full = meanRadiance(builder.scene(), camera, params);
+  params.rouletteDepth = 2;
+  checkSameMean(meanRadiance(builder.scene(), camera, params), full, 0.03);
+}
+
+TEST_CASE("Next event estimation", "[Renderer]") {
+  SceneBuilder builder;
+  builder.setEnvironmentColour(Vec3(0.1, 0.1, 0.1));
+  builder.addSphere(Vec3(-1, 0, 0), 1,
+                    MaterialSpec::makeDiffuse(Vec3(0.8, 0.5, 0.2)));
+  builder.addSphere(Vec3(1, 0, 0), 1,
+                    MaterialSpec::makeReflective(Vec3(0.5, 0.5, 0.5), 0.5, 10));
+  builder.addSphere(Vec3(0, 3, 0), 1, MaterialSpec::makeLight(Vec3(4, 4, 4)));
+  builder.addSphere(Vec3(2, 3, -2), 0.5,
+                    MaterialSpec::makeLight(Vec3(8, 2, 2)));
+  builder.addTriangle(Vec3(-10, -1, -10), Vec3(10, -1, -10), Vec3(0, -1, 10),
+                      MaterialSpec::makeDiffuse(Vec3(0.7, 0.7, 0.7)));
+  builder.buildBvh();
+
+  RenderParams params;
+  params.width = 24;
+  params.height = 16;
+  params.samplesPerPixel = 16;
+  params.seed = 5678;
+  Camera camera(Vec3(0, 1, -8), Vec3(0, 0, 0), Norm3::yAxis(), params.width,
+                params.height, 40);
+
+  // Aiming at the lights changes the noise, but not what it converges to.
+  const auto byChance = meanRadiance(builder.scene(), camera, params);
+  params.nextEvent = true;
+  checkSameMean(meanRadiance(builder.scene(), camera, params), byChance, 0.03);
+}
+
+}
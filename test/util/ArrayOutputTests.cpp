@@ -38,3 +38,63 @@ TEST_CASE("ArrayOutput", "[ArrayOutput]") {
     }
   }
 }
+
+TEST_CASE("ArrayOutput render history", "[ArrayOutput]") {
+  char tempBuf[] = "/tmp/arrayoutputtestXXXXXXX";
+  auto result = mkstemp(tempBuf);
+  REQUIRE(result >= 0);
+  close(result);
+  ArrayOutput ao(3, 2);
+  ao.addSamples(2, 1, Vec3(0.2, 0.3, 0.4), 3);
+
+  SECTION("roundtrips through a file") {
+    ao.save(tempBuf, RenderHistory{"cornell", {12, -3}});
+    RenderHistory history;
+    auto loaded = ArrayOutput::load(tempBuf, history);
+    CHECK(history.sceneName == "cornell");
+    CHECK(history.seeds == std::vector<int>{12, -3});
+    CHECK(history.used(-3));
+    CHECK_FALSE(history.used(3));
+    CHECK(loaded.rawPixelAt(2, 1) == ao.rawPixelAt(2, 1));
+    CHECK(loaded.totalSamples() == 3);
+  }
+
+  SECTION("is empty for files saved before histories were kept") {
+    FILE *f = fopen(tempBuf, "wb");
+    REQUIRE(f);
+    const uint32_t header[] = {1, 1, 2, 3};
+    fwrite(header, sizeof(header), 1, f);
+    const uint32_t numSamples = 3;
+    for (int pixel = 0; pixel < 6; ++pixel) {
+      const auto colour = pixel == 5 ? Vec3(0.2, 0.3, 0.4) : Vec3();
+      fwrite(&colour, sizeof(colour), 1, f);
+      fwrite(&numSamples, sizeof(numSamples), 1, f);
+    }
+    fclose(f);
+    RenderHistory history{"cornell", {1}};
+    auto loaded = ArrayOutput::load(tempBuf, history);
+    CHECK(history.sceneName.empty());
+    CHECK(history.seeds.empty());
+    CHECK(loaded.rawPixelAt(2, 1) == ao.rawPixelAt(2, 1));
+  }
+  unlink(tempBuf);
+}
+
+TEST_CASE("ArrayOutput RMS error", "[ArrayOutput]") {
+  ArrayOutput reference(2, 1);
+  reference.addSamples(0, 0, Vec3(0.5, 0.5, 0.5), 1);
+  reference.addSamples(1, 0, Vec3(2, 2, 2), 2);
+  SECTION("is zero against itself") {
+    CHECK(reference.rmsError(reference) == 0);
+  }
+  SECTION("compares averages, clamped as displayed") {
+    ArrayOutput ao(2, 1);
+    ao.addSamples(0, 0, Vec3(0.2, 1.0, 2.4), 2);
+    ao.addSamples(1, 0, Vec3(3, 3, 3), 1);
+    // Pixel differences of 0.4, 0 and 0.5, then nothing, as both are white.
+    CHECK(ao.rmsError(reference) == Approx(sqrt((0.16 + 0.25) / 6)));
+  }
+  SECTION("needs the same size") {
+    CHECK_THROWS(ArrayOutput(1, 2).rmsError(reference));
+  }
+}
@@ -0,0 +1,69 @@
+#include <catch2/catch.hpp>
+
+#include "util/AsyncSaver.h"
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("AsyncSaver", "[AsyncSaver]") {
+  auto snapshotWith = [](int samples) {
+    auto output = std::make_shared<ArrayOutput>(2, 2);
+    output->addSamples(0, 0, Vec3(1, 1, 1), samples);
+    return output;
+  };
+
+  SECTION("saves what's posted") {
+    std::vector<size_t> saved;
+    {
+      std::promise<void> savedOne;
+      AsyncSaver saver([&](const ArrayOutput &output) {
+        saved.emplace_back(output.totalSamples());
+        savedOne.set_value();
+      });
+      saver.post(snapshotWith(3));
+      savedOne.get_future().wait();
+      // The save has begun, but may not have been counted until it finishes.
+      saver.stop();
+      CHECK(saver.numSaved() == 1);
+    }
+    CHECK(saved == std::vector<size_t>{3});
+  }
+
+  SECTION("drops stale snapshots without waiting for a slow save") {
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    std::promise<void> started;
+    std::vector<size_t> saved;
+    AsyncSaver saver([&](const ArrayOutput &output) {
+      if (saved.empty()) {
+        started.set_value();
+        released.wait();
+      }
+      saved.emplace_back(output.totalSamples());
+    });
+    saver.post(snapshotWith(1));
+    started.get_future().wait();
+    // The writer is stuck in the first save; none of these may block.
+    const auto before = std::chrono::steady_clock::now();
+    for (int samples = 2; samples <= 10; ++samples)
+      saver.post(snapshotWith(samples));
+    CHECK(std::chrono::steady_clock::now() - before < 1s);
+    release.set_value();
+    while (saver.numSaved() < 2)
+      std::this_thread::sleep_for(1ms);
+    saver.stop();
+    CHECK(saver.numDropped() == 8);
+    CHECK(saved == std::vector<size_t>{1, 10});
+  }
+
+  SECTION("stopping drops anything pending") {
+    AsyncSaver saver([](const ArrayOutput &) {});
+    saver.stop();
+    saver.post(snapshotWith(1));
+    CHECK(saver.numSaved() == 0);
+  }
+}
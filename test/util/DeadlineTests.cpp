@@ -0,0 +1,51 @@
+#include <catch2/catch.hpp>
+
+#include "util/Deadline.h"
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("Deadline", "[Deadline]") {
+  using namespace std::chrono_literals;
+
+  SECTION("never passes without a budget") {
+    const Deadline deadline;
+    CHECK_FALSE(deadline);
+    CHECK_FALSE(deadline.passed());
+  }
+
+  SECTION("passes once the budget is spent") {
+    const Deadline deadline(50ms);
+    CHECK(deadline);
+    CHECK(deadline.budgetMs() == 50);
+    CHECK_FALSE(deadline.passed());
+    std::this_thread::sleep_for(50ms);
+    CHECK(deadline.passed());
+    CHECK(deadline.elapsedMs() >= 50);
+  }
+
+  SECTION("takes fractions of a second") {
+    CHECK(Deadline(std::chrono::duration<double>(1.5)).budgetMs() == 1500);
+  }
+}
+
+TEST_CASE("Rows before a deadline", "[Deadline]") {
+  using namespace std::chrono_literals;
+  std::vector<int> rows;
+  auto addRow = [&](int row) { rows.push_back(row); };
+
+  SECTION("are all visited without a budget") {
+    forEachRow(Deadline(), 10, 4, addRow);
+    CHECK(rows == std::vector<int>{0, 4, 8});
+  }
+
+  SECTION("are left out once the budget is spent") {
+    const Deadline deadline(20ms);
+    forEachRow(deadline, 10, 1, [&](int row) {
+      addRow(row);
+      if (row == 2)
+        std::this_thread::sleep_for(20ms);
+    });
+    CHECK(rows == std::vector<int>{0, 1, 2});
+  }
+}
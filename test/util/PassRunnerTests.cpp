@@ -0,0 +1,73 @@
+#include <catch2/catch.hpp>
+
+#include "util/PassRunner.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST_CASE("PassRunner", "[PassRunner]") {
+  SECTION("hands back every pass exactly once") {
+    const auto numThreads = GENERATE(1, 3, 16);
+    std::vector<int> done;
+    runPasses(
+        10, numThreads, [](int pass) { return pass; },
+        [&](int pass) { done.emplace_back(pass); });
+    std::sort(done.begin(), done.end());
+    CHECK(done == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+  }
+
+  SECTION("hands results back on the calling thread") {
+    const auto caller = std::this_thread::get_id();
+    std::vector<std::thread::id> renderedOn;
+    std::vector<std::thread::id> doneOn;
+    runPasses(
+        8, 4, [](int) { return std::this_thread::get_id(); },
+        [&](std::thread::id renderer) {
+          renderedOn.emplace_back(renderer);
+          doneOn.emplace_back(std::this_thread::get_id());
+        });
+    CHECK(std::count(doneOn.begin(), doneOn.end(), caller) == 8);
+    CHECK(std::count(renderedOn.begin(), renderedOn.end(), caller) == 0);
+  }
+
+  SECTION("does nothing with no passes") {
+    int numDone = 0;
+    runPasses(
+        0, 4, [](int pass) { return pass; }, [&](int) { numDone++; });
+    CHECK(numDone == 0);
+  }
+
+  SECTION("starts no passes once the deadline has passed") {
+    using namespace std::chrono_literals;
+    int numDone = 0;
+    runPasses(
+        10, 2, [](int pass) { return pass; }, [&](int) { numDone++; },
+        Deadline(0s));
+    CHECK(numDone == 0);
+    const Deadline deadline(50ms);
+    runPasses(
+        std::numeric_limits<int>::max(), 2,
+        [](int pass) {
+          std::this_thread::sleep_for(1ms);
+          return pass;
+        },
+        [&](int) { numDone++; }, deadline);
+    CHECK(deadline.passed());
+    CHECK(numDone > 0);
+  }
+
+  SECTION("rethrows a pass's exception") {
+    CHECK_THROWS_AS(runPasses(
+                        10, 2,
+                        [](int pass) {
+                          if (pass == 3)
+                            throw std::runtime_error("bad pass");
+                          return pass;
+                        },
+                        [](int) {}),
+                    std::runtime_error);
+  }
+}
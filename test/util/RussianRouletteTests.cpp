@@ -0,0 +1,55 @@
+#include <catch2/catch.hpp>
+
+#include "util/RussianRoulette.h"
+
+namespace {
+
+TEST_CASE("Russian roulette", "[RussianRoulette]") {
+  RenderParams params;
+  params.firstBounceUSamples = 2;
+  params.firstBounceVSamples = 2;
+  const auto throughput = Vec3(0.1, 0.05, 0.02);
+
+  SECTION("leaves paths alone when off, or before its depth") {
+    for (auto rouletteDepth : {0, 3}) {
+      params.rouletteDepth = rouletteDepth;
+      Sampler sampler(SamplerKind::Random, 1, 2, 3);
+      auto untouched = sampler;
+      CHECK(russianRoulette(sampler, throughput, 2, params) == throughput);
+      // Nothing was drawn.
+      CHECK(sampler.next1D() == untouched.next1D());
+    }
+  }
+
+  SECTION("keeps paths bright enough to always carry on") {
+    params.rouletteDepth = 1;
+    Sampler sampler(SamplerKind::Random, 1, 2, 3);
+    CHECK(russianRoulette(sampler, Vec3(0.25, 0.1, 0), 1, params)
+          == Vec3(0.25, 0.1, 0));
+    CHECK_FALSE(russianRoulette(sampler, Vec3(), 1, params));
+  }
+
+  SECTION("ends dim paths, but not what they add up to") {
+    params.rouletteDepth = 1;
+    constexpr int NumPaths = 100000;
+    int numSurvivors = 0;
+    Vec3 total;
+    for (int path = 0; path < NumPaths; ++path) {
+      Sampler sampler(SamplerKind::Random, 1, path, 0);
+      if (const auto survivor =
+              russianRoulette(sampler, throughput, 5, params)) {
+        ++numSurvivors;
+        total += *survivor;
+      }
+    }
+    // The brightest component, less its share of the four first bounce
+    // samples.
+    CHECK(static_cast<double>(numSurvivors) / NumPaths
+          == Approx(0.4).epsilon(0.02));
+    CHECK(total.x() / NumPaths == Approx(throughput.x()).epsilon(0.02));
+    CHECK(total.y() / NumPaths == Approx(throughput.y()).epsilon(0.02));
+    CHECK(total.z() / NumPaths == Approx(throughput.z()).epsilon(0.02));
+  }
+}
+
+}
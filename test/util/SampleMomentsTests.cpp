@@ -0,0 +1,58 @@
+#include <catch2/catch.hpp>
+
+#include "math/ApproxVec3.h"
+#include "util/SampleMoments.h"
+
+TEST_CASE("SampleMoments", "[SampleMoments]") {
+  SampleMoments pixel;
+
+  SECTION("starts empty") {
+    CHECK(pixel.samples().numSamples() == 0);
+    CHECK(pixel.samples().result() == Vec3());
+    CHECK(pixel.variance() == Vec3());
+    CHECK(pixel.relativeError() == 0);
+  }
+
+  SECTION("tracks the variance of its samples") {
+    pixel.add(Vec3(1, 2, 3));
+    CHECK(pixel.variance() == Vec3());
+    pixel.add(Vec3(3, 2, 1));
+    pixel.add(Vec3(2, 2, 2));
+    CHECK(pixel.samples().numSamples() == 3);
+    CHECK(pixel.samples().result() == ApproxVec3(2, 2, 2));
+    CHECK(pixel.variance() == ApproxVec3(1, 0, 1));
+  }
+
+  SECTION("combines with other pixels' samples") {
+    SampleMoments other;
+    pixel.add(Vec3(1, 1, 1));
+    other.add(Vec3(3, 3, 3));
+    pixel.accumulate(other);
+    CHECK(pixel.samples().rawResult() == Vec3(4, 4, 4));
+    CHECK(pixel.rawSquares() == Vec3(10, 10, 10));
+    CHECK(pixel.variance() == ApproxVec3(2, 2, 2));
+  }
+
+  SECTION("can be rebuilt from the sums it keeps") {
+    pixel.add(Vec3(1, 2, 3));
+    pixel.add(Vec3(3, 2, 1));
+    const SampleMoments copy(pixel.samples(), pixel.rawSquares());
+    CHECK(copy.variance() == ApproxVec3(2, 0, 2));
+    CHECK(copy.relativeError() == Approx(pixel.relativeError()));
+  }
+
+  SECTION("measures its error against its brightness") {
+    for (int i = 0; i < 50; ++i) {
+      pixel.add(Vec3(3, 3, 3));
+      pixel.add(Vec3(5, 5, 5));
+    }
+    const auto standardError = sqrt(100.0 / 99 / 100);
+    CHECK(pixel.relativeError() == Approx(standardError / 2));
+    SampleMoments dark;
+    dark.add(Vec3(0.001, 0.001, 0.001));
+    dark.add(Vec3());
+    CHECK(dark.relativeError()
+          == Approx(sqrt(0.0005 * 0.0005 * 2 / 2)
+                    / sqrt(SampleMoments::NearBlack)));
+  }
+}
@@ -0,0 +1,82 @@
+#include <catch2/catch.hpp>
+
+#include "util/SphereLights.h"
+
+#include <optional>
+#include <random>
+
+TEST_CASE("SphereLights", "[SphereLights]") {
+  SphereLights lights;
+  lights.add(Vec3(0, 0, 0), 1, MaterialSpec::makeDiffuse(Vec3(1, 1, 1)));
+  CHECK(lights.empty());
+  lights.add(Vec3(0, 5, 0), 1, MaterialSpec::makeLight(Vec3(2, 2, 2)));
+  lights.add(Vec3(5, 0, 0), 2, MaterialSpec::makeLight(Vec3(3, 3, 3)));
+  REQUIRE(lights.size() == 2);
+
+  SECTION("samples directions that hit the chosen light") {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<> unit(0, 1);
+    const auto from = Vec3(0, 0, 0);
+    for (int i = 0; i < 1000; ++i) {
+      const auto sample = lights.sample(from, unit(rng), unit(rng), unit(rng));
+      REQUIRE(sample);
+      const bool nearer = sample->emission == Vec3(2, 2, 2);
+      const auto centre = nearer ? Vec3(0, 5, 0) : Vec3(5, 0, 0);
+      const auto radius = nearer ? 1.0 : 2.0;
+      CHECK(sample->distance >= 5 - radius - 0.000001);
+      CHECK(sample->distance <= 5);
+      CHECK((from + sample->direction * sample->distance - centre).length()
+            == Approx(radius));
+      CHECK(sample->pdf == Approx(sphereSamplePdf(from, centre, radius) / 2));
+      const auto ray = Ray(from, sample->direction);
+      CHECK(lights.pdf(ray, sample->distance) == Approx(sample->pdf));
+      CHECK(sample->shadowDistance() < sample->distance);
+      CHECK(sample->shadowDistance() == Approx(sample->distance));
+    }
+  }
+
+  SECTION("integrates the solid angle of each light") {
+    // Averaging 1/pdf over the samples estimates the total solid angle.
+    std::mt19937 rng(2);
+    std::uniform_real_distribution<> unit(0, 1);
+    const auto from = Vec3(0, 0, 0);
+    double total = 0;
+    constexpr int NumSamples = 10000;
+    for (int i = 0; i < NumSamples; ++i)
+      total += 1 / lights.sample(from, unit(rng), unit(rng), unit(rng))->pdf;
+    const auto solidAngle = [](double distance, double radius) {
+      return 2 * M_PI
+             * (1 - sqrt(1 - radius * radius / (distance * distance)));
+    };
+    CHECK(total / NumSamples
+          == Approx(solidAngle(5, 1) + solidAngle(5, 2)).epsilon(0.05));
+  }
+
+  SECTION("has no density away from the lights") {
+    CHECK(lights.pdf(Ray(Vec3(0, 0, 0), Norm3::zAxis()), 3) == 0);
+    // Hitting something in front of the light.
+    CHECK(lights.pdf(Ray(Vec3(0, 0, 0), Norm3::yAxis()), 1) == 0);
+    CHECK(lights.pdf(Ray(Vec3(0, 0, 0), Norm3::yAxis()), 4)
+          == Approx(sphereSamplePdf(Vec3(), Vec3(0, 5, 0), 1) / 2));
+  }
+
+  SECTION("can't be sampled from inside") {
+    CHECK_FALSE(lights.sample(Vec3(0, 5, 0), 0.1, 0.5, 0.5));
+    CHECK(lights.sample(Vec3(0, 5, 0), 0.9, 0.5, 0.5));
+  }
+
+  SECTION("counts emission in full for rays not sampled diffusely") {
+    CHECK(lights.emissionWeight(Ray(Vec3(), Norm3::yAxis()), 4, 0) == 1);
+    const auto weight =
+        lights.emissionWeight(Ray(Vec3(), Norm3::yAxis()), 4, 0.1);
+    CHECK(weight > 0);
+    CHECK(weight < 1);
+  }
+}
+
+TEST_CASE("Power heuristic", "[SphereLights]") {
+  CHECK(powerHeuristic(1, 0) == 1);
+  CHECK(powerHeuristic(0, 1) == 0);
+  CHECK(powerHeuristic(2, 2) == Approx(0.5));
+  CHECK(powerHeuristic(1, 3) + powerHeuristic(3, 1) == Approx(1));
+}
@@ -0,0 +1,51 @@
+#include <catch2/catch.hpp>
+
+#include "util/SplitBudget.h"
+
+namespace {
+
+// The variance of a camera sample split the given number of ways.
+double variance(double a, double b, int numSplits) { return a + b / numSplits; }
+
+TEST_CASE("Split budgets", "[SplitBudget]") {
+  auto choose = [](double a, double b, int maxSplits = 64) {
+    return chooseSplit(variance(a, b, 1),
+                       variance(a, b, PilotSplit.numSplits()), maxSplits)
+        .numSplits();
+  };
+
+  SECTION("splits by the square root of the variances' ratio") {
+    CHECK(choose(1, 1) == 1);
+    CHECK(choose(1, 4) == 2);
+    CHECK(choose(1, 16) == 4);
+    CHECK(choose(1, 81) == 9);
+    // The nearest grid to 32 is 6 x 5.
+    CHECK(choose(1, 1024) == 30);
+  }
+
+  SECTION("doesn't split without variance after the first bounce") {
+    CHECK(choose(1, 0) == 1);
+    // Noise in the measurements can make it look negative.
+    CHECK(chooseSplit(1, 1.1, 64).numSplits() == 1);
+  }
+
+  SECTION("splits as much as it may without variance before it") {
+    CHECK(choose(0, 1) == 64);
+    CHECK(choose(0, 1, 20) <= 20);
+    CHECK(choose(0, 1, 20) >= 16);
+  }
+
+  SECTION("spends what's left after the pilot samples") {
+    CHECK(budgetedSamples(pilotRays() + 50, FirstBounceSplit{3, 3}) == 5);
+    CHECK(budgetedSamples(pilotRays() + 50, FirstBounceSplit{}) == 25);
+    CHECK(budgetedSamples(pilotRays() - 1, FirstBounceSplit{}) == 0);
+  }
+
+  SECTION("needs a budget with room for a sample after the pilot") {
+    CHECK_NOTHROW(checkRayBudget(pilotRays() + 2));
+    CHECK_THROWS_AS(checkRayBudget(pilotRays() + 1), std::runtime_error);
+    CHECK_THROWS_AS(checkRayBudget(20), std::runtime_error);
+  }
+}
+
+}
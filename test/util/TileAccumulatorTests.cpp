@@ -0,0 +1,113 @@
+#include <catch2/catch.hpp>
+
+#include "math/ApproxVec3.h"
+#include "util/TileAccumulator.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST_CASE("TileAccumulator", "[TileAccumulator]") {
+  constexpr int width = 40;
+  constexpr int height = 24;
+  constexpr int tileSize = 8;
+  TileAccumulator accumulator(width, height, tileSize, tileSize);
+
+  SECTION("starts empty") {
+    CHECK(accumulator.snapshot().totalSamples() == 0);
+  }
+
+  SECTION("accumulates tiles, including partial ones") {
+    accumulator.commit(0, 8, 0, 8, std::vector<Vec3>(64, Vec3(2, 4, 6)), 2);
+    accumulator.commit(0, 8, 0, 8, std::vector<Vec3>(64, Vec3(1, 1, 1)), 1);
+    accumulator.commit(32, 40, 16, 20, std::vector<Vec3>(32, Vec3(1, 2, 3)),
+                       1);
+    auto output = accumulator.snapshot();
+    CHECK(output.totalSamples() == 64 * 3 + 32);
+    CHECK(output.rawPixelAt(3, 4) == ApproxVec3(1, 5.0 / 3, 7.0 / 3));
+    CHECK(output.rawPixelAt(39, 19) == Vec3(1, 2, 3));
+    CHECK(output.rawPixelAt(39, 20) == Vec3());
+  }
+
+  SECTION("keeps the spread of the samples, to tell how noisy tiles are") {
+    TileAccumulator tracking(width, height, tileSize, tileSize, true);
+    std::vector<SampleMoments> flat(64);
+    std::vector<SampleMoments> noisy(64);
+    for (int sample = 0; sample < 10; ++sample) {
+      for (auto &pixel : flat)
+        pixel.add(Vec3(1, 1, 1));
+      for (auto &pixel : noisy)
+        pixel.add(Vec3(1, 1, 1) * (sample % 2));
+    }
+    tracking.commit(0, 8, 0, 8, flat);
+    tracking.commit(8, 16, 0, 8, noisy);
+    CHECK(tracking.relativeError(0, 8, 0, 8) == 0);
+    CHECK(tracking.relativeError(8, 16, 0, 8) > 0.1);
+    CHECK(tracking.relativeError(8, 16, 0, 8)
+          == Approx(noisy[0].relativeError()));
+    CHECK(tracking.relativeError(0, 16, 0, 8)
+          == Approx(noisy[0].relativeError() / 2));
+    CHECK(tracking.snapshot().totalSamples() == 64 * 2 * 10);
+    CHECK_THROWS(tracking.relativeError(36, 44, 0, 8));
+    // Sums alone would leave the squares out of step.
+    CHECK_THROWS(tracking.commit(0, 8, 0, 8, std::vector<Vec3>(64), 1));
+  }
+
+  SECTION("doesn't keep the spread unless asked to") {
+    accumulator.commit(0, 8, 0, 8, std::vector<SampleMoments>(64));
+    CHECK_THROWS(accumulator.relativeError(0, 8, 0, 8));
+  }
+
+  SECTION("rejects tiles that don't fit") {
+    CHECK_THROWS(accumulator.commit(36, 44, 0, 8,
+                                    std::vector<Vec3>(64, Vec3()), 1));
+    CHECK_THROWS(accumulator.commit(0, 8, 0, 8, std::vector<Vec3>(63), 1));
+  }
+
+  SECTION("snapshots only ever see whole tiles") {
+    constexpr int numThreads = 4;
+    constexpr int commitsPerThread = 200;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < numThreads; ++thread) {
+      threads.emplace_back([&, thread] {
+        for (int i = 0; i < commitsPerThread; ++i) {
+          // Each commit a different colour, so a tile caught half-committed
+          // would have pixels with different averages.
+          const std::vector<Vec3> colours(tileSize * tileSize,
+                                          Vec3(i, thread, 1));
+          const auto tile = (thread + i * numThreads) % 15;
+          const auto x = (tile % 5) * tileSize;
+          const auto y = (tile / 5) * tileSize;
+          accumulator.commit(x, x + tileSize, y, y + tileSize, colours, 1);
+        }
+      });
+    }
+    size_t numSnapshots = 0;
+    auto checkWholeTiles = [&](const ArrayOutput &output) {
+      for (int y = 0; y < height; y += tileSize) {
+        for (int x = 0; x < width; x += tileSize) {
+          for (int dy = 0; dy < tileSize; ++dy)
+            for (int dx = 0; dx < tileSize; ++dx)
+              REQUIRE(output.rawPixelAt(x + dx, y + dy)
+                      == output.rawPixelAt(x, y));
+        }
+      }
+      numSnapshots++;
+    };
+    std::thread snapshotter([&] {
+      while (!done)
+        checkWholeTiles(accumulator.snapshot());
+    });
+    for (auto &thread : threads)
+      thread.join();
+    done = true;
+    snapshotter.join();
+
+    const auto output = accumulator.snapshot();
+    checkWholeTiles(output);
+    CHECK(output.totalSamples()
+          == static_cast<size_t>(numThreads * commitsPerThread * tileSize
+                                 * tileSize));
+  }
+}
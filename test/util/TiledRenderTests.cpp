@@ -0,0 +1,195 @@
+#include <catch2/catch.hpp>
+
+#include "math/ApproxVec3.h"
+#include "util/TiledRender.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+TEST_CASE("TiledRender", "[TiledRender]") {
+  RenderParams renderParams;
+  renderParams.width = 37;
+  renderParams.height = 21;
+  renderParams.samplesPerPixel = 11;
+  renderParams.seed = 1;
+
+  SECTION("covers every sample of every pixel once") {
+    renderParams.maxCpus = GENERATE(1, 4);
+    std::atomic<int> numSamples{0};
+    auto output = renderTiled(
+        renderParams,
+        [&](Sampler &, int x, int y, const RenderParams &) {
+          numSamples++;
+          return Vec3(x, y, 1);
+        },
+        [](const ArrayOutput &) {});
+    CHECK(numSamples == 37 * 21 * 11);
+    CHECK(output.totalSamples() == 37 * 21 * 11);
+    for (int y = 0; y < renderParams.height; ++y)
+      for (int x = 0; x < renderParams.width; ++x)
+        REQUIRE(output.rawPixelAt(x, y) == ApproxVec3(x, y, 1));
+  }
+
+  SECTION("finishes with an update of the whole image") {
+    size_t lastSamples = 0;
+    renderTiled(
+        renderParams,
+        [](Sampler &, int, int, const RenderParams &) {
+          return Vec3(1, 1, 1);
+        },
+        [&](const ArrayOutput &output) {
+          CHECK(output.totalSamples() >= lastSamples);
+          lastSamples = output.totalSamples();
+        });
+    CHECK(lastSamples == 37 * 21 * 11);
+  }
+}
+
+TEST_CASE("TiledRender with a ray budget", "[TiledRender]") {
+  RenderParams renderParams;
+  renderParams.width = 37;
+  renderParams.height = 21;
+  renderParams.raysPerPixel = 100;
+  renderParams.seed = 1;
+  renderParams.maxCpus = 2;
+
+  // A stand-in for a path tracer: a camera sample's noise is that of where
+  // it lands, plus the mean of that of each path split off from there.
+  auto render = [&](double splitNoise, std::vector<int> &rays,
+                    std::vector<int> &lastSplits) {
+    rays.assign(renderParams.width * renderParams.height, 0);
+    lastSplits = rays;
+    std::mutex mutex;
+    return renderTiled(
+        renderParams,
+        [&](Sampler &sampler, int x, int y, const RenderParams &params) {
+          const auto numSplits =
+              params.firstBounceUSamples * params.firstBounceVSamples;
+          auto value = 1 + (sampler.next1D() - 0.5);
+          for (int split = 0; split < numSplits; ++split)
+            value += splitNoise * (sampler.next1D() - 0.5) / numSplits;
+          std::lock_guard lock(mutex);
+          const auto pixel = x + y * renderParams.width;
+          rays[pixel] += 1 + numSplits;
+          lastSplits[pixel] = numSplits;
+          return Vec3(value, value, value);
+        },
+        [](const ArrayOutput &) {});
+  };
+
+  std::vector<int> rays;
+  std::vector<int> lastSplits;
+  SECTION("spends the budget") {
+    const auto output = render(4, rays, lastSplits);
+    for (int pixel = 0; pixel < renderParams.width * renderParams.height;
+         ++pixel) {
+      REQUIRE(rays[pixel] <= renderParams.raysPerPixel);
+      REQUIRE(rays[pixel] > renderParams.raysPerPixel - 1 - lastSplits[pixel]);
+    }
+    double total = 0;
+    for (int y = 0; y < renderParams.height; ++y)
+      for (int x = 0; x < renderParams.width; ++x)
+        total += output.rawPixelAt(x, y).x();
+    CHECK(total / (renderParams.width * renderParams.height)
+          == Approx(1).epsilon(0.03));
+  }
+
+  SECTION("splits as much as the noise after the first bounce calls for") {
+    // Four times the noise, so sixteen times the variance: the best split is
+    // four ways.
+    render(4, rays, lastSplits);
+    for (auto splits : lastSplits) {
+      REQUIRE(splits >= 2);
+      REQUIRE(splits <= 9);
+    }
+    // The pilot samples come first, so the last split is the one chosen.
+    render(0, rays, lastSplits);
+    for (auto splits : lastSplits)
+      REQUIRE(splits == 1);
+  }
+
+  SECTION("won't start on a budget the pilot samples would use up") {
+    renderParams.raysPerPixel = 20;
+    CHECK_THROWS_AS(render(4, rays, lastSplits), std::runtime_error);
+  }
+}
+
+TEST_CASE("TiledRender with adaptive sampling", "[TiledRender]") {
+  RenderParams renderParams;
+  renderParams.width = 37;
+  renderParams.height = 21;
+  renderParams.samplesPerPixel = 32;
+  renderParams.seed = 1;
+  renderParams.maxCpus = 2;
+  const auto numPixels = renderParams.width * renderParams.height;
+
+  // Noisy down the left-hand column of tiles, and flat everywhere else.
+  std::vector<int> samples;
+  auto render = [&] {
+    samples.assign(numPixels, 0);
+    std::mutex mutex;
+    return renderTiled(
+        renderParams,
+        [&](Sampler &sampler, int x, int y, const RenderParams &) {
+          const auto value = x < 16 ? 2 * sampler.next1D() : 1.0;
+          std::lock_guard lock(mutex);
+          samples[x + y * renderParams.width]++;
+          return Vec3(value, value, value);
+        },
+        [](const ArrayOutput &) {});
+  };
+
+  SECTION("spends the samples on the noisy tiles") {
+    renderParams.adaptiveError = 0.01;
+    const auto output = render();
+    CHECK(output.totalSamples()
+          <= static_cast<size_t>(numPixels * renderParams.samplesPerPixel));
+    double noisyTotal = 0;
+    for (int y = 0; y < renderParams.height; ++y) {
+      for (int x = 0; x < renderParams.width; ++x) {
+        const auto numSamples = samples[x + y * renderParams.width];
+        if (x < 16) {
+          REQUIRE(numSamples > renderParams.samplesPerPixel);
+          noisyTotal += output.rawPixelAt(x, y).x();
+        } else {
+          REQUIRE(numSamples == 8);
+          REQUIRE(output.rawPixelAt(x, y).x() == Approx(1));
+        }
+      }
+    }
+    CHECK(noisyTotal / (16 * renderParams.height) == Approx(1).epsilon(0.02));
+  }
+
+  SECTION("stops once every tile is quiet enough") {
+    renderParams.adaptiveError = 10;
+    const auto output = render();
+    CHECK(output.totalSamples() == static_cast<size_t>(numPixels * 8));
+  }
+}
+
+TEST_CASE("TiledRender with a deadline", "[TiledRender]") {
+  using namespace std::chrono_literals;
+  RenderParams renderParams;
+  renderParams.width = 37;
+  renderParams.height = 21;
+  renderParams.seed = 1;
+  renderParams.maxCpus = 2;
+  renderParams.deadline = Deadline(100ms);
+
+  const auto output = renderTiled(
+      renderParams,
+      [](Sampler &, int x, int y, const RenderParams &) {
+        return Vec3(x, y, 1);
+      },
+      [](const ArrayOutput &) {});
+  CHECK(renderParams.deadline.passed());
+  // Round after round of every tile, rather than stopping at
+  // samplesPerPixel.
+  CHECK(output.totalSamples()
+        > static_cast<size_t>(renderParams.width * renderParams.height
+                              * renderParams.samplesPerPixel));
+  for (int y = 0; y < renderParams.height; ++y)
+    for (int x = 0; x < renderParams.width; ++x)
+      REQUIRE(output.rawPixelAt(x, y) == ApproxVec3(x, y, 1));
+}
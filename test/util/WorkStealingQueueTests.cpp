@@ -0,0 +1,67 @@
+#include <catch2/catch.hpp>
+
+#include "util/WorkStealingQueue.h"
+
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+TEST_CASE("WorkStealingQueue", "[WorkStealingQueue]") {
+  std::vector<int> todo(1000);
+  std::iota(todo.begin(), todo.end(), 0);
+
+  SECTION("hands out from the back on one thread") {
+    WorkStealingQueue<int> queue(todo, 1);
+    CHECK(queue.size() == todo.size());
+    for (auto it = todo.rbegin(); it != todo.rend(); ++it) {
+      auto item = queue.pop(0);
+      REQUIRE(item);
+      CHECK(*item == *it);
+    }
+    CHECK(!queue.pop(0));
+  }
+
+  SECTION("deals the most important items out first") {
+    WorkStealingQueue<int> queue(todo, 4);
+    for (size_t thread = 0; thread < 4; ++thread)
+      CHECK(queue.pop(thread) == 999 - static_cast<int>(thread));
+  }
+
+  SECTION("steals once a thread's own items run out") {
+    WorkStealingQueue<int> queue(todo, 3);
+    std::vector<int> done;
+    while (auto item = queue.pop(1))
+      done.emplace_back(*item);
+    std::sort(done.begin(), done.end());
+    CHECK(done == todo);
+    CHECK(!queue.pop(0));
+    CHECK(!queue.pop(2));
+  }
+
+  SECTION("hands out every item exactly once across threads") {
+    constexpr size_t numThreads = 8;
+    WorkStealingQueue<int> queue(todo, numThreads);
+    std::vector<std::vector<int>> done(numThreads);
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < numThreads; ++thread)
+      threads.emplace_back([&, thread] {
+        while (auto item = queue.pop(thread))
+          done[thread].emplace_back(*item);
+      });
+    for (auto &thread : threads)
+      thread.join();
+    std::vector<int> all;
+    for (auto &items : done)
+      all.insert(all.end(), items.begin(), items.end());
+    std::sort(all.begin(), all.end());
+    CHECK(all == todo);
+  }
+
+  SECTION("copes with no threads or no work") {
+    CHECK(!WorkStealingQueue<int>({}, 4).pop(3));
+    WorkStealingQueue<int> queue(todo, 0);
+    CHECK(queue.numThreads() == 1);
+    CHECK(queue.pop(0) == 999);
+  }
+}